@@ -0,0 +1,95 @@
+/**
+ * @file mad_batch.cpp
+ * @author Phil Schatzmann
+ * @brief Decodes all mp3 files of the indicated directories with multiple threads and
+ * prints the x-realtime statistics. Usage: mad_batch [-j threads] [-q] dir|file...
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MadBatchDecoder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <filesystem>
+#include <algorithm>
+
+using namespace libmad;
+namespace fs = std::filesystem;
+
+std::vector<uint32_t> checksums;
+
+// checksum of the decoded samples, so that the results of different runs can be compared
+void pcmDataCallback(MadBatchResult &result, MadAudioInfo &info, int16_t *pwm_buffer, size_t len) {
+    uint32_t sum = checksums[result.index];
+    for (size_t j=0; j<len; j++){
+        sum = sum * 31 + (uint16_t) pwm_buffer[j];
+    }
+    checksums[result.index] = sum;
+}
+
+bool isMP3(const fs::path &path){
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".mp3";
+}
+
+void usage(){
+    printf("usage: mad_batch [-j threads] [-q] dir|file...\n");
+}
+
+int main(int argc, char *argv[]) {
+    MadBatchDecoder batch(pcmDataCallback);
+    bool quiet = false;
+    int threads = 0;
+    std::vector<std::string> files;
+
+    for (int j=1; j<argc; j++){
+        if (strcmp(argv[j], "-j") == 0 && j+1 < argc){
+            threads = atoi(argv[++j]);
+        } else if (strncmp(argv[j], "-j", 2) == 0 && isdigit(argv[j][2])){
+            threads = atoi(argv[j] + 2);
+        } else if (strcmp(argv[j], "-q") == 0){
+            quiet = true;
+        } else if (argv[j][0] == '-'){
+            usage();
+            return 1;
+        } else if (fs::is_directory(argv[j])){
+            for (auto &entry : fs::recursive_directory_iterator(argv[j])){
+                if (entry.is_regular_file() && isMP3(entry.path())){
+                    files.push_back(entry.path().string());
+                }
+            }
+        } else {
+            files.push_back(argv[j]);
+        }
+    }
+    if (files.empty()){
+        usage();
+        return 1;
+    }
+
+    std::sort(files.begin(), files.end());
+    for (auto &file : files){
+        batch.add(file.c_str());
+    }
+    checksums.assign(files.size(), 0);
+    batch.setThreads(threads);
+    bool ok = batch.decode();
+
+    if (!quiet){
+        printf("%-50s %6s %5s %9s %9s %8s %6s %8s\n", "file", "rate", "ch", "audio s", "decode s", "x-rt", "errors", "checksum");
+        for (auto &r : batch.results()){
+            printf("%-50s %6d %5d %9.2f %9.3f %8.1f %6zu %08x\n", r.name.c_str(), r.info.sample_rate, r.info.channels,
+                r.duration_ms / 1000.0, r.decode_sec, r.realtimeFactor(), r.errors, checksums[r.index]);
+        }
+    }
+    int thread_count = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+    printf("files: %zu, threads: %d, audio: %.1f sec, wall: %.3f sec, x-realtime: %.1f (%.1f per thread)\n",
+        files.size(), thread_count, batch.audioSeconds(), batch.wallSeconds(), batch.realtimeFactor(),
+        batch.realtimeFactor() / thread_count);
+    return ok ? 0 : 2;
+}
@@ -0,0 +1,278 @@
+/**
+ * @file mad_bench.cpp
+ * @author Phil Schatzmann
+ * @brief Decoding benchmark: decodes the embedded BabyElephantWalk60 file and the indicated
+ * files with the raw libmad API and with the MP3DecoderMAD in different variants and reports
+ * the x-realtime factor, the time per frame, the overhead of the wrapper compared to the raw
+ * API and the peak RSS. Each variant is repeated and the fastest run is reported. If the
+ * library was built with MAD_STATS the time per decoding stage is printed as JSON with -s.
+ * The fixed point backend is reported as well: mad_bench_fpm_* are built with the
+ * alternative backends. Usage: mad_bench [-r repeat] [-s] [file.mp3...]
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MP3DecoderMAD.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <sys/resource.h>
+
+using namespace libmad;
+
+#if defined(FPM_64BIT)
+const char *backend = "fpm_64bit";
+#elif defined(FPM_INTEL)
+const char *backend = "fpm_intel";
+#elif defined(FPM_ARM)
+const char *backend = "fpm_arm";
+#else
+const char *backend = "fpm_default";
+#endif
+
+/// Input data with the information of the first frame
+struct Input {
+    std::string name;
+    std::vector<uint8_t> data;
+    struct mad_header header;
+    size_t frames = 0;
+    double audio_sec = 0;
+};
+
+/// Result of a variant
+struct Result {
+    double sec = 0;
+    size_t samples = 0;
+    uint32_t checksum = 0;
+    MadStats stats;
+};
+
+Result *actual = nullptr;
+const size_t write_size = 1024;
+
+void add(Result &result, const int16_t *data, size_t len){
+    uint32_t sum = result.checksum;
+    for (size_t j=0; j<len; j++){
+        sum = sum * 31 + (uint16_t) data[j];
+    }
+    result.checksum = sum;
+    result.samples += len;
+}
+
+void pcmDataCallback(MadAudioInfo &info, int16_t *pwm_buffer, size_t len) {
+    add(*actual, pwm_buffer, len);
+}
+
+/// Decodes the input with the raw libmad API and converts the result to int16_t
+void decodeRaw(Input &input, Result &result, int options){
+    MadStatsScope scope(result.stats);
+    struct mad_stream stream;
+    struct mad_frame frame;
+    struct mad_synth synth;
+    int16_t pcm[2 * 1152];
+    mad_stream_init(&stream);
+    mad_frame_init(&frame);
+    mad_synth_init(&synth);
+    mad_stream_options(&stream, options);
+    mad_stream_buffer(&stream, input.data.data(), input.data.size());
+    while(true){
+        if (mad_frame_decode(&frame, &stream)==-1){
+            if (MAD_RECOVERABLE(stream.error)) continue;
+            break;
+        }
+        // in granule mode the remaining granules are decoded one by one
+        do {
+            mad_synth_frame(&synth, &frame);
+            result.stats.frames++;
+            result.stats.samples += synth.pcm.length;
+            MAD_STATS_ENTER(MAD_STAGE_PCM);
+            int16_t *out = pcm;
+            for (int j=0; j<synth.pcm.length; j++){
+                for (int ch=0; ch<synth.pcm.channels; ch++){
+                    *out++ = MP3DecoderMAD::scale(synth.pcm.samples[ch][j]);
+                }
+            }
+            MAD_STATS_LEAVE();
+            MAD_STATS_ENTER(MAD_STAGE_OUTPUT);
+            add(result, pcm, out - pcm);
+            MAD_STATS_LEAVE();
+        } while (mad_frame_decode_granule(&frame, &stream)==1);
+    }
+    mad_synth_finish(&synth);
+    mad_frame_finish(&frame);
+    mad_stream_finish(&stream);
+}
+
+/// Decodes the input with the MP3DecoderMAD: with write() or with decodeFrames()
+void decodeWrapper(Input &input, Result &result, bool frames, bool slots, bool granules){
+    MP3DecoderMAD mp3(pcmDataCallback);
+    mp3.setSlotSynthesis(slots);
+    mp3.setGranuleDecoding(granules);
+    mp3.begin();
+    actual = &result;
+    const uint8_t *data = input.data.data();
+    size_t size = input.data.size();
+    if (frames){
+        mp3.decodeFrames(data, size);
+    } else {
+        for (size_t pos=0; pos<size; pos+=write_size){
+            mp3.write(data + pos, std::min(write_size, size - pos));
+        }
+    }
+    mp3.end();
+    result.stats = mp3.stats();
+}
+
+/// Benchmark variants
+enum Variant {Raw, RawHalf, RawGranules, Write, DecodeFrames, Slots, Granules, VariantCount};
+const char *variant_names[] = {"raw", "raw half", "raw granules", "write", "decodeFrames", "slots", "granules"};
+
+void decode(Input &input, Variant variant, Result &result){
+    switch(variant){
+        case Raw: decodeRaw(input, result, 0); break;
+        case RawHalf: decodeRaw(input, result, MAD_OPTION_HALFSAMPLERATE); break;
+        case RawGranules: decodeRaw(input, result, MAD_OPTION_GRANULES); break;
+        case Write: decodeWrapper(input, result, false, false, false); break;
+        case DecodeFrames: decodeWrapper(input, result, true, false, false); break;
+        case Slots: decodeWrapper(input, result, true, true, false); break;
+        case Granules: decodeWrapper(input, result, true, false, true); break;
+        default: break;
+    }
+}
+
+/// Executes the variant repeat times and keeps the fastest run
+Result measure(Input &input, Variant variant, int repeat){
+    Result best;
+    for (int j=0; j<repeat; j++){
+        Result result;
+        auto start = std::chrono::steady_clock::now();
+        decode(input, variant, result);
+        result.sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (j==0 || result.sec < best.sec){
+            best = result;
+        }
+    }
+    return best;
+}
+
+/// Determines the format of the first frame, the number of frames and the playing time
+bool scan(Input &input){
+    struct mad_stream stream;
+    mad_timer_t duration = mad_timer_zero;
+    mad_stream_init(&stream);
+    mad_stream_buffer(&stream, input.data.data(), input.data.size());
+    mad_header_init(&input.header);
+    while(true){
+        struct mad_header header;
+        if (mad_header_decode(&header, &stream)==-1){
+            if (MAD_RECOVERABLE(stream.error)) continue;
+            break;
+        }
+        if (input.frames++ == 0){
+            input.header = header;
+        }
+        mad_timer_add(&duration, header.duration);
+    }
+    mad_stream_finish(&stream);
+    input.audio_sec = mad_timer_count(duration, MAD_UNITS_MILLISECONDS) / 1000.0;
+    return input.frames > 0;
+}
+
+bool readFile(const char *path, Input &input){
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) return false;
+    uint8_t tmp[4096];
+    size_t len;
+    while ((len = fread(tmp, 1, sizeof(tmp), file)) > 0){
+        input.data.insert(input.data.end(), tmp, tmp + len);
+    }
+    fclose(file);
+    input.name = path;
+    return true;
+}
+
+const char *modeName(enum mad_mode mode){
+    switch(mode){
+        case MAD_MODE_SINGLE_CHANNEL: return "mono";
+        case MAD_MODE_DUAL_CHANNEL: return "dual";
+        case MAD_MODE_JOINT_STEREO: return "joint";
+        default: return "stereo";
+    }
+}
+
+void usage(){
+    printf("usage: mad_bench [-r repeat] [-s] [file.mp3...]\n");
+}
+
+int main(int argc, char *argv[]) {
+    int repeat = 5;
+    bool print_stats = false;
+    std::vector<Input> inputs(1);
+    inputs[0].name = "BabyElephantWalk60_mp3";
+    inputs[0].data.assign(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3 + BabyElephantWalk60_mp3_len);
+
+    for (int j=1; j<argc; j++){
+        if (strcmp(argv[j], "-r") == 0 && j+1 < argc){
+            repeat = std::max(1, atoi(argv[++j]));
+        } else if (strcmp(argv[j], "-s") == 0){
+            print_stats = true;
+        } else if (argv[j][0] == '-'){
+            usage();
+            return 1;
+        } else {
+            Input input;
+            if (!readFile(argv[j], input)){
+                printf("could not read %s\n", argv[j]);
+                return 1;
+            }
+            inputs.push_back(input);
+        }
+    }
+
+#ifndef MAD_STATS
+    if (print_stats){
+        printf("stages are not measured: build with -DMAD_STATS=ON\n");
+    }
+#endif
+    printf("backend: %s, repeat: %d\n", backend, repeat);
+    for (auto &input : inputs){
+        // make sure that the last frame is decoded as well
+        input.data.resize(input.data.size() + MAD_BUFFER_GUARD, 0);
+        if (!scan(input)){
+            printf("%s: no mp3 data\n", input.name.c_str());
+            continue;
+        }
+        printf("\n%s: layer %d, %lu kbps, %u Hz, %s, %zu frames, %.1f sec\n", input.name.c_str(), input.header.layer,
+            input.header.bitrate / 1000, input.header.samplerate, modeName(input.header.mode), input.frames, input.audio_sec);
+        printf("%-14s %9s %10s %9s %10s %8s\n", "variant", "x-rt", "ns/frame", "overhead", "samples", "checksum");
+        double raw_sec = 0;
+        for (int v=0; v<VariantCount; v++){
+            Result result = measure(input, (Variant)v, repeat);
+            if (v == Raw) raw_sec = result.sec;
+            char overhead[16] = "";
+            if (v >= Write && raw_sec > 0){
+                snprintf(overhead, sizeof(overhead), "%+.1f%%", (result.sec / raw_sec - 1.0) * 100.0);
+            }
+            printf("%-14s %9.1f %10.0f %9s %10zu %08x\n", variant_names[v], input.audio_sec / result.sec,
+                result.sec * 1e9 / input.frames, overhead, result.samples, result.checksum);
+#ifdef MAD_STATS
+            if (print_stats){
+                char json[1024];
+                result.stats.toJson(json, sizeof(json));
+                printf("%s\n", json);
+            }
+#endif
+        }
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("\npeak RSS: %ld KB\n", usage.ru_maxrss);
+    return 0;
+}
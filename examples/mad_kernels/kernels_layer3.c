@@ -0,0 +1,236 @@
+/**
+ * @file kernels_layer3.c
+ * @author Phil Schatzmann
+ * @brief Layer III kernels of mad_kernels: we include the libmad source, so that we can call
+ * the static functions directly. This file replaces layer3.c in the mad_kernels build.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "layer3.c"
+#include "mad_kernels.h"
+
+static unsigned long random_state = 1;
+static unsigned char bits[8192];
+static unsigned char widths[4096];
+static unsigned long values[4096];
+static mad_fixed_t xr[576];
+static mad_fixed_t z[32][36];
+static unsigned short rq_values[576];
+static signed short rq_exps[576];
+static struct channel channel;
+
+void mad_kernel_seed(unsigned long seed)
+{
+  random_state = seed ? seed : 1;
+}
+
+/* xorshift */
+unsigned long mad_kernel_random(void)
+{
+  unsigned long x = random_state;
+
+  x ^= (x << 13) & 0xffffffffUL;
+  x ^= x >> 17;
+  x ^= (x << 5) & 0xffffffffUL;
+  random_state = x & 0xffffffffUL;
+
+  return random_state;
+}
+
+unsigned long mad_kernel_checksum(void const *data, unsigned long size)
+{
+  unsigned char const *ptr = data;
+  unsigned long sum = 2166136261UL;
+
+  while (size--) {
+    sum ^= *ptr++;
+    sum  = (sum * 16777619UL) & 0xffffffffUL;
+  }
+
+  return sum;
+}
+
+static
+void random_bits(void)
+{
+  unsigned int i;
+
+  for (i = 0; i < sizeof(bits); ++i)
+    bits[i] = mad_kernel_random();
+}
+
+/* random values in the range of the decoded spectrum */
+static
+void random_xr(void)
+{
+  unsigned int i;
+
+  for (i = 0; i < 576; ++i)
+    xr[i] = (mad_fixed_t) (mad_kernel_random() % MAD_F_ONE) - MAD_F_ONE / 2;
+}
+
+/* mad_bit_read() with 1 - 16 bits */
+
+static
+void bitread_init(int param)
+{
+  unsigned int i;
+
+  (void) param;
+  random_bits();
+  for (i = 0; i < 4096; ++i)
+    widths[i] = 1 + mad_kernel_random() % 16;
+}
+
+static
+void bitread_run(int param)
+{
+  struct mad_bitptr ptr;
+  unsigned int i;
+
+  (void) param;
+  mad_bit_init(&ptr, bits);
+  for (i = 0; i < 4096; ++i)
+    values[i] = mad_bit_read(&ptr, widths[i]);
+}
+
+static
+unsigned long bitread_checksum(void)
+{
+  return mad_kernel_checksum(values, sizeof(values));
+}
+
+/* III_huffdecode() of random bits with the indicated table for all regions */
+
+static
+void huffdecode_run(int param)
+{
+  struct mad_bitptr ptr;
+
+  (void) param;
+  mad_bit_init(&ptr, bits);
+  III_huffdecode(&ptr, xr, &channel, sfb_44100_long, 0, 576);
+}
+
+static
+void huffdecode_init(int param)
+{
+  struct mad_bitptr ptr;
+
+  random_bits();
+
+  memset(&channel, 0, sizeof(channel));
+  channel.part2_3_length  = 4095;
+  channel.global_gain     = 210;
+  channel.table_select[0] =
+  channel.table_select[1] =
+  channel.table_select[2] = param;
+  channel.region0_count   = 7;
+  channel.region1_count   = 7;
+
+  /* use as many big values as the bits allow */
+  for (channel.big_values = 288; channel.big_values > 0;
+       channel.big_values -= 8) {
+    mad_bit_init(&ptr, bits);
+    if (III_huffdecode(&ptr, xr, &channel, sfb_44100_long, 0, 576) ==
+	MAD_ERROR_NONE)
+      break;
+  }
+}
+
+static
+unsigned long xr_checksum(void)
+{
+  return mad_kernel_checksum(xr, sizeof(xr));
+}
+
+/* III_requantize() with random values and exponents */
+
+static
+void requantize_init(int param)
+{
+  unsigned int i;
+
+  (void) param;
+  for (i = 0; i < 576; ++i) {
+    rq_values[i] = mad_kernel_random() % 8207;
+    rq_exps[i]   = -(signed) (mad_kernel_random() % 128) + 8;
+  }
+}
+
+static
+void requantize_run(int param)
+{
+  unsigned int i;
+
+  (void) param;
+  for (i = 0; i < 576; ++i)
+    xr[i] = III_requantize(rq_values[i], rq_exps[i]);
+}
+
+/* III_aliasreduce() of a granule */
+
+static
+void spectrum_init(int param)
+{
+  (void) param;
+  random_xr();
+}
+
+static
+void aliasreduce_run(int param)
+{
+  (void) param;
+  III_aliasreduce(xr, 576);
+}
+
+/* imdct36() and III_imdct_s() of all subbands of a granule */
+
+static
+void imdct36_run(int param)
+{
+  unsigned int sb;
+
+  (void) param;
+  for (sb = 0; sb < 32; ++sb)
+    imdct36(&xr[sb * 18], z[sb]);
+}
+
+static
+void imdct_s_run(int param)
+{
+  unsigned int sb;
+
+  (void) param;
+  for (sb = 0; sb < 32; ++sb)
+    III_imdct_s(&xr[sb * 18], z[sb]);
+}
+
+static
+unsigned long z_checksum(void)
+{
+  return mad_kernel_checksum(z, sizeof(z));
+}
+
+# define HUFFDECODE(table)  \
+  { "III_huffdecode", table, 576, huffdecode_init, huffdecode_run, xr_checksum }
+
+struct mad_kernel const mad_layer3_kernels[] = {
+  { "mad_bit_read", 0, 4096, bitread_init, bitread_run, bitread_checksum },
+  HUFFDECODE(1),  HUFFDECODE(2),  HUFFDECODE(3),  HUFFDECODE(5),
+  HUFFDECODE(6),  HUFFDECODE(7),  HUFFDECODE(8),  HUFFDECODE(9),
+  HUFFDECODE(10), HUFFDECODE(11), HUFFDECODE(12), HUFFDECODE(13),
+  HUFFDECODE(15), HUFFDECODE(16), HUFFDECODE(17), HUFFDECODE(18),
+  HUFFDECODE(19), HUFFDECODE(20), HUFFDECODE(21), HUFFDECODE(22),
+  HUFFDECODE(23), HUFFDECODE(24), HUFFDECODE(25), HUFFDECODE(26),
+  HUFFDECODE(27), HUFFDECODE(28), HUFFDECODE(29), HUFFDECODE(30),
+  HUFFDECODE(31),
+  { "III_requantize", 0, 576, requantize_init, requantize_run, xr_checksum },
+  { "III_aliasreduce", 0, 576, spectrum_init, aliasreduce_run, xr_checksum },
+  { "imdct36", 0, 32 * 36, spectrum_init, imdct36_run, z_checksum },
+  { "III_imdct_s", 0, 32 * 36, spectrum_init, imdct_s_run, z_checksum },
+  { 0 }
+};
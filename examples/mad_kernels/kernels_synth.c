@@ -0,0 +1,83 @@
+/**
+ * @file kernels_synth.c
+ * @author Phil Schatzmann
+ * @brief Synthesis kernels of mad_kernels: we include the libmad source, so that we can call
+ * the static functions directly. This file replaces synth.c in the mad_kernels build.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "synth.c"
+#include <string.h>
+#include "mad_kernels.h"
+
+static struct mad_synth synth;
+static struct mad_frame frame;
+static mad_fixed_t lo[16][8], hi[16][8];
+
+static
+void subbands_init(int param)
+{
+  unsigned int ch, s, sb;
+
+  (void) param;
+  mad_synth_init(&synth);
+  memset(&synth.pcm, 0, sizeof(synth.pcm));
+  for (ch = 0; ch < 2; ++ch) {
+    for (s = 0; s < 36; ++s) {
+      for (sb = 0; sb < 32; ++sb) {
+	frame.sbsample[ch][s][sb] =
+	  (mad_fixed_t) (mad_kernel_random() % MAD_F_ONE) - MAD_F_ONE / 2;
+      }
+    }
+  }
+}
+
+/* dct32() of all slots of a channel */
+
+static
+void dct32_run(int param)
+{
+  unsigned int s;
+
+  (void) param;
+  for (s = 0; s < 36; ++s)
+    dct32(frame.sbsample[0][s], s % 16, lo, hi);
+}
+
+static
+unsigned long dct32_checksum(void)
+{
+  return mad_kernel_checksum(lo, sizeof(lo)) ^ mad_kernel_checksum(hi, sizeof(hi));
+}
+
+/* synth_full() and synth_half() of a stereo frame */
+
+static
+void synth_full_run(int param)
+{
+  (void) param;
+  synth_full(&synth, &frame, 2, 36);
+}
+
+static
+void synth_half_run(int param)
+{
+  (void) param;
+  synth_half(&synth, &frame, 2, 36);
+}
+
+static
+unsigned long pcm_checksum(void)
+{
+  return mad_kernel_checksum(synth.pcm.samples, sizeof(synth.pcm.samples));
+}
+
+struct mad_kernel const mad_synth_kernels[] = {
+  { "dct32", 0, 36 * 32, subbands_init, dct32_run, dct32_checksum },
+  { "synth_full", 0, 2 * 36 * 32, subbands_init, synth_full_run, pcm_checksum },
+  { "synth_half", 0, 2 * 36 * 16, subbands_init, synth_half_run, pcm_checksum },
+  { 0 }
+};
@@ -0,0 +1,146 @@
+/**
+ * @file mad_kernels.cpp
+ * @author Phil Schatzmann
+ * @brief Microbenchmark of the individual decoder kernels on fixed randomized input: each
+ * kernel is warmed up and then measured repeatedly; we report the fastest result as ns and
+ * cycles per output sample together with a checksum of the output of a single run, so that
+ * optimized variants can be compared with the reference implementation.
+ * Usage: mad_kernels [-t ms] [filter]
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MP3DecoderMAD.h"
+#include "mad_kernels.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAS_CYCLES
+#endif
+
+using namespace libmad;
+
+/* MP3DecoderMAD::scale() of a stereo frame */
+
+mad_fixed_t scale_in[2 * 1152];
+int16_t scale_out[2 * 1152];
+
+void scale_init(int param){
+    (void) param;
+    for (int j=0; j<2 * 1152; j++){
+        // include some values which need to be clipped
+        scale_in[j] = (mad_fixed_t) (mad_kernel_random() % (3 * MAD_F_ONE)) - 3 * MAD_F_ONE / 2;
+    }
+}
+
+void scale_run(int param){
+    (void) param;
+    for (int j=0; j<2 * 1152; j++){
+        scale_out[j] = MP3DecoderMAD::scale(scale_in[j]);
+    }
+}
+
+unsigned long scale_checksum(){
+    return mad_kernel_checksum(scale_out, sizeof(scale_out));
+}
+
+const mad_kernel wrapper_kernels[] = {
+    {"MP3DecoderMAD::scale", 0, 2 * 1152, scale_init, scale_run, scale_checksum},
+    {}
+};
+
+inline unsigned long long cycles(){
+#ifdef HAS_CYCLES
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/// Measures a kernel: batches of runs of about 1 ms during the indicated time
+void measure(const mad_kernel &kernel, int ms){
+    // checksum of a single run
+    mad_kernel_seed(1);
+    kernel.init(kernel.param);
+    kernel.run(kernel.param);
+    unsigned long checksum = kernel.checksum();
+
+    // warm up and determine the batch size
+    long batch = 1;
+    while(true){
+        auto start = std::chrono::steady_clock::now();
+        for (long j=0; j<batch; j++){
+            kernel.run(kernel.param);
+        }
+        if (std::chrono::steady_clock::now() - start > std::chrono::microseconds(1000)) break;
+        batch *= 2;
+    }
+
+    double best_ns = 0;
+    double best_cycles = 0;
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+    do {
+        auto start = std::chrono::steady_clock::now();
+        unsigned long long start_cycles = cycles();
+        for (long j=0; j<batch; j++){
+            kernel.run(kernel.param);
+        }
+        unsigned long long used_cycles = cycles() - start_cycles;
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (best_ns == 0 || ns < best_ns){
+            best_ns = ns;
+            best_cycles = used_cycles;
+        }
+    } while (std::chrono::steady_clock::now() < end);
+
+    double samples = (double) batch * kernel.samples;
+    char name[40];
+    if (kernel.param > 0){
+        snprintf(name, sizeof(name), "%s(%d)", kernel.name, kernel.param);
+    } else {
+        snprintf(name, sizeof(name), "%s", kernel.name);
+    }
+#ifdef HAS_CYCLES
+    printf("%-24s %10.2f %12.2f %10.0f %08lx\n", name, best_ns / samples, best_cycles / samples, best_ns / batch, checksum);
+#else
+    printf("%-24s %10.2f %12s %10.0f %08lx\n", name, best_ns / samples, "-", best_ns / batch, checksum);
+#endif
+}
+
+void measureAll(const mad_kernel *kernels, const char *filter, int ms){
+    for (const mad_kernel *kernel = kernels; kernel->name != nullptr; kernel++){
+        if (filter == nullptr || strstr(kernel->name, filter) != nullptr){
+            measure(*kernel, ms);
+        }
+    }
+}
+
+void usage(){
+    printf("usage: mad_kernels [-t ms] [filter]\n");
+}
+
+int main(int argc, char *argv[]) {
+    int ms = 100;
+    const char *filter = nullptr;
+    for (int j=1; j<argc; j++){
+        if (strcmp(argv[j], "-t") == 0 && j+1 < argc){
+            ms = atoi(argv[++j]);
+        } else if (argv[j][0] == '-'){
+            usage();
+            return 1;
+        } else {
+            filter = argv[j];
+        }
+    }
+
+    printf("%-24s %10s %12s %10s %8s\n", "kernel", "ns/sample", "cycles/sample", "ns/run", "checksum");
+    measureAll(mad_layer3_kernels, filter, ms);
+    measureAll(mad_synth_kernels, filter, ms);
+    measureAll(wrapper_kernels, filter, ms);
+    return 0;
+}
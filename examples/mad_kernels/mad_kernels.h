@@ -0,0 +1,41 @@
+/**
+ * @file mad_kernels.h
+ * @author Phil Schatzmann
+ * @brief Interface of the individual decoder kernels which are measured by mad_kernels
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// A kernel working on fixed randomized input: init() creates the input, run() is measured
+/// and checksum() summarizes the output of the last run
+struct mad_kernel {
+  char const *name;
+  int param;                    /* e.g. the Huffman table */
+  unsigned long samples;        /* output samples per run */
+  void (*init)(int param);
+  void (*run)(int param);
+  unsigned long (*checksum)(void);
+};
+
+/// bit reader, Huffman decoding, requantization, alias reduction and IMDCT (terminated by name 0)
+extern struct mad_kernel const mad_layer3_kernels[];
+/// dct32 and synthesis window (terminated by name 0)
+extern struct mad_kernel const mad_synth_kernels[];
+
+/// Pseudo random numbers, so that every run is using the same input
+unsigned long mad_kernel_random(void);
+void mad_kernel_seed(unsigned long seed);
+/// FNV-1a checksum of the output data
+unsigned long mad_kernel_checksum(void const *data, unsigned long size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,218 @@
+/**
+ * @file mp3_async.cpp
+ * @author Phil Schatzmann
+ * @brief Runs the libmad decoder with MAD_DECODER_MODE_ASYNC in its own thread: the PCM data
+ * is handed over to the main thread with a MadPCMQueue and a control thread is pausing and
+ * resuming the decoder with mad_decoder_message(). We verify that the result is identical to
+ * the synchronous decoding and report the round trip time of the messages. At the end the
+ * decoder is stopped with a message after a seek to the beginning.
+ * Usage: mp3_async [file.mp3]
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MadPCMQueue.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+
+using namespace libmad;
+
+/// Messages which are processed by the decoder thread
+enum Command {Pause, Resume, Seek, Stop};
+
+struct Message {
+    Command command;
+    size_t value;       // seek position or reply: number of decoded frames
+};
+
+/// Data which is shared between the decoder thread and the application
+struct App {
+    std::vector<uint8_t> data;
+    struct mad_decoder decoder;
+    MadPCMQueue queue{16};
+    std::atomic<bool> ended{false};
+    std::atomic<bool> stopping{false};
+    bool input_provided = false;
+    size_t frames = 0;
+};
+
+// decoder thread: provides the complete file
+enum mad_flow input(void *data, struct mad_stream *stream){
+    App *app = (App*) data;
+    if (app->input_provided){
+        app->ended = true;
+        return MAD_FLOW_STOP;
+    }
+    mad_stream_buffer(stream, app->data.data(), app->data.size());
+    app->input_provided = true;
+    return MAD_FLOW_CONTINUE;
+}
+
+// decoder thread: hands the frame over to the consumer; we wait if the queue is full
+enum mad_flow output(void *data, struct mad_header const *header, struct mad_pcm *pcm){
+    App *app = (App*) data;
+    while (app->queue.availableForWrite() == 0 && !app->stopping){
+        std::this_thread::yield();
+    }
+    app->queue.writeFrame(header, pcm);
+    app->frames++;
+    return MAD_FLOW_CONTINUE;
+}
+
+// decoder thread: processes the messages between the frames
+enum mad_flow message(void *data, void *msg, unsigned int *len){
+    App *app = (App*) data;
+    Message *message = (Message*) msg;
+    if (*len != sizeof(Message)) return MAD_FLOW_IGNORE;
+    enum mad_flow result = MAD_FLOW_CONTINUE;
+    switch(message->command){
+        case Pause:
+            result = MAD_FLOW_PAUSE;
+            break;
+        case Resume:
+            break;
+        case Seek:
+            // we are called between the frames, so we can reposition the stream
+            mad_stream_buffer(&app->decoder.sync->stream, app->data.data() + message->value, app->data.size() - message->value);
+            mad_frame_mute(&app->decoder.sync->frame);
+            mad_synth_mute(&app->decoder.sync->synth);
+            break;
+        case Stop:
+            app->ended = true;
+            result = MAD_FLOW_STOP;
+            break;
+    }
+    message->value = app->frames;
+    return result;
+}
+
+void add(uint64_t &hash, const int16_t *data, size_t len){
+    for (size_t j=0; j<len; j++){
+        hash ^= (uint16_t) data[j];
+        hash *= 1099511628211ull;
+    }
+}
+
+/// Decodes the file synchronously to get the reference result
+uint64_t decodeSync(App &app, size_t &samples){
+    uint64_t hash = 1469598103934665603ull;
+    samples = 0;
+    mad_decoder_init(&app.decoder, &app, input, nullptr, nullptr, output, nullptr, nullptr);
+    std::thread consumer([&](){
+        int16_t pcm[1152];
+        while (!(app.ended && app.queue.available() == 0)){
+            size_t len = app.queue.read(pcm, std::min(app.queue.available(), (size_t) 1152));
+            add(hash, pcm, len);
+            samples += len;
+        }
+    });
+    mad_decoder_run(&app.decoder, MAD_DECODER_MODE_SYNC);
+    consumer.join();
+    mad_decoder_finish(&app.decoder);
+    return hash;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<uint8_t> data;
+    if (argc > 1){
+        FILE *file = fopen(argv[1], "rb");
+        if (file == nullptr){
+            printf("could not read %s\n", argv[1]);
+            return 1;
+        }
+        uint8_t tmp[4096];
+        size_t len;
+        while ((len = fread(tmp, 1, sizeof(tmp), file)) > 0){
+            data.insert(data.end(), tmp, tmp + len);
+        }
+        fclose(file);
+    } else {
+        data.assign(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3 + BabyElephantWalk60_mp3_len);
+    }
+    // make sure that the last frame is decoded as well
+    data.resize(data.size() + MAD_BUFFER_GUARD, 0);
+
+    App sync_app;
+    sync_app.data = data;
+    size_t sync_samples;
+    uint64_t sync_hash = decodeSync(sync_app, sync_samples);
+
+    // asynchronous decoding: the decoder runs in its own thread
+    App app;
+    app.data = data;
+    mad_decoder_init(&app.decoder, &app, input, nullptr, nullptr, output, nullptr, message);
+    if (mad_decoder_run(&app.decoder, MAD_DECODER_MODE_ASYNC) != 0){
+        printf("MAD_DECODER_MODE_ASYNC is not supported\n");
+        return 1;
+    }
+
+    // control thread: pauses and resumes the decoder
+    std::atomic<bool> control_active{true};
+    // round trip times of the pause (processed before the next frame) and of the resume (wakes up the paused decoder)
+    std::vector<double> latencies[2];
+    std::thread control([&](){
+        while (control_active && !app.ended){
+            for (Command command : {Pause, Resume}){
+                Message msg{command, 0};
+                unsigned int len = sizeof(msg);
+                auto start = std::chrono::steady_clock::now();
+                if (mad_decoder_message(&app.decoder, &msg, &len) != 0) return;
+                latencies[command].push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
+    });
+
+    // main thread: consumes the PCM data
+    uint64_t hash = 1469598103934665603ull;
+    size_t samples = 0;
+    int16_t pcm[1152];
+    while (!(app.ended && app.queue.available() == 0)){
+        size_t len = app.queue.read(pcm, std::min(app.queue.available(), (size_t) 1152));
+        if (len == 0){
+            std::this_thread::yield();
+        }
+        add(hash, pcm, len);
+        samples += len;
+    }
+    control_active = false;
+    control.join();
+    mad_decoder_finish(&app.decoder);
+
+    printf("sync:  samples %zu hash %016llx\n", sync_samples, (unsigned long long) sync_hash);
+    printf("async: samples %zu hash %016llx %s\n", samples, (unsigned long long) hash, hash == sync_hash ? "ok" : "different");
+    for (Command command : {Pause, Resume}){
+        double sum = 0, max = 0;
+        for (double l : latencies[command]){
+            sum += l;
+            max = std::max(max, l);
+        }
+        size_t count = latencies[command].size();
+        printf("%-7s messages: %zu, avg %.1f us, max %.1f us\n", command == Pause ? "pause" : "resume", count, count == 0 ? 0 : sum / count, max);
+    }
+
+    // pause, seek to the beginning and stop the decoder with messages: the PCM data is dropped
+    App app2;
+    app2.data = data;
+    app2.stopping = true;
+    mad_decoder_init(&app2.decoder, &app2, input, nullptr, nullptr, output, nullptr, message);
+    mad_decoder_run(&app2.decoder, MAD_DECODER_MODE_ASYNC);
+    for (Command command : {Pause, Seek, Stop}){
+        Message msg{command, 0};
+        unsigned int len = sizeof(msg);
+        if (mad_decoder_message(&app2.decoder, &msg, &len) != 0){
+            printf("the decoder has already ended\n");
+            break;
+        }
+        printf("command %d processed after %zu frames\n", command, msg.value);
+    }
+    int result = mad_decoder_finish(&app2.decoder);
+
+    return hash == sync_hash && result == 0 ? 0 : 2;
+}
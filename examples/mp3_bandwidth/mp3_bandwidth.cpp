@@ -0,0 +1,100 @@
+/**
+ * @file mp3_bandwidth.cpp
+ * @author Phil Schatzmann
+ * @brief Bandwidth capped decoding e.g. for speech recognition: we decode the embedded mp3 file
+ * with the full bandwidth and with the indicated maximum bandwidths and compare the decoding time.
+ * Below a quarter of the sample rate the result is provided at half the sample rate. We report
+ * the rms of the result relative to the full decoding and check that the bandwidth of the
+ * Nyquist frequency gives the identical result.
+ * Usage: mp3_bandwidth [mp3 file] [hz...]
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MP3DecoderMAD.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+
+using namespace libmad;
+
+const int repeat = 5;
+uint32_t checksum = 0;
+double energy = 0;
+size_t samples = 0;
+int sample_rate = 0;
+
+void analyze(MadAudioInfo &info, int16_t *data, size_t len) {
+    sample_rate = info.sample_rate;
+    for (size_t j=0; j<len; j++){
+        checksum = checksum * 31 + (uint16_t) data[j];
+        energy += (double) data[j] * data[j];
+    }
+    samples += len;
+}
+
+/// Decodes the data with the indicated bandwidth: returns the time in seconds
+double decode(std::vector<uint8_t> &data, int bandwidth){
+    auto start = std::chrono::steady_clock::now();
+    for (int j=0; j<repeat; j++){
+        checksum = 0;
+        energy = 0;
+        samples = 0;
+        MP3DecoderMAD mp3(analyze);
+        mp3.setMaxBandwidth(bandwidth);
+        mp3.begin();
+        mp3.decodeFrames(data.data(), data.size());
+        mp3.end();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeat;
+}
+
+double rms(){
+    return samples > 0 ? sqrt(energy / samples) : 0;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<int> bandwidths;
+    std::vector<uint8_t> file(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3 + BabyElephantWalk60_mp3_len);
+    for (int j=1; j<argc; j++){
+        int bandwidth = atoi(argv[j]);
+        if (bandwidth > 0){
+            bandwidths.push_back(bandwidth);
+            continue;
+        }
+        FILE *in = fopen(argv[j], "rb");
+        if (in == nullptr){
+            printf("could not open %s\n", argv[j]);
+            return 1;
+        }
+        file.resize(64 * 1024 * 1024);
+        file.resize(fread(file.data(), 1, file.size(), in));
+        fclose(in);
+    }
+    if (bandwidths.empty()) bandwidths = {16000, 11025, 8000, 4000};
+
+    // the guard makes sure that the last frame is decoded as well
+    file.resize(file.size() + MAD_BUFFER_GUARD);
+
+    double full_time = decode(file, 0);
+    double full_rms = rms();
+    uint32_t full_checksum = checksum;
+    int full_rate = sample_rate;
+    printf("full    : %.4f s, sample rate: %d, samples: %zu\n", full_time, sample_rate, samples);
+
+    for (int bandwidth : bandwidths){
+        double time = decode(file, bandwidth);
+        printf("%5d Hz: %.4f s (%.1fx faster), sample rate: %d, samples: %zu, rms: %+.2f dB\n", bandwidth, time,
+            full_time / time, sample_rate, samples, 20.0 * log10(rms() / full_rms));
+    }
+
+    // the complete bandwidth must not change the result
+    decode(file, full_rate / 2);
+    printf("%5d Hz: checksum %08x %s\n", full_rate / 2, checksum, checksum == full_checksum ? "(identical)" : "(ERROR)");
+    return checksum == full_checksum ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+/**
+ * @file mp3_broadcast.cpp
+ * @author Phil Schatzmann
+ * @brief Decodes the embedded mp3 file once for many listeners with the MadBroadcastDecoder:
+ * each listener runs in its own thread and converts the shared frames to int16_t. Half of the
+ * listeners join late and start at the next frame. We verify that each listener receives the
+ * same data as a single decoder (from the frame where it joined) and report the time. W/o the
+ * blocking mode an idle subscriber only skips frames itself and does not stop the others.
+ * Usage: mp3_broadcast [listeners]
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MadBroadcastDecoder.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <atomic>
+
+using namespace libmad;
+
+const size_t write_size = 1024;
+
+/// Collects the result of a single decoder
+struct Collector : public MadPCMOutput {
+    std::vector<int16_t> data;
+
+    void writeFrame(struct mad_header const *, struct mad_pcm *pcm) override {
+        for (int j=0; j<pcm->length; j++){
+            for (int ch=0; ch<pcm->channels; ch++){
+                data.push_back(MP3DecoderMAD::scale(pcm->samples[ch][j]));
+            }
+        }
+    }
+};
+
+/// Listener which collects the received data
+struct Listener {
+    MadBroadcastSubscriber subscriber;
+    std::vector<int16_t> data;
+    size_t start_frame = 0;
+};
+
+int main(int argc, char *argv[]) {
+    size_t count = argc > 1 ? atoi(argv[1]) : 32;
+    if (count == 0) count = 32;
+
+    // reference: a single decoder
+    Collector collector;
+    std::vector<int16_t> &reference = collector.data;
+    MP3DecoderMAD mp3;
+    mp3.setOutput(collector);
+    mp3.begin();
+    for (size_t pos=0; pos<BabyElephantWalk60_mp3_len; pos+=write_size){
+        mp3.write(BabyElephantWalk60_mp3 + pos, min(write_size, BabyElephantWalk60_mp3_len - pos));
+    }
+    mp3.end();
+
+    MadBroadcastDecoder broadcast;
+    broadcast.setBlocking(true);
+    std::vector<std::unique_ptr<Listener>> listeners;
+    for (size_t j=0; j<count; j++){
+        listeners.emplace_back(new Listener());
+    }
+    std::atomic<bool> ended{false};
+    broadcast.begin();
+
+    // listeners: the second half joins after 100 frames
+    std::vector<std::thread> threads;
+    for (size_t j=0; j<count; j++){
+        Listener *listener = listeners[j].get();
+        if (j < count / 2) listener->subscriber.subscribe(broadcast);
+        threads.emplace_back([&, listener, j](){
+            if (j >= count / 2){
+                while (broadcast.frames() < 100) std::this_thread::yield();
+                listener->subscriber.subscribe(broadcast);
+                listener->start_frame = listener->subscriber.position();
+            }
+            int16_t pcm[1024];
+            while (true){
+                bool is_end = ended;
+                size_t len = listener->subscriber.readPCM(pcm, 512);
+                if (len == 0){
+                    if (is_end) break;
+                    std::this_thread::yield();
+                    continue;
+                }
+                listener->data.insert(listener->data.end(), pcm, pcm + len * listener->subscriber.audioInfo().channels);
+            }
+            listener->subscriber.unsubscribe();
+        });
+    }
+
+    // producer: decodes the data once and waits for slow listeners
+    auto start = std::chrono::steady_clock::now();
+    for (size_t pos=0; pos<BabyElephantWalk60_mp3_len; pos+=write_size){
+        broadcast.write(BabyElephantWalk60_mp3 + pos, min(write_size, BabyElephantWalk60_mp3_len - pos));
+    }
+    broadcast.end();
+    ended = true;
+    for (auto &thread : threads) thread.join();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // the data of each listener must match the end of the reference
+    size_t errors = 0, late = 0;
+    for (auto &listener : listeners){
+        std::vector<int16_t> &data = listener->data;
+        if (listener->start_frame > 0) late++;
+        bool ok = data.size() <= reference.size() && (listener->start_frame > 0 || data.size() == reference.size())
+            && std::equal(data.begin(), data.end(), reference.end() - data.size());
+        if (!ok) errors++;
+    }
+    printf("listeners: %zu (late: %zu), frames: %zu, overruns: %zu, errors: %zu\n", count, late, broadcast.frames(), broadcast.overruns(), errors);
+    printf("%.3f sec, %.1f us per listener and frame\n", sec, sec * 1e6 / count / broadcast.frames());
+
+    // w/o blocking: a fast listener and an idle one which never reads
+    const size_t block_count = 64;
+    MadBroadcastDecoder non_blocking(block_count);
+    Listener fast, idle;
+    fast.subscriber.subscribe(non_blocking);
+    idle.subscriber.subscribe(non_blocking);
+    non_blocking.begin();
+    std::atomic<bool> fast_ended{false};
+    std::thread fast_thread([&](){
+        int16_t pcm[1024];
+        while (true){
+            bool is_end = fast_ended;
+            size_t len = fast.subscriber.readPCM(pcm, 512);
+            if (len == 0){
+                if (is_end) break;
+                std::this_thread::yield();
+                continue;
+            }
+            fast.data.insert(fast.data.end(), pcm, pcm + len * fast.subscriber.audioInfo().channels);
+        }
+    });
+    // the producer does not overtake the fast listener: a write decodes less than 64 frames
+    for (size_t pos=0; pos<BabyElephantWalk60_mp3_len; pos+=write_size){
+        while (fast.subscriber.position() < non_blocking.frames()) std::this_thread::yield();
+        non_blocking.write(BabyElephantWalk60_mp3 + pos, min(write_size, BabyElephantWalk60_mp3_len - pos));
+    }
+    non_blocking.end();
+    fast_ended = true;
+    fast_thread.join();
+    bool fast_ok = fast.data == reference && fast.subscriber.overruns() == 0 && non_blocking.overruns() == 0;
+    bool idle_ok = idle.subscriber.overruns() >= non_blocking.frames() - block_count;
+    printf("non blocking: frames: %zu, fast listener: %s, idle listener overruns: %zu\n", non_blocking.frames(),
+        fast_ok ? "ok" : "ERROR", idle.subscriber.overruns());
+    return errors == 0 && fast_ok && idle_ok ? 0 : 2;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file mp3_cache.cpp
+ * @author Phil Schatzmann
+ * @brief Simulates an editor which repeatedly plays and scrubs regions of the embedded mp3
+ * file with the MadCachedDecoder: we compare the number of frames decoded by libmad and the
+ * time with and w/o MadFrameCache (uncompressed and compressed) and verify that each played
+ * frame is identical to a sequential decoding.
+ * Usage: mp3_cache [budget KB]
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MadFrameCache.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <random>
+#include <chrono>
+
+using namespace libmad;
+
+std::vector<std::vector<int16_t>> reference;
+std::vector<int16_t> played;
+
+void collect(MadAudioInfo &info, int16_t *data, size_t len) {
+    played.insert(played.end(), data, data + len);
+}
+
+/// Plays random regions of 20 frames within a window which moves slowly through the file
+size_t play(MadCachedDecoder &mp3, size_t &errors){
+    std::mt19937 random(1);
+    size_t frames = 0;
+    for (size_t pass=0; pass<400; pass++){
+        size_t window = pass * 4;
+        size_t first = min(window + random() % 100, mp3.frames() - 20);
+        mp3.seek(first);
+        for (size_t frame=first; frame<first + 20; frame++){
+            played.clear();
+            mp3.decode(1);
+            if (played != reference[frame]) errors++;
+            frames++;
+        }
+    }
+    return frames;
+}
+
+int main(int argc, char *argv[]) {
+    size_t budget = (argc > 1 ? atoi(argv[1]) : 1024) * 1024;
+    std::vector<uint8_t> data(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3 + BabyElephantWalk60_mp3_len);
+    // make sure that the last frame is decoded as well
+    data.resize(data.size() + MAD_BUFFER_GUARD, 0);
+
+    // reference: sequential decoding of all frames
+    MadCachedDecoder mp3(collect);
+    mp3.begin(1, data.data(), data.size());
+    for (size_t j=0; j<mp3.frames(); j++){
+        played.clear();
+        mp3.decode(1);
+        reference.push_back(played);
+    }
+
+    printf("%-12s %8s %8s %8s %8s %10s %8s %6s\n", "cache", "played", "decoded", "hit rate", "cached", "memory", "sec", "errors");
+    for (int variant=0; variant<3; variant++){
+        MadFrameCache cache(budget);
+        cache.setCompression(variant == 2);
+        if (variant > 0) mp3.setCache(cache);
+        mp3.begin(1, data.data(), data.size());
+        size_t errors = 0;
+        auto start = std::chrono::steady_clock::now();
+        size_t frames = play(mp3, errors);
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const char *names[] = {"none", "raw", "compressed"};
+        printf("%-12s %8zu %8zu %7.1f%% %8zu %10zu %8.3f %6zu\n", names[variant], frames, mp3.decodedFrames(), cache.hitRate() * 100.0f,
+            cache.count(), cache.size(), sec, errors);
+        mp3.end();
+        if (errors > 0) return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+/**
+ * @file mp3_equalizer.cpp
+ * @author Phil Schatzmann
+ * @brief Subband equalizer: we decode the embedded mp3 file with the MadEqualizer and compare the
+ * time with the usual approach, a cascade of 10 peaking biquads (one per octave) on the int16_t
+ * result in the data callback. We check that a flat equalizer does not change the result and
+ * that the same gain in all subbands gives the scaled result, because the synthesis is linear
+ * (up to the rounding of the fixed point multiplications).
+ * Usage: mp3_equalizer
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MadEqualizer.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+
+using namespace libmad;
+
+const int repeat = 5;
+const float bands_hz[10] = {31.25f, 62.5f, 125, 250, 500, 1000, 2000, 4000, 8000, 16000};
+const float bands_db[10] = {6, 6, 6, 4, 0, 0, 0, -3, -6, -12};
+std::vector<int16_t> result;
+
+/// Peaking biquad (Audio EQ Cookbook) with its state for 2 channels
+struct Biquad {
+    float b0, b1, b2, a1, a2;
+    float x1[2] = {0}, x2[2] = {0}, y1[2] = {0}, y2[2] = {0};
+
+    Biquad(float hz, float db, float sampleRate, float q = 1.41f){
+        float a = powf(10.0f, db / 40.0f);
+        float w0 = 2.0f * (float) M_PI * hz / sampleRate;
+        float alpha = sinf(w0) / (2.0f * q);
+        float a0 = 1.0f + alpha / a;
+        b0 = (1.0f + alpha * a) / a0;
+        b1 = -2.0f * cosf(w0) / a0;
+        b2 = (1.0f - alpha * a) / a0;
+        a1 = b1;
+        a2 = (1.0f - alpha / a) / a0;
+    }
+
+    float process(float x, int ch){
+        float y = b0 * x + b1 * x1[ch] + b2 * x2[ch] - a1 * y1[ch] - a2 * y2[ch];
+        x2[ch] = x1[ch]; x1[ch] = x;
+        y2[ch] = y1[ch]; y1[ch] = y;
+        return y;
+    }
+};
+
+std::vector<Biquad> biquads;
+
+void store(MadAudioInfo &info, int16_t *data, size_t len) {
+    result.insert(result.end(), data, data + len);
+}
+
+/// Usual approach: a biquad cascade on the int16_t result
+void equalizeInCallback(MadAudioInfo &info, int16_t *data, size_t len) {
+    if (biquads.empty()){
+        for (int j=0; j<10; j++){
+            if (bands_hz[j] < 0.45f * info.sample_rate) biquads.push_back(Biquad(bands_hz[j], bands_db[j], info.sample_rate));
+        }
+    }
+    for (size_t j=0; j<len; j++){
+        int ch = j % info.channels;
+        float sample = data[j];
+        for (Biquad &biquad : biquads) sample = biquad.process(sample, ch);
+        data[j] = sample > 32767.0f ? 32767 : sample < -32767.0f ? -32767 : (int16_t) sample;
+    }
+    store(info, data, len);
+}
+
+double decode(std::vector<uint8_t> &data, MP3DataCallback cb, MadEqualizer *equalizer){
+    auto start = std::chrono::steady_clock::now();
+    for (int j=0; j<repeat; j++){
+        result.clear();
+        biquads.clear();
+        MP3DecoderMAD mp3(cb);
+        if (equalizer != nullptr) mp3.setFrameFilter(MadEqualizer::filter, equalizer);
+        mp3.begin();
+        mp3.decodeFrames(data.data(), data.size());
+        mp3.end();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeat;
+}
+
+/// Maximum difference of the result to the reference scaled with the indicated gain
+int maxDifference(std::vector<int16_t> &reference, float gain){
+    int diff = 0;
+    for (size_t j=0; j<reference.size() && j<result.size(); j++){
+        diff = std::max(diff, (int) fabs(result[j] - reference[j] * gain));
+    }
+    return diff;
+}
+
+/// Ratio of the difference to the reference scaled with the indicated gain in dB
+double errorDb(std::vector<int16_t> &reference, float gain){
+    double error = 0, energy = 0;
+    for (size_t j=0; j<reference.size() && j<result.size(); j++){
+        double expected = reference[j] * gain;
+        error += (result[j] - expected) * (result[j] - expected);
+        energy += expected * expected;
+    }
+    return 10.0 * log10(error / energy + 1e-20);
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<uint8_t> file(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3 + BabyElephantWalk60_mp3_len);
+    // the guard makes sure that the last frame is decoded as well
+    file.resize(file.size() + MAD_BUFFER_GUARD);
+
+    double time = decode(file, store, nullptr);
+    std::vector<int16_t> reference = result;
+    printf("no equalizer       : %.4f s\n", time);
+
+    MadEqualizer flat;
+    decode(file, store, &flat);
+    int flat_difference = maxDifference(reference, 1.0f);
+    printf("flat equalizer     : max difference: %d\n", flat_difference);
+
+    MadEqualizer half;
+    half.setSmoothing(1);
+    for (int sb=0; sb<32; sb++) half.setGain(sb, 0.5f);
+    decode(file, store, &half);
+    double half_error = errorDb(reference, 0.5f);
+    printf("all subbands -6 dB : error: %.1f dB, max difference: %d\n", half_error, maxDifference(reference, 0.5f));
+
+    // the same curve with the subband equalizer: we use the gain at the center of each subband
+    int sample_rate = 22050;
+    MadEqualizer equalizer;
+    for (int sb=0; sb<32; sb++){
+        float hz = (sb + 0.5f) * sample_rate / 64.0f;
+        float octave = log2f(hz / bands_hz[0]);
+        int band = std::min(9, std::max(0, (int) lroundf(octave)));
+        equalizer.setGainDb(sb, bands_db[band]);
+    }
+    double eq_time = decode(file, store, &equalizer);
+    printf("subband equalizer  : %.4f s (+%.4f s)\n", eq_time, eq_time - time);
+
+    double biquad_time = decode(file, equalizeInCallback, nullptr);
+    printf("biquad cascade     : %.4f s (+%.4f s), biquads: %zu\n", biquad_time, biquad_time - time, biquads.size());
+    return flat_difference == 0 && half_error < -40.0 ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+/**
+ * @file mp3_gain.cpp
+ * @author Phil Schatzmann
+ * @brief Gain and ReplayGain in the conversion of the decoder: we compare the result and the
+ * time of the decoding with a gain with the usual approach, where the int16_t result is scaled
+ * in the data callback. We also fade out the embedded mp3 file with a ramp, and we determine the
+ * ReplayGain from a LAME tag and from an ID3v2 tag which we add to the data.
+ * Usage: mp3_gain [gain in dB]
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MP3DecoderMAD.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+
+using namespace libmad;
+
+const int repeat = 5;
+std::vector<int16_t> result;
+float callback_gain = 1.0f;
+MP3DecoderMAD *p_decoder = nullptr;
+size_t fade_start = 0;      // sample (per channel) at which we start to fade out
+size_t fade_samples = 0;
+MadAudioInfo audio_info;
+
+void store(MadAudioInfo &info, int16_t *data, size_t len) {
+    audio_info = info;
+    result.insert(result.end(), data, data + len);
+}
+
+/// Usual approach: we scale the int16_t result in the callback
+void scaleInCallback(MadAudioInfo &info, int16_t *data, size_t len) {
+    for (size_t j=0; j<len; j++){
+        float sample = data[j] * callback_gain;
+        data[j] = sample > 32767.0f ? 32767 : sample < -32767.0f ? -32767 : (int16_t) sample;
+    }
+    store(info, data, len);
+}
+
+/// Starts the fade out at the indicated position
+void fadeOut(MadAudioInfo &info, int16_t *data, size_t len) {
+    if (fade_start > 0 && result.size() / info.channels >= fade_start){
+        p_decoder->setGain(0.0f, fade_samples);
+        fade_start = 0;
+    }
+    store(info, data, len);
+}
+
+double decode(std::vector<uint8_t> &data, MP3DataCallback cb, float gain){
+    auto start = std::chrono::steady_clock::now();
+    for (int j=0; j<repeat; j++){
+        result.clear();
+        MP3DecoderMAD mp3(cb);
+        mp3.setGain(gain);
+        mp3.begin();
+        mp3.decodeFrames(data.data(), data.size());
+        mp3.end();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeat;
+}
+
+/// Maximum difference of the result to the reference scaled with the indicated gain: we skip the clipped samples of the reference
+int maxDifference(std::vector<int16_t> &reference, float gain){
+    int diff = 0;
+    for (size_t j=0; j<reference.size() && j<result.size(); j++){
+        if (abs(reference[j]) >= 32767) continue;
+        float expected = reference[j] * gain;
+        if (expected > 32767.0f) expected = 32767.0f;
+        if (expected < -32767.0f) expected = -32767.0f;
+        diff = std::max(diff, (int) fabs(result[j] - expected));
+    }
+    return diff;
+}
+
+/// Number of samples which are clipped in the result
+size_t clipped(){
+    size_t count = 0;
+    for (int16_t sample : result){
+        if (abs(sample) >= 32767) count++;
+    }
+    return count;
+}
+
+/// Sets the Radio Replay Gain of the LAME tag in the first frame
+bool setLAMEReplayGain(std::vector<uint8_t> &data, float db){
+    for (size_t j=0; j + 17 < data.size() && j < 2048; j++){
+        if (memcmp(&data[j], "LAME", 4) == 0){
+            int value = (int) lroundf(fabsf(db) * 10.0f);
+            // name code 1 (radio), originator 3 (user), sign, gain in 0.1 dB
+            int field = (1 << 13) | (3 << 10) | (db < 0 ? 0x200 : 0) | value;
+            data[j + 15] = field >> 8;
+            data[j + 16] = field & 0xff;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Creates an ID3v2.4 tag with a REPLAYGAIN_TRACK_GAIN frame
+std::vector<uint8_t> createID3(const char *value){
+    std::vector<uint8_t> content = {3};
+    const char *key = "replaygain_track_gain";
+    content.insert(content.end(), key, key + strlen(key) + 1);
+    content.insert(content.end(), value, value + strlen(value));
+    std::vector<uint8_t> tag = {'I','D','3',4,0,0};
+    size_t frame_size = content.size();
+    size_t tag_size = 10 + frame_size;
+    for (int shift : {21, 14, 7, 0}) tag.push_back((tag_size >> shift) & 0x7f);
+    tag.insert(tag.end(), {'T','X','X','X'});
+    for (int shift : {21, 14, 7, 0}) tag.push_back((frame_size >> shift) & 0x7f);
+    tag.insert(tag.end(), {0, 0});
+    tag.insert(tag.end(), content.begin(), content.end());
+    return tag;
+}
+
+int main(int argc, char *argv[]) {
+    float gain_db = argc > 1 ? atof(argv[1]) : -6.0f;
+    float gain = powf(10.0f, gain_db / 20.0f);
+    std::vector<uint8_t> file(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3 + BabyElephantWalk60_mp3_len);
+    // the guard makes sure that the last frame is decoded as well
+    file.resize(file.size() + MAD_BUFFER_GUARD);
+
+    double time = decode(file, store, 1.0f);
+    std::vector<int16_t> reference = result;
+    printf("unity gain          : %.4f s, samples: %zu, clipped: %zu\n", time, reference.size(), clipped());
+
+    callback_gain = gain;
+    time = decode(file, scaleInCallback, 1.0f);
+    printf("%+.1f dB in callback : %.4f s, max difference: %d\n", gain_db, time, maxDifference(reference, gain));
+
+    time = decode(file, store, gain);
+    int difference = maxDifference(reference, gain);
+    printf("%+.1f dB in decoder  : %.4f s, max difference: %d, clipped: %zu\n", gain_db, time, difference, clipped());
+
+    // fade out over 1 second after 10 seconds
+    result.clear();
+    MP3DecoderMAD mp3(fadeOut);
+    p_decoder = &mp3;
+    mp3.begin();
+    int sample_rate = audio_info.sample_rate;
+    fade_start = 10 * sample_rate;
+    fade_samples = sample_rate;
+    mp3.decodeFrames(file.data(), file.size());
+    mp3.end();
+    size_t last = 0;
+    for (size_t j=0; j<result.size(); j++){
+        if (result[j] != 0) last = j;
+    }
+    printf("fade out            : from 10.00 s, last sound at %.2f s\n", (double) (last / audio_info.channels) / sample_rate);
+
+    // ReplayGain from the LAME tag
+    std::vector<uint8_t> lame = file;
+    setLAMEReplayGain(lame, gain_db);
+    result.clear();
+    MP3DecoderMAD replay(store);
+    replay.setReplayGain(true);
+    replay.begin();
+    replay.decodeFrames(lame.data(), lame.size());
+    replay.end();
+    difference = std::max(difference, maxDifference(reference, gain));
+    printf("LAME ReplayGain     : %+.1f dB, gain: %.3f, max difference: %d\n", replay.replayGainDb(), replay.gain(), maxDifference(reference, gain));
+
+    // ReplayGain from an ID3v2 tag
+    std::vector<uint8_t> tagged = createID3("-6.54 dB");
+    tagged.insert(tagged.end(), file.begin(), file.end());
+    float db = 0;
+    bool found = MadReplayGain::read(tagged.data(), tagged.size(), db);
+    printf("ID3v2 ReplayGain    : %s %+.2f dB\n", found ? "found" : "not found", db);
+    return difference <= 1 && found ? 0 : 1;
+}
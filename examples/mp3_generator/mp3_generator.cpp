@@ -0,0 +1,114 @@
+/**
+ * @file mp3_generator.cpp
+ * @author Phil Schatzmann
+ * @brief C++20 generator API: many streams are decoded on a single thread by resuming their
+ * generators in turn. Each stream receives its data in small bursts, so the generators are
+ * regularly suspended because no input is available. We verify that each stream provides the
+ * same result as a simple range based for loop over the complete file and report the throughput.
+ * Usage: mp3_generator [streams]
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MadFrameGenerator.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <memory>
+#include <chrono>
+
+using namespace libmad;
+
+/// Source which provides the data in bursts like e.g. a network stream: every other call has no data
+struct BurstSource {
+    const uint8_t *data = BabyElephantWalk60_mp3;
+    size_t size = BabyElephantWalk60_mp3_len;
+    size_t pos = 0;
+    size_t calls = 0;
+
+    size_t read(uint8_t *buffer, size_t len){
+        if (calls++ % 2 == 0) return 0;
+        size_t result = min(min(len, (size_t) 417), size - pos);
+        memcpy(buffer, data + pos, result);
+        pos += result;
+        return result;
+    }
+
+    bool isEnd(){
+        return pos >= size;
+    }
+};
+
+/// Decoding state of a stream
+struct Stream {
+    BurstSource source;
+    MadFrameGenerator frames = decodeFrames(source);
+    uint32_t checksum = 0;
+    size_t samples = 0;
+    size_t waits = 0;
+    mad_timer_t end = mad_timer_zero;
+};
+
+void add(uint32_t &checksum, size_t &samples, const MadFrameView &frame){
+    const struct mad_pcm *pcm = frame.pcm;
+    for (int j=0; j<pcm->length; j++){
+        for (int ch=0; ch<pcm->channels; ch++){
+            checksum = checksum * 31 + (uint16_t) MP3DecoderMAD::scale(pcm->samples[ch][j]);
+        }
+    }
+    samples += pcm->length * pcm->channels;
+}
+
+int main(int argc, char *argv[]) {
+    size_t count = argc > 1 ? atoi(argv[1]) : 16;
+    if (count == 0) count = 16;
+
+    // reference: all data is available
+    MadMemorySource memory(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3_len);
+    uint32_t ref_checksum = 0;
+    size_t ref_samples = 0, ref_frames = 0;
+    mad_timer_t duration = mad_timer_zero;
+    for (const MadFrameView &frame : decodeFrames(memory)){
+        add(ref_checksum, ref_samples, frame);
+        ref_frames = frame.index + 1;
+        duration = frame.timestamp;
+        mad_timer_t len;
+        mad_timer_set(&len, 0, frame.pcm->length, frame.pcm->samplerate);
+        mad_timer_add(&duration, len);
+    }
+    printf("reference: frames %zu, samples %zu, duration %lu ms, checksum %08x\n", ref_frames, ref_samples,
+        mad_timer_count(duration, MAD_UNITS_MILLISECONDS), ref_checksum);
+
+    // round robin over all streams on a single thread
+    std::vector<std::unique_ptr<Stream>> streams;
+    for (size_t j=0; j<count; j++){
+        streams.emplace_back(new Stream());
+    }
+    auto start = std::chrono::steady_clock::now();
+    size_t active = count;
+    while (active > 0){
+        active = 0;
+        for (auto &stream : streams){
+            if (!stream->frames.next()) continue;
+            active++;
+            const MadFrameView &frame = stream->frames.value();
+            if (frame.isWaiting()){
+                stream->waits++;
+                continue;
+            }
+            add(stream->checksum, stream->samples, frame);
+        }
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t errors = 0;
+    for (auto &stream : streams){
+        if (stream->checksum != ref_checksum || stream->samples != ref_samples) errors++;
+    }
+    double audio_sec = mad_timer_count(duration, MAD_UNITS_MILLISECONDS) / 1000.0 * count;
+    printf("streams: %zu, waits per stream: %zu, errors: %zu, %.1f sec, x-rt %.1f\n", count, streams[0]->waits, errors, sec, audio_sec / sec);
+    return errors == 0 ? 0 : 2;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file mp3_latency.cpp
+ * @author Phil Schatzmann
+ * @brief Measures the time from the start of the decoding of a frame until the first PCM
+ * data is available with frame and with granule decoding and verifies that both results
+ * are identical. MPEG-2 LSF files (like the default file) have only one granule per
+ * frame, so you need to provide a MPEG-1 file to see a difference. In a damaged file the
+ * granule decoding mutes a second granule which can not be decoded, while the frame
+ * decoding drops the whole frame: we check that each frame still provides all samples.
+ * Usage: mp3_latency [file.mp3]
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MP3DecoderMAD.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <vector>
+#include <chrono>
+
+using namespace libmad;
+
+/// Decoding result and time to first PCM per frame in microseconds
+struct Result {
+    std::vector<int16_t> pcm;
+    size_t frames = 0;
+    size_t muted = 0;                  // granules which could not be decoded
+    size_t samples = 0;                // decoded samples per channel
+    size_t expected_samples = 0;       // samples per channel of the decoded frames
+    double first_avg_us = 0;
+    double first_max_us = 0;
+    double total_sec = 0;
+};
+
+double microseconds(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+void append(Result &result, struct mad_pcm &pcm){
+    result.samples += pcm.length;
+    for (int j=0; j<pcm.length; j++){
+        for (int ch=0; ch<pcm.channels; ch++){
+            result.pcm.push_back(MP3DecoderMAD::scale(pcm.samples[ch][j]));
+        }
+    }
+}
+
+Result decode(std::vector<uint8_t> &data, bool granules){
+    Result result;
+    struct mad_stream stream;
+    struct mad_frame frame;
+    struct mad_synth synth;
+    mad_stream_init(&stream);
+    mad_frame_init(&frame);
+    mad_synth_init(&synth);
+    mad_stream_options(&stream, granules ? MAD_OPTION_GRANULES : 0);
+    mad_stream_buffer(&stream, data.data(), data.size());
+    double first_sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    while(true){
+        auto frame_start = std::chrono::steady_clock::now();
+        if (mad_frame_decode(&frame, &stream)==-1){
+            if (MAD_RECOVERABLE(stream.error)) continue;
+            break;
+        }
+        mad_synth_frame(&synth, &frame);
+        // the first PCM data of the frame is available
+        double first = microseconds(frame_start);
+        first_sum += first;
+        if (first > result.first_max_us) result.first_max_us = first;
+        append(result, synth.pcm);
+        result.frames++;
+        result.expected_samples += 32 * MAD_NSBSAMPLES(&frame.header);
+
+        // remaining granules
+        while (mad_frame_decode_granule(&frame, &stream)==1){
+            if (stream.error != MAD_ERROR_NONE) result.muted++;
+            mad_synth_frame(&synth, &frame);
+            append(result, synth.pcm);
+        }
+    }
+    result.total_sec = microseconds(start) / 1000000.0;
+    result.first_avg_us = result.frames > 0 ? first_sum / result.frames : 0;
+    mad_synth_finish(&synth);
+    mad_frame_finish(&frame);
+    mad_stream_finish(&stream);
+    return result;
+}
+
+std::vector<uint8_t> load(const char *path){
+    std::vector<uint8_t> result;
+    if (path == nullptr){
+        result.assign(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3 + BabyElephantWalk60_mp3_len);
+    } else {
+        FILE *file = fopen(path, "rb");
+        if (file == nullptr) return result;
+        uint8_t tmp[4096];
+        size_t len;
+        while ((len = fread(tmp, 1, sizeof(tmp), file)) > 0){
+            result.insert(result.end(), tmp, tmp + len);
+        }
+        fclose(file);
+    }
+    // make sure that the last frame is decoded as well
+    result.resize(result.size() + MAD_BUFFER_GUARD, 0);
+    return result;
+}
+
+void print(const char *name, Result &result){
+    printf("%-8s frames: %zu, first PCM avg: %.2f us, max: %.2f us, total: %.3f sec\n", name, result.frames,
+        result.first_avg_us, result.first_max_us, result.total_sec);
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<uint8_t> data = load(argc > 1 ? argv[1] : nullptr);
+    if (data.size() <= MAD_BUFFER_GUARD){
+        printf("could not read %s\n", argv[1]);
+        return 1;
+    }
+
+    Result frames = decode(data, false);
+    Result granules = decode(data, true);
+    print("frame", frames);
+    print("granule", granules);
+
+    if (frames.samples != frames.expected_samples || granules.samples != granules.expected_samples){
+        printf("ERROR: frames are incomplete\n");
+        return 1;
+    }
+    if (granules.muted > 0){
+        // the frames with a muted granule are missing in the frame decoding
+        bool ok = granules.frames == frames.frames + granules.muted;
+        printf("damaged file: %zu granules muted %s\n", granules.muted, ok ? "" : "ERROR");
+        return ok ? 0 : 1;
+    }
+    if (frames.pcm != granules.pcm){
+        printf("ERROR: result differs\n");
+        return 1;
+    }
+    printf("result is identical\n");
+    return 0;
+}
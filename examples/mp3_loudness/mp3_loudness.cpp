@@ -0,0 +1,135 @@
+/**
+ * @file mp3_loudness.cpp
+ * @author Phil Schatzmann
+ * @brief Loudness (EBU R128) and true peak during the decoding: we check the MadLoudnessMeter with
+ * sine waves (EBU Tech 3341) and measure the embedded mp3 file while it is decoded. We compare the
+ * time with a meter on the int16_t result and normalize the file to the indicated target loudness.
+ * Usage: mp3_loudness [target in LUFS]
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MP3DecoderMAD.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+
+using namespace libmad;
+
+const int repeat = 5;
+MadLoudnessMeter output_meter;
+
+/// Measures the int16_t result
+void measure(MadAudioInfo &info, int16_t *data, size_t len) {
+    mad_fixed_t samples[2][MAD_MAX_RESULT_BUFFER_SIZE / 2];
+    size_t frames = len / info.channels;
+    for (size_t j=0; j<frames; j++){
+        for (int ch=0; ch<info.channels; ch++){
+            samples[ch][j] = (mad_fixed_t) data[j * info.channels + ch] << (MAD_F_FRACBITS - 15);
+        }
+    }
+    output_meter.write(samples[0], samples[info.channels - 1], frames, info.sample_rate, info.channels);
+}
+
+void ignore(MadAudioInfo &info, int16_t *data, size_t len) {}
+
+/// Decodes the data: returns the time in seconds
+double decode(std::vector<uint8_t> &data, MP3DataCallback cb, MadLoudnessMeter *meter, float gainDb=0.0f){
+    auto start = std::chrono::steady_clock::now();
+    for (int j=0; j<repeat; j++){
+        output_meter.begin();
+        if (meter != nullptr) meter->begin();
+        MP3DecoderMAD mp3(cb);
+        if (meter != nullptr) mp3.setLoudnessMeter(*meter);
+        mp3.setGainDb(gainDb);
+        mp3.begin();
+        mp3.decodeFrames(data.data(), data.size());
+        mp3.end();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeat;
+}
+
+/// Adds a stereo sine wave with the indicated peak level and phase to the meter
+void sine(MadLoudnessMeter &meter, int sampleRate, double hz, double db, double seconds, double phase=0){
+    mad_fixed_t samples[1000];
+    double amplitude = pow(10.0, db / 20.0);
+    size_t total = (size_t) (seconds * sampleRate);
+    static size_t pos = 0;
+    for (size_t n=0; n<total; n+=1000){
+        for (int j=0; j<1000; j++){
+            samples[j] = mad_f_tofixed(amplitude * sin(2.0 * M_PI * hz * pos++ / sampleRate + phase));
+        }
+        meter.write(samples, samples, 1000, sampleRate, 2);
+    }
+}
+
+bool check(const char *name, float value, float expected, float tolerance){
+    bool ok = fabsf(value - expected) <= tolerance;
+    printf("%-28s: %7.2f (expected %6.2f) %s\n", name, value, expected, ok ? "" : "ERROR");
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    float target = argc > 1 ? atof(argv[1]) : -23.0f;
+    std::vector<uint8_t> file(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3 + BabyElephantWalk60_mp3_len);
+    // the guard makes sure that the last frame is decoded as well
+    file.resize(file.size() + MAD_BUFFER_GUARD);
+    bool ok = true;
+
+    // EBU Tech 3341 case 1: a stereo sine of 1 kHz at -23 dBFS gives -23 LUFS
+    for (int rate : {48000, 44100}){
+        MadLoudnessMeter meter;
+        sine(meter, rate, 1000, -23, 20);
+        MadLoudness result = meter.loudness();
+        char name[40];
+        snprintf(name, sizeof(name), "1 kHz %d Hz integrated", rate);
+        ok = check(name, result.integrated, -23, 0.1f) && ok;
+        ok = check("  momentary", result.momentary, -23, 0.1f) && ok;
+        ok = check("  short-term", result.short_term, -23, 0.1f) && ok;
+    }
+    // EBU Tech 3341 case 3: the relative gate removes the quiet part, the absolute gate the silence
+    MadLoudnessMeter gated;
+    sine(gated, 48000, 1000, -36, 10);
+    sine(gated, 48000, 1000, -23, 60);
+    sine(gated, 48000, 1000, -36, 10);
+    sine(gated, 48000, 1000, -120, 10);
+    ok = check("gated integrated", gated.loudness().integrated, -23, 0.1f) && ok;
+    // the samples of a sine at a quarter of the sample rate with a phase of 45 degrees are 3 dB below the peak
+    MadLoudnessMeter peak;
+    sine(peak, 44100, 11025, -6, 1, M_PI / 4);
+    ok = check("sample peak dBFS", peak.loudness().samplePeakDb(), -9.01f, 0.05f) && ok;
+    ok = check("true peak dBTP", peak.loudness().truePeakDb(), -6, 0.2f) && ok;
+
+    // the embedded file: decoding w/o and with the meter and with a meter on the result
+    double time = decode(file, ignore, nullptr);
+    printf("decoding                    : %.4f s\n", time);
+    MadLoudnessMeter meter;
+    meter.setTruePeak(false);
+    double meter_time = decode(file, ignore, &meter);
+    printf("with meter                  : %.4f s (+%.4f s)\n", meter_time, meter_time - time);
+    meter.setTruePeak(true);
+    double true_peak_time = decode(file, ignore, &meter);
+    printf("with meter and true peak    : %.4f s (+%.4f s)\n", true_peak_time, true_peak_time - time);
+    double pass_time = decode(file, measure, nullptr);
+    printf("meter on the int16_t result : %.4f s (+%.4f s)\n", pass_time, pass_time - time);
+
+    MadLoudness loudness = meter.loudness();
+    char json[200];
+    loudness.toJson(json, sizeof(json));
+    printf("loudness                    : %s\n", json);
+    ok = check("int16_t result integrated", output_meter.loudness().integrated, loudness.integrated, 0.1f) && ok;
+
+    // normalization with the measured loudness: we measure the int16_t result
+    float gain_db = loudness.gainDb(target);
+    decode(file, measure, nullptr, gain_db);
+    printf("normalization               : %+.2f dB\n", gain_db);
+    // the gain is limited to MAD_GAIN_MAX
+    float expected = std::min(target, loudness.integrated + 20.0f * log10f(MAD_GAIN_MAX));
+    ok = check("normalized integrated", output_meter.loudness().integrated, expected, 0.2f) && ok;
+    return ok ? 0 : 1;
+}
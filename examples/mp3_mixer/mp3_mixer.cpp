@@ -0,0 +1,137 @@
+/**
+ * @file mp3_mixer.cpp
+ * @author Phil Schatzmann
+ * @brief Mixes several streams with the MadMixer: we compare the result and the speed with
+ * the naive approach which converts each stream to int16_t and mixes the converted data.
+ * Finally the stream is mixed into a stereo output at 44100 Hz with a MadLinearResampler.
+ * Usage: mp3_mixer [streams]
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MadMixer.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <memory>
+#include <chrono>
+
+using namespace libmad;
+
+const size_t frames = 256;
+
+/// Provides the embedded mp3 file starting at an offset
+struct Source {
+    size_t pos = 0;
+};
+
+size_t readInput(uint8_t *data, size_t len, void *ref){
+    Source *src = (Source*) ref;
+    size_t result = min(len, BabyElephantWalk60_mp3_len - src->pos);
+    memcpy(data, BabyElephantWalk60_mp3 + src->pos, result);
+    src->pos += result;
+    return result;
+}
+
+/// Decoder with its source
+struct Channel {
+    Source source;
+    MP3DecoderMAD mp3;
+    float gain;
+
+    Channel(size_t offset, float gain){
+        source.pos = offset;
+        this->gain = gain;
+        mp3.setInputSource(readInput, &source);
+    }
+};
+
+std::vector<std::unique_ptr<Channel>> createChannels(size_t count){
+    std::vector<std::unique_ptr<Channel>> result;
+    for (size_t j=0; j<count; j++){
+        result.emplace_back(new Channel(j * 10000, 1.5f / count));
+    }
+    return result;
+}
+
+double seconds(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    size_t count = argc > 1 ? atoi(argv[1]) : 4;
+    if (count == 0) count = 4;
+
+    // naive: each stream is converted to int16_t and mixed afterwards
+    auto channels = createChannels(count);
+    std::vector<int16_t> naive;
+    auto start = std::chrono::steady_clock::now();
+    for (auto &channel : channels) channel->mp3.begin();
+    std::vector<int16_t> pcm(frames);
+    std::vector<float> sum(frames);
+    while (true){
+        size_t max_len = 0;
+        std::fill(sum.begin(), sum.end(), 0.0f);
+        for (auto &channel : channels){
+            size_t len = channel->mp3.readPCM(pcm.data(), frames);
+            for (size_t j=0; j<len; j++){
+                sum[j] += pcm[j] * channel->gain;
+            }
+            max_len = std::max(max_len, len);
+        }
+        if (max_len == 0) break;
+        for (size_t j=0; j<max_len; j++){
+            naive.push_back((int16_t) std::max(-32767.0f, std::min(32767.0f, sum[j])));
+        }
+    }
+    double naive_sec = seconds(start);
+
+    // MadMixer: the streams are summed up in fixed point
+    channels = createChannels(count);
+    MadMixer mixer;
+    MadAudioInfo info;
+    info.channels = 1;
+    mixer.setAudioInfo(info);
+    for (auto &channel : channels) mixer.add(channel->mp3, channel->gain);
+    std::vector<int16_t> mixed;
+    start = std::chrono::steady_clock::now();
+    mixer.begin();
+    size_t len;
+    while ((len = mixer.readPCM(pcm.data(), frames)) > 0){
+        mixed.insert(mixed.end(), pcm.data(), pcm.data() + len);
+    }
+    mixer.end();
+    double mixer_sec = seconds(start);
+
+    int max_diff = 0;
+    for (size_t j=0; j<std::min(naive.size(), mixed.size()); j++){
+        max_diff = std::max(max_diff, abs(naive[j] - mixed[j]));
+    }
+    printf("streams: %zu, samples: naive %zu, mixer %zu, max difference %d\n", count, naive.size(), mixed.size(), max_diff);
+    printf("naive: %.3f sec, mixer: %.3f sec\n", naive_sec, mixer_sec);
+
+    // resampling to 44100 Hz stereo
+    channels = createChannels(1);
+    MadLinearResampler resampler;
+    MadMixer stereo;
+    info.sample_rate = 44100;
+    info.channels = 2;
+    stereo.setAudioInfo(info);
+    stereo.add(channels[0]->mp3, 1.0f, &resampler);
+    stereo.begin();
+    std::vector<int16_t> out(frames * 2);
+    size_t total = 0;
+    while ((len = stereo.readPCM(out.data(), frames)) > 0){
+        total += len;
+    }
+    stereo.end();
+    // the first stream provides the longest (mono) data: each input frame covers out/in output frames
+    int in_rate = channels[0]->mp3.audioInfo().sample_rate;
+    size_t expected = (naive.size() * info.sample_rate + in_rate - 1) / in_rate;
+    printf("resampled: %d Hz -> %d Hz, frames %zu (expected %zu)\n", in_rate, info.sample_rate, total, expected);
+
+    return naive.size() == mixed.size() && max_diff <= (int) count && total == expected ? 0 : 2;
+}
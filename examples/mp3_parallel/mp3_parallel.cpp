@@ -0,0 +1,104 @@
+/**
+ * @file mp3_parallel.cpp
+ * @author Phil Schatzmann
+ * @brief Decodes a mp3 file with multiple threads and verifies that the result is identical
+ * to the sequential decoding. Usage: mp3_parallel [file.mp3] [threads]
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MadParallelDecoder.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+using namespace libmad;
+
+std::vector<int16_t> parallel_result;
+
+void pcmDataCallback(MadAudioInfo &info, int16_t *pwm_buffer, size_t len) {
+    parallel_result.insert(parallel_result.end(), pwm_buffer, pwm_buffer + len);
+}
+
+/// Reference: decodes all frames with a single decoder
+std::vector<int16_t> decodeSequential(std::vector<uint8_t> &data){
+    std::vector<int16_t> result;
+    struct mad_stream stream;
+    struct mad_frame frame;
+    struct mad_synth synth;
+    mad_stream_init(&stream);
+    mad_frame_init(&frame);
+    mad_synth_init(&synth);
+    mad_stream_buffer(&stream, data.data(), data.size());
+    while(true){
+        if (mad_frame_decode(&frame, &stream)==-1){
+            if (MAD_RECOVERABLE(stream.error)) continue;
+            break;
+        }
+        mad_synth_frame(&synth, &frame);
+        for (int j=0; j<synth.pcm.length; j++){
+            for (int ch=0; ch<synth.pcm.channels; ch++){
+                result.push_back(MP3DecoderMAD::scale(synth.pcm.samples[ch][j]));
+            }
+        }
+    }
+    mad_synth_finish(&synth);
+    mad_frame_finish(&frame);
+    mad_stream_finish(&stream);
+    return result;
+}
+
+std::vector<uint8_t> load(const char *path){
+    std::vector<uint8_t> result;
+    if (path == nullptr){
+        result.assign(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3 + BabyElephantWalk60_mp3_len);
+    } else {
+        FILE *file = fopen(path, "rb");
+        if (file == nullptr) return result;
+        uint8_t tmp[4096];
+        size_t len;
+        while ((len = fread(tmp, 1, sizeof(tmp), file)) > 0){
+            result.insert(result.end(), tmp, tmp + len);
+        }
+        fclose(file);
+    }
+    // make sure that the last frame is decoded as well
+    result.resize(result.size() + MAD_BUFFER_GUARD, 0);
+    return result;
+}
+
+double seconds(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<uint8_t> data = load(argc > 1 ? argv[1] : nullptr);
+    if (data.size() <= MAD_BUFFER_GUARD){
+        printf("could not read %s\n", argv[1]);
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int16_t> expected = decodeSequential(data);
+    double sequential_sec = seconds(start);
+
+    MadParallelDecoder mp3(pcmDataCallback);
+    if (argc > 2) mp3.setThreads(atoi(argv[2]));
+    start = std::chrono::steady_clock::now();
+    mp3.decode(data.data(), data.size());
+    double parallel_sec = seconds(start);
+
+    printf("frames: %zu, samples: %zu\n", mp3.frameIndex().size(), expected.size());
+    printf("sequential: %.3f sec, parallel: %.3f sec, speedup: %.2f\n", sequential_sec, parallel_sec, sequential_sec / parallel_sec);
+    if (parallel_result != expected){
+        size_t pos = 0;
+        while (pos < expected.size() && pos < parallel_result.size() && expected[pos] == parallel_result[pos]) pos++;
+        printf("ERROR: result differs at sample %zu (%zu samples)\n", pos, parallel_result.size());
+        return 1;
+    }
+    printf("result is identical\n");
+    return 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file mp3_pull.cpp
+ * @author Phil Schatzmann
+ * @brief Pull API: an audio callback requests a fixed number of frames with readPCM() and the
+ * decoder reads the encoded data on demand from the input source. We simulate the audio
+ * callback and report the number of decoded frames which were requested from libmad, the
+ * number of read calls and the checksum of the result. 
+ * Usage: mp3_pull [frames per callback]
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MP3DecoderMAD.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace libmad;
+
+/// Provides the embedded mp3 file in small chunks like e.g. a network stream
+struct Source {
+    const uint8_t *data = BabyElephantWalk60_mp3;
+    size_t size = BabyElephantWalk60_mp3_len;
+    size_t pos = 0;
+    size_t requests = 0;
+} source;
+
+size_t readInput(uint8_t *data, size_t len, void *ref){
+    Source *src = (Source*) ref;
+    size_t result = min(min(len, (size_t) 512), src->size - src->pos);
+    memcpy(data, src->data + src->pos, result);
+    src->pos += result;
+    src->requests++;
+    return result;
+}
+
+void printInfo(MadAudioInfo &info){
+    printf("sample rate: %d, channels: %d\n", info.sample_rate, info.channels);
+}
+
+int main(int argc, char *argv[]) {
+    size_t frames = argc > 1 ? atoi(argv[1]) : 256;
+    if (frames == 0) frames = 256;
+
+    MP3DecoderMAD mp3;
+    mp3.setInfoCallback(printInfo);
+    mp3.setInputSource(readInput, &source);
+    mp3.begin();
+
+    // audio callback: requests always the same number of frames
+    std::vector<int16_t> pcm(frames * 2);
+    uint32_t checksum = 0;
+    size_t total = 0, calls = 0, len;
+    while ((len = mp3.readPCM(pcm.data(), frames)) > 0){
+        size_t samples = len * mp3.audioInfo().channels;
+        for (size_t j=0; j<samples; j++){
+            checksum = checksum * 31 + (uint16_t) pcm[j];
+        }
+        total += len;
+        calls++;
+    }
+    mp3.end();
+
+    printf("frames: %zu, readPCM calls: %zu, input requests: %zu, checksum: %08x\n", total, calls, source.requests, checksum);
+    return 0;
+}
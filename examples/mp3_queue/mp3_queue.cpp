@@ -0,0 +1,117 @@
+/**
+ * @file mp3_queue.cpp
+ * @author Phil Schatzmann
+ * @brief Checks the MadPCMQueue: we provoke an underrun and an overrun, verify that a period
+ * ends at a change of the audio format and decode the embedded mp3 file in a decoder thread,
+ * while the main thread reads periods of a fixed size. The result must be identical to the
+ * direct decoding.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MadPCMQueue.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+using namespace libmad;
+
+const size_t period = 256;
+std::vector<int16_t> reference;
+
+void collect(MadAudioInfo &info, int16_t *data, size_t len) {
+    reference.insert(reference.end(), data, data + len);
+}
+
+bool check(const char *name, bool ok){
+    printf("%-28s: %s\n", name, ok ? "ok" : "ERROR");
+    return ok;
+}
+
+MadAudioInfo audioInfo(int sampleRate, int channels){
+    MadAudioInfo result;
+    result.sample_rate = sampleRate;
+    result.channels = channels;
+    return result;
+}
+
+bool isSilent(const int16_t *data, size_t len){
+    for (size_t j=0; j<len; j++){
+        if (data[j] != 0) return false;
+    }
+    return true;
+}
+
+int main() {
+    bool ok = true;
+    int16_t data[period];
+    std::vector<int16_t> samples(1000, 1);
+
+    // underrun: the empty queue provides silence
+    MadPCMQueue empty(4);
+    size_t len = empty.read(data, period);
+    ok = check("underrun", len == 0 && empty.underruns() == 1 && isSilent(data, period)) && ok;
+
+    // overrun: the frames which do not fit are dropped
+    MadPCMQueue full(4);
+    MadAudioInfo stereo = audioInfo(44100, 2);
+    for (int j=0; j<6; j++){
+        full.write(stereo, samples.data(), 100);
+    }
+    ok = check("overrun", full.overruns() == 2 && full.frames() == 4 && full.availableForWrite() == 0) && ok;
+
+    // format change: the period ends with the last sample of the old format
+    MadPCMQueue queue(4);
+    MadAudioInfo mono = audioInfo(22050, 1);
+    queue.write(stereo, samples.data(), 100);
+    queue.write(mono, samples.data(), 50);
+    len = queue.read(data, period);
+    bool first = len == 100 && queue.audioInfo() == stereo && isSilent(data + len, period - len);
+    len = queue.read(data, period);
+    bool second = len == 50 && queue.audioInfo() == mono && queue.underruns() == 1;
+    ok = check("format change", first && second) && ok;
+
+    // the embedded file is decoded in its own thread
+    std::vector<uint8_t> file(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3 + BabyElephantWalk60_mp3_len);
+    // the guard makes sure that the last frame is decoded as well
+    file.resize(file.size() + MAD_BUFFER_GUARD);
+    MadPCMQueue pcm(32);
+    std::atomic<bool> ended{false};
+    std::thread decoder([&](){
+        MP3DecoderMAD mp3;
+        mp3.setOutput(pcm);
+        mp3.begin();
+        for (size_t pos=0; pos<file.size(); pos+=256){
+            // one write of 256 bytes decodes less than 16 frames
+            while (pcm.availableForWrite() < 16) std::this_thread::yield();
+            mp3.write(file.data() + pos, min((size_t)256, file.size() - pos));
+        }
+        mp3.end();
+        ended = true;
+    });
+    std::vector<int16_t> result;
+    while (!(ended && pcm.available() == 0)){
+        if (pcm.available() < period && !ended){
+            std::this_thread::yield();
+            continue;
+        }
+        len = pcm.read(data, period);
+        result.insert(result.end(), data, data + len);
+    }
+    decoder.join();
+
+    // reference: the same writes w/o queue (the data callback is shared by all decoders)
+    MP3DecoderMAD direct(collect);
+    direct.begin();
+    for (size_t pos=0; pos<file.size(); pos+=256){
+        direct.write(file.data() + pos, min((size_t)256, file.size() - pos));
+    }
+    direct.end();
+    ok = check("decoded in a thread", result == reference && pcm.overruns() == 0) && ok;
+    printf("samples: %zu (expected %zu), frames dropped: %zu\n", result.size(), reference.size(), pcm.overruns());
+    return ok ? 0 : 1;
+}
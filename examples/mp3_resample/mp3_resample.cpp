@@ -0,0 +1,172 @@
+/**
+ * @file mp3_resample.cpp
+ * @author Phil Schatzmann
+ * @brief Fixed output format with setOutputFormat(): we decode the embedded mp3 file (mono, 22050 Hz)
+ * to the indicated sample rate in stereo and compare the time with the decoding in the original
+ * format. We check that the push and the pull API give the same result, that the original format
+ * and a pure channel conversion do not change the samples and we determine the signal to noise ratio
+ * of the MadRateConverter with sine waves for some common sample rates.
+ * Usage: mp3_resample [output sample rate]
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MP3DecoderMAD.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+
+using namespace libmad;
+
+const int repeat = 5;
+std::vector<int16_t> result;
+int info_count = 0;
+MadAudioInfo audio_info;
+
+void store(MadAudioInfo &info, int16_t *data, size_t len) {
+    result.insert(result.end(), data, data + len);
+}
+
+void updateInfo(MadAudioInfo &info){
+    audio_info = info;
+    info_count++;
+}
+
+/// Decodes the data with the push API: returns the time in seconds
+double decode(std::vector<uint8_t> &data, int sampleRate, int channels){
+    auto start = std::chrono::steady_clock::now();
+    for (int j=0; j<repeat; j++){
+        result.clear();
+        info_count = 0;
+        MP3DecoderMAD mp3(store, updateInfo);
+        mp3.setOutputFormat(sampleRate, channels);
+        mp3.begin();
+        mp3.decodeFrames(data.data(), data.size());
+        mp3.end();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeat;
+}
+
+std::vector<uint8_t> *p_data = nullptr;
+size_t data_pos = 0;
+
+size_t input(uint8_t *data, size_t len, void *ref){
+    size_t result = min(len, p_data->size() - data_pos);
+    memcpy(data, p_data->data() + data_pos, result);
+    data_pos += result;
+    return result;
+}
+
+/// Decodes the data with the pull API
+std::vector<int16_t> decodePull(std::vector<uint8_t> &data, int sampleRate, int channels){
+    std::vector<int16_t> pcm;
+    int16_t buffer[333 * 2];
+    p_data = &data;
+    data_pos = 0;
+    MP3DecoderMAD mp3;
+    mp3.setInputSource(input);
+    mp3.setOutputFormat(sampleRate, channels);
+    mp3.begin();
+    size_t frames;
+    while ((frames = mp3.readPCM(buffer, 333)) > 0){
+        pcm.insert(pcm.end(), buffer, buffer + frames * mp3.audioInfo().channels);
+    }
+    mp3.end();
+    return pcm;
+}
+
+int gcd(int a, int b){
+    return b == 0 ? a : gcd(b, a % b);
+}
+
+/// Signal to noise ratio of a converted sine wave in dB
+double sineSNR(int inRate, int outRate, double hz){
+    MadRateConverter converter;
+    converter.setOutput(outRate, 1);
+    converter.begin(inRate, 1);
+    int divisor = gcd(inRate, outRate);
+    int up = outRate / divisor, down = inRate / divisor;
+    // the filter delays the signal by half of its length
+    int taps = MAD_RESAMPLE_TAPS * (down > up ? (down + up - 1) / up : 1);
+    double delay = (up * taps - 1) / 2.0;
+    double signal = 0, noise = 0;
+    size_t out = 0;
+    mad_fixed_t sample[2];
+    for (int n=0; n<inRate; n++){
+        converter.write(mad_f_tofixed(0.5 * sin(2.0 * M_PI * hz * n / inRate)), 0);
+        while (!converter.isInputNeeded()){
+            converter.read(sample);
+            double expected = 0.5 * sin(2.0 * M_PI * hz * ((double) out * down - delay) / up / inRate);
+            // we skip the start of the filter
+            if (out++ > (size_t) 2 * taps * outRate / inRate){
+                double diff = mad_f_todouble(sample[0]) - expected;
+                signal += expected * expected;
+                noise += diff * diff;
+            }
+        }
+    }
+    return 10.0 * log10(signal / noise);
+}
+
+uint32_t checksum(std::vector<int16_t> &data){
+    uint32_t result = 0;
+    for (int16_t sample : data) result = result * 31 + (uint16_t) sample;
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    int sample_rate = argc > 1 ? atoi(argv[1]) : 48000;
+    std::vector<uint8_t> file(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3 + BabyElephantWalk60_mp3_len);
+    // the guard makes sure that the last frame is decoded as well
+    file.resize(file.size() + MAD_BUFFER_GUARD);
+    bool ok = true;
+
+    double time = decode(file, 0, 0);
+    std::vector<int16_t> reference = result;
+    MadAudioInfo reference_info = audio_info;
+    printf("original format : %.4f s, %d Hz, %d channels, samples: %zu\n", time, audio_info.sample_rate, audio_info.channels, result.size());
+
+    // the original format must not change the result
+    decode(file, reference_info.sample_rate, reference_info.channels);
+    bool same = checksum(result) == checksum(reference);
+    printf("same format     : %s\n", same ? "identical" : "ERROR");
+    ok = ok && same;
+
+    // only the channels are converted
+    time = decode(file, 0, 2);
+    bool copied = result.size() == 2 * reference.size();
+    for (size_t j=0; copied && j<reference.size(); j++){
+        copied = result[2 * j] == reference[j] && result[2 * j + 1] == reference[j];
+    }
+    printf("stereo          : %.4f s, %d channels, %s\n", time, audio_info.channels, copied ? "identical" : "ERROR");
+    ok = ok && copied;
+
+    time = decode(file, sample_rate, 2);
+    // the converter provides all output frames which start before the end of the input
+    size_t in_frames = reference.size() / reference_info.channels;
+    size_t expected = (in_frames * sample_rate + reference_info.sample_rate - 1) / reference_info.sample_rate;
+    printf("%6d Hz stereo : %.4f s, %d Hz, %d channels, info callbacks: %d, frames: %zu (expected %zu)\n", sample_rate, time,
+        audio_info.sample_rate, audio_info.channels, info_count, result.size() / 2, expected);
+    ok = ok && audio_info.sample_rate == sample_rate && info_count == 1 && result.size() / 2 == expected;
+
+    std::vector<int16_t> pulled = decodePull(file, sample_rate, 2);
+    bool same_pull = pulled == result;
+    printf("pull API        : %s\n", same_pull ? "identical" : "ERROR");
+    ok = ok && same_pull;
+
+    const int rates[][2] = {{44100, 48000}, {22050, 48000}, {11025, 48000}, {48000, 44100}, {44100, 16000}};
+    for (auto &rate : rates){
+        // the second tone is close to the end of the pass band
+        double hz = 0.3 * std::min(rate[0], rate[1]);
+        double snr = sineSNR(rate[0], rate[1], 1000.0);
+        double snr_high = sineSNR(rate[0], rate[1], hz);
+        printf("%5d -> %5d : 1 kHz SNR %.1f dB, %.0f Hz SNR %.1f dB\n", rate[0], rate[1], snr, hz, snr_high);
+        ok = ok && snr > 60.0 && snr_high > 40.0;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file mp3_ring.cpp
+ * @author Phil Schatzmann
+ * @brief A reader thread (e.g. network) is writing the mp3 data into a lock-free ring buffer
+ * and the main thread is decoding it.
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MadInputRing.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <thread>
+
+using namespace libmad;
+
+size_t sample_count = 0;
+
+void pcmDataCallback(MadAudioInfo &info, int16_t *pwm_buffer, size_t len) {
+    sample_count += len;
+}
+
+MadInputRing ring;
+MP3DecoderMAD mp3(pcmDataCallback);
+std::atomic<bool> is_reading{true};
+
+// simulates the network: writes the data in small chunks
+void reader() {
+    size_t pos = 0;
+    while (pos < BabyElephantWalk60_mp3_len){
+        size_t len = min((size_t)512, BabyElephantWalk60_mp3_len - pos);
+        pos += ring.write(BabyElephantWalk60_mp3 + pos, len);
+        std::this_thread::yield();
+    }
+    // make sure that the last frame is decoded as well
+    uint8_t guard[MAD_BUFFER_GUARD] = {0};
+    size_t written = 0;
+    while (written < sizeof(guard)){
+        written += ring.write(guard + written, sizeof(guard) - written);
+    }
+    is_reading = false;
+}
+
+int main() {
+    mp3.begin();
+    std::thread network(reader);
+    while (is_reading || ring.available() > MAD_BUFFER_GUARD){
+        if (ring.decode(mp3) == 0){
+            if (!is_reading) break;
+            std::this_thread::yield();
+        }
+    }
+    network.join();
+    mp3.end();
+    printf("decoded samples: %zu\n", sample_count);
+    return 0;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file mp3_silence.cpp
+ * @author Phil Schatzmann
+ * @brief Decoding of digital silence: we replace blocks of frames of the embedded mp3 file with
+ * silent frames (w/o Huffman data) like the pauses of a podcast and compare the decoding time
+ * of the original, the stream with pauses and a completely silent stream. Silent granules only
+ * flush the overlap and the synthesis stops once the filterbank has decayed. We also check that
+ * the pauses are decoded as zero samples.
+ * Usage: mp3_silence [frames per block]
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MP3DecoderMAD.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+
+using namespace libmad;
+
+const int repeat = 5;
+size_t samples = 0;
+size_t zero_samples = 0;
+
+void count(MadAudioInfo &info, int16_t *data, size_t len) {
+    for (size_t j=0; j<len; j++){
+        if (data[j] == 0) zero_samples++;
+    }
+    samples += len;
+}
+
+/// Replaces every other block of frames with silent frames: returns the number of replaced frames
+size_t addPauses(std::vector<uint8_t> &data, size_t block){
+    std::vector<uint8_t> copy = data;
+    copy.resize(copy.size() + MAD_BUFFER_GUARD);
+    struct mad_stream stream;
+    struct mad_header header;
+    mad_stream_init(&stream);
+    mad_header_init(&header);
+    mad_stream_buffer(&stream, copy.data(), copy.size());
+    size_t frame = 0, result = 0;
+    while (true){
+        if (mad_header_decode(&header, &stream) == -1){
+            if (MAD_RECOVERABLE(stream.error)) continue;
+            break;
+        }
+        size_t start = stream.this_frame - copy.data();
+        size_t end = stream.next_frame - copy.data();
+        if (end > data.size()) break;
+        if ((block == 0 || (frame / block) % 2 == 1) && header.layer == MAD_LAYER_III){
+            // no CRC and empty side information: all granules are silent
+            data[start + 1] |= 1;
+            memset(data.data() + start + 4, 0, end - start - 4);
+            result++;
+        }
+        frame++;
+    }
+    mad_stream_finish(&stream);
+    return result;
+}
+
+double decode(std::vector<uint8_t> &data){
+    auto start = std::chrono::steady_clock::now();
+    for (int j=0; j<repeat; j++){
+        samples = 0;
+        zero_samples = 0;
+        MP3DecoderMAD mp3(count);
+        mp3.begin();
+        mp3.decodeFrames(data.data(), data.size());
+        mp3.end();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeat;
+}
+
+int main(int argc, char *argv[]) {
+    size_t block = argc > 1 ? atoi(argv[1]) : 200;
+    if (block == 0) block = 200;
+
+    std::vector<uint8_t> original(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3 + BabyElephantWalk60_mp3_len);
+    std::vector<uint8_t> pauses = original;
+    std::vector<uint8_t> silence = original;
+    size_t paused_frames = addPauses(pauses, block);
+    size_t silent_frames = addPauses(silence, 0);
+    // the guard makes sure that the last frame is decoded as well
+    original.resize(original.size() + MAD_BUFFER_GUARD);
+    pauses.resize(pauses.size() + MAD_BUFFER_GUARD);
+    silence.resize(silence.size() + MAD_BUFFER_GUARD);
+
+    double time = decode(original);
+    printf("original: %.4f s, samples: %zu, zero samples: %zu\n", time, samples, zero_samples);
+    time = decode(pauses);
+    printf("pauses  : %.4f s, samples: %zu, zero samples: %zu, silent frames: %zu\n", time, samples, zero_samples, paused_frames);
+    time = decode(silence);
+    printf("silence : %.4f s, samples: %zu, zero samples: %zu, silent frames: %zu\n", time, samples, zero_samples, silent_frames);
+    return zero_samples == samples ? 0 : 1;
+}
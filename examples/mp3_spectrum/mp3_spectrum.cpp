@@ -0,0 +1,155 @@
+/**
+ * @file mp3_spectrum.cpp
+ * @author Phil Schatzmann
+ * @brief Spectral analysis w/o synthesis: the spectrum callback receives the requantized lines
+ * of each Layer III granule, sums them up to the energy per scalefactor band and detects the
+ * onsets with the spectral flux. The callback returns 1, so the IMDCT and the synthesis are
+ * skipped. We compare the time with a complete decoding and verify that a callback which
+ * returns 0 does not change the decoded data.
+ * Usage: mp3_spectrum [mp3 file]
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MP3DecoderMAD.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+
+using namespace libmad;
+
+const int repeat = 5;
+const int max_bands = 22;
+
+/// Energy per scalefactor band of the last granule and the onset detection
+struct Analysis {
+    float energy[max_bands] = {0};
+    float flux_average = 0;
+    float last_flux = 0;
+    bool is_rising = false;
+    size_t granules = 0;
+    size_t onsets = 0;
+    double time = 0;        // position of the actual granule in seconds
+    double first_onsets[5];
+} analysis;
+
+uint32_t checksum = 0;
+
+void calculateChecksum(MadAudioInfo &info, int16_t *data, size_t len) {
+    for (size_t j=0; j<len; j++){
+        checksum = checksum * 31 + (uint16_t) data[j];
+    }
+}
+
+/// Sums up the energy of the first channel per scalefactor band and determines the spectral flux
+int analyze(void *ref, struct mad_frame const *frame, struct mad_spectrum const *spectrum){
+    Analysis *self = (Analysis*) ref;
+    const mad_fixed_t *xr = spectrum->xr[0];
+    const unsigned char *width = spectrum->sfbwidth[0];
+    // short blocks: the 3 windows of a band are listed separately
+    int windows = spectrum->block_type[0] == 2 && !spectrum->mixed_block[0] ? 3 : 1;
+    float flux = 0;
+    int line = 0;
+    for (int band=0; band<max_bands && line<576; band++){
+        float energy = 0;
+        for (int w=0; w<windows && line<576; w++){
+            int end = line + width[band * windows + w];
+            for (; line<end; line++){
+                float value = mad_f_todouble(xr[line]);
+                energy += value * value;
+            }
+        }
+        energy = log10f(energy + 1e-9f);
+        if (energy > self->energy[band]) flux += energy - self->energy[band];
+        self->energy[band] = energy;
+    }
+
+    // an onset is a peak of the flux which is clearly above the average
+    if (flux < self->last_flux && self->is_rising && self->last_flux > 2.0f * self->flux_average + 1.0f){
+        if (self->onsets < 5) self->first_onsets[self->onsets] = self->time;
+        self->onsets++;
+    }
+    self->is_rising = flux > self->last_flux;
+    self->last_flux = flux;
+    self->flux_average = 0.9f * self->flux_average + 0.1f * flux;
+
+    self->granules++;
+    self->time += 576.0 / frame->header.samplerate;
+    return 1;
+}
+
+/// Returns 0 to continue with the decoding
+int observe(void *ref, struct mad_frame const *frame, struct mad_spectrum const *spectrum){
+    (*(size_t*)ref)++;
+    return 0;
+}
+
+double seconds(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<uint8_t> file(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3 + BabyElephantWalk60_mp3_len);
+    if (argc > 1){
+        FILE *in = fopen(argv[1], "rb");
+        if (in == nullptr){
+            printf("could not open %s\n", argv[1]);
+            return 1;
+        }
+        file.resize(64 * 1024 * 1024);
+        file.resize(fread(file.data(), 1, file.size(), in));
+        fclose(in);
+    }
+    // the guard makes sure that the last frame is decoded as well
+    file.resize(file.size() + MAD_BUFFER_GUARD);
+
+    // complete decoding
+    auto start = std::chrono::steady_clock::now();
+    for (int j=0; j<repeat; j++){
+        checksum = 0;
+        MP3DecoderMAD mp3(calculateChecksum);
+        mp3.begin();
+        mp3.decodeFrames(file.data(), file.size());
+        mp3.end();
+    }
+    double decode_time = seconds(start) / repeat;
+    uint32_t decode_checksum = checksum;
+    printf("decoding: %.3f s, checksum: %08x\n", decode_time, decode_checksum);
+
+    // the spectrum callback must not change the result
+    size_t observed = 0;
+    checksum = 0;
+    MP3DecoderMAD mp3(calculateChecksum);
+    mp3.setSpectrumCallback(observe, &observed);
+    mp3.begin();
+    mp3.decodeFrames(file.data(), file.size());
+    mp3.end();
+    printf("decoding with spectrum callback: granules: %zu, checksum: %08x %s\n", observed, checksum,
+        checksum == decode_checksum ? "(identical)" : "(ERROR)");
+
+    // analysis only
+    start = std::chrono::steady_clock::now();
+    for (int j=0; j<repeat; j++){
+        analysis = Analysis();
+        checksum = 0;
+        MP3DecoderMAD mp3(calculateChecksum);
+        mp3.setSpectrumCallback(analyze, &analysis);
+        mp3.begin();
+        mp3.decodeFrames(file.data(), file.size());
+        mp3.end();
+    }
+    double analysis_time = seconds(start) / repeat;
+    printf("analysis: %.3f s (%.1fx faster), granules: %zu, onsets: %zu, pcm checksum: %08x\n", analysis_time,
+        decode_time / analysis_time, analysis.granules, analysis.onsets, checksum);
+    printf("first onsets:");
+    for (size_t j=0; j<analysis.onsets && j<5; j++){
+        printf(" %.2f s", analysis.first_onsets[j]);
+    }
+    printf("\n");
+    return checksum == 0 && observed == analysis.granules ? 0 : 1;
+}
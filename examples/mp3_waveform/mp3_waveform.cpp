@@ -0,0 +1,135 @@
+/**
+ * @file mp3_waveform.cpp
+ * @author Phil Schatzmann
+ * @brief Determines the waveform (peak and rms envelope) of the embedded mp3 file with the
+ * MadWaveform in all modes and compares the time and the result with the usual approach: a
+ * complete decoding to int16_t via the data callback where we calculate the envelope from
+ * the pcm data. We report the deviation of the rms and of the peak in dB for the points
+ * above -60 dB.
+ * Usage: mp3_waveform [samples per point] [mp3 file]
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "MadWaveform.h"
+#include "BabyElephantWalk60_mp3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+using namespace libmad;
+
+const int repeat = 5;
+size_t samples_per_point = 1152;
+std::vector<MadWaveformPoint> reference;
+MadWaveformPoint actual[2];
+double energy[2];
+size_t count = 0;
+int channels = 0;
+
+/// Calculates the envelope from the int16_t data of the decoder
+void addPCM(MadAudioInfo &info, int16_t *data, size_t len) {
+    // we use the channels of the first frame like the MadWaveform
+    if (channels == 0) channels = info.channels;
+    for (size_t j=0; j<len; j+=info.channels){
+        for (int ch=0; ch<channels; ch++){
+            float sample = data[j + (ch < info.channels ? ch : 0)] / 32768.0f;
+            actual[ch].min = std::min(actual[ch].min, sample);
+            actual[ch].max = std::max(actual[ch].max, sample);
+            energy[ch] += sample * sample;
+        }
+        if (++count == samples_per_point){
+            for (int ch=0; ch<channels; ch++){
+                actual[ch].rms = sqrt(energy[ch] / count);
+                reference.push_back(actual[ch]);
+                actual[ch] = MadWaveformPoint();
+                energy[ch] = 0;
+            }
+            count = 0;
+        }
+    }
+}
+
+double seconds(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double decibel(float value, float ref){
+    return 20.0 * log10(value / ref);
+}
+
+/// Prints the 1% and 99% percentile and the maximum of the deviation
+void printDeviation(const char *title, std::vector<double> &values){
+    if (values.empty()) return;
+    std::sort(values.begin(), values.end());
+    double sum = 0;
+    for (double value : values) sum += fabs(value);
+    printf("    %-5s mean |%.2f| dB, 1%%: %+.2f dB, 99%%: %+.2f dB, range: %+.2f / %+.2f dB\n", title,
+        sum / values.size(), values[values.size() / 100], values[values.size() * 99 / 100], values.front(), values.back());
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) samples_per_point = atoi(argv[1]);
+    if (samples_per_point < 32) samples_per_point = 1152;
+    samples_per_point = (samples_per_point + 31) / 32 * 32;
+    std::vector<uint8_t> file(BabyElephantWalk60_mp3, BabyElephantWalk60_mp3 + BabyElephantWalk60_mp3_len);
+    if (argc > 2){
+        FILE *in = fopen(argv[2], "rb");
+        if (in == nullptr){
+            printf("could not open %s\n", argv[2]);
+            return 1;
+        }
+        file.resize(64 * 1024 * 1024);
+        file.resize(fread(file.data(), 1, file.size(), in));
+        fclose(in);
+    }
+
+    // the guard makes sure that the last frame is decoded as well
+    size_t file_len = file.size();
+    file.resize(file_len + MAD_BUFFER_GUARD);
+
+    // usual approach: complete decoding to int16_t
+    auto start = std::chrono::steady_clock::now();
+    for (int j=0; j<repeat; j++){
+        reference.clear();
+        channels = 0;
+        MP3DecoderMAD mp3(addPCM, nullptr);
+        mp3.begin();
+        mp3.decodeFrames(file.data(), file.size());
+        mp3.end();
+    }
+    double ref_time = seconds(start) / repeat;
+    printf("int16_t decoding: %.3f s, points: %zu\n", ref_time, reference.size());
+
+    const char *names[] = {"subband", "half rate", "full"};
+    for (int mode=MadWaveformSubband; mode<=MadWaveformFull; mode++){
+        MadWaveform waveform;
+        start = std::chrono::steady_clock::now();
+        for (int j=0; j<repeat; j++){
+            waveform.begin(samples_per_point, (MadWaveformMode) mode);
+            waveform.process(file.data(), file_len);
+        }
+        double time = seconds(start) / repeat;
+        printf("%-9s: %.3f s (%.1fx faster), points: %zu\n", names[mode], time, ref_time / time, waveform.data().size());
+
+        // compare with the reference
+        std::vector<double> rms, peak;
+        size_t len = std::min(reference.size(), waveform.data().size());
+        for (size_t j=0; j<len; j++){
+            MadWaveformPoint &ref = reference[j];
+            MadWaveformPoint &act = waveform.data()[j];
+            float ref_peak = std::max(ref.max, -ref.min);
+            float act_peak = std::max(act.max, -act.min);
+            if (ref.rms > 0.001f && act.rms > 0.0f) rms.push_back(decibel(act.rms, ref.rms));
+            if (ref_peak > 0.001f && act_peak > 0.0f) peak.push_back(decibel(act_peak, ref_peak));
+        }
+        printDeviation("rms", rms);
+        printDeviation("peak", peak);
+    }
+    return 0;
+}
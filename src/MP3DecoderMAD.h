@@ -2,12 +2,26 @@
 
 #include "libmad/mad.h"
 #include "mad_log.h"
+#include "MadStats.h"
+#include "MadGain.h"
+#include "MadRateConverter.h"
+#include "MadLoudness.h"
 #include <stdint.h>
 #include <climits>
 #include <cassert>
+#include <string.h>
+#ifndef ARDUINO
+#include <algorithm>
+#endif
 
 namespace libmad {
 
+#ifndef ARDUINO
+// Support for desktop builds w/o Arduino emulator
+using std::min;
+inline void yield() {}
+#endif
+
 #ifndef MAD_MAX_RESULT_BUFFER_SIZE 
 #define MAD_MAX_RESULT_BUFFER_SIZE 1024
 #endif
@@ -16,6 +30,10 @@ namespace libmad {
 #define MAD_MAX_BUFFER_SIZE 1024
 #endif
 
+#ifndef MAD_MEMORY_ALIGN
+#define MAD_MEMORY_ALIGN 8
+#endif
+
 /**
  * @brief Basic Audio Information (number of channels, sample rate)
  * 
@@ -57,12 +75,96 @@ struct Range {
 // Callback methods
 typedef void (*MP3DataCallback)(MadAudioInfo &info,short *pwm_buffer, size_t len);
 typedef void (*MP3InfoCallback)(MadAudioInfo &info);
+/// Provides the encoded data for readPCM(): returns the number of bytes which were copied to data (0 = end of data)
+typedef size_t (*MP3InputCallback)(uint8_t *data, size_t len, void *ref);
+/// Receives each decoded frame (or granule) before the synthesis e.g. to change the subband samples
+typedef void (*MP3FrameFilter)(struct mad_frame *frame, void *ref);
 static MP3DataCallback pcmCallback = nullptr;
 static MP3InfoCallback infoCallback = nullptr;
 #ifdef ARDUINO
 static Print *mad_output_stream = nullptr;
 #endif
 
+/**
+ * @brief Abstract output which receives the decoded frames in the internal libmad format
+ * 
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadPCMOutput {
+    public:
+        virtual ~MadPCMOutput() = default;
+        /// Receives the synthesized PCM data of a frame
+        virtual void writeFrame(struct mad_header const *header, struct mad_pcm *pcm) = 0;
+};
+
+
+/**
+ * @brief Simple allocator which hands out caller supplied memory: individual blocks are
+ * not released, but all memory is made available again with reset().
+ * 
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadMemoryArena {
+    public:
+        /// Defines the memory which is managed
+        void begin(void *memory, size_t size){
+            start = (uint8_t*) memory;
+            capacity = size;
+            used = 0;
+            mad_memory_api.alloc_func = allocCallback;
+            mad_memory_api.free_func = nullptr;
+            mad_memory_api.data = this;
+        }
+
+        /// Provides an aligned block of memory: returns nullptr if the memory is used up
+        void *alloc(size_t size){
+            if (start == nullptr) return nullptr;
+            size_t pos = align((uintptr_t)(start + used)) - (uintptr_t)start;
+            if (pos + size > capacity) {
+                LOG(Error, "arena: %zu bytes not available", size);
+                return nullptr;
+            }
+            used = pos + size;
+            return start + pos;
+        }
+
+        /// Makes all memory available again
+        void reset(){
+            used = 0;
+        }
+
+        /// Returns true if memory has been defined
+        bool isActive(){
+            return start != nullptr;
+        }
+
+        /// Number of bytes which are in use
+        size_t size(){
+            return used;
+        }
+
+        /// Allocator for libmad
+        struct mad_memory *madMemory(){
+            return &mad_memory_api;
+        }
+
+        /// Rounds up the size to the alignment
+        static size_t align(size_t size){
+            return (size + MAD_MEMORY_ALIGN - 1) & ~((size_t)MAD_MEMORY_ALIGN - 1);
+        }
+
+    protected:
+        uint8_t *start = nullptr;
+        size_t capacity = 0;
+        size_t used = 0;
+        struct mad_memory mad_memory_api;
+
+        static void *allocCallback(void *data, unsigned long size){
+            return ((MadMemoryArena*)data)->alloc(size);
+        }
+};
 
 /**
  * @brief Individual chunk of encoded MP3 data which is submitted to the decoder
@@ -105,14 +207,7 @@ class MP3DecoderMAD  {
 
         ~MP3DecoderMAD(){
             end();
-            if (buffer.data!=nullptr){
-                delete [] buffer.data;
-                buffer.data = nullptr;
-            }
-            if (p_result_buffer!=nullptr){
-                delete [] p_result_buffer;
-            } 
-
+            releaseBuffers();
         }
 
         MP3DecoderMAD(MP3DataCallback dataCallback, MP3InfoCallback infoCB=nullptr){
@@ -138,6 +233,32 @@ class MP3DecoderMAD  {
             max_result_buffer_size = size;
         }
 
+        /**
+         * @brief Defines the memory which is used for all buffers of the decoder and libmad, so
+         * that no heap is used after begin(). The memory must be valid as long as the decoder is used.
+         * If it is smaller than requiredMemory() begin() fails and the decoder stays inactive.
+         * 
+         * @param memory 
+         * @param size see requiredMemory()
+         */
+        void setMemory(void *memory, size_t size){
+            end();
+            releaseBuffers();
+            arena.begin(memory, size);
+        }
+
+        /// Provides the memory size which is needed by setMemory() for the actual buffer sizes and output format
+        size_t requiredMemory(){
+            size_t result = MAD_MEMORY_ALIGN + MadMemoryArena::align(max_buffer_size) 
+                + MadMemoryArena::align(max_result_buffer_size * sizeof(int16_t))
+                + MadMemoryArena::align(MAD_BUFFER_MDLEN) 
+                + MadMemoryArena::align(sizeof(*frame.overlap))
+                + MadMemoryArena::align(mad_granules_size);
+            if (isOutputFormat()) result += rate_converter.requiredMemory(MAD_MEMORY_ALIGN);
+            if (p_loudness_meter != nullptr) result += MadLoudnessMeter::requiredMemory(MAD_MEMORY_ALIGN);
+            return result;
+        }
+
 #ifdef ARDUINO
         MP3DecoderMAD(Print &mad_output_streamput, MP3InfoCallback infoCB = nullptr){
             setOutput(mad_output_streamput);
@@ -149,34 +270,224 @@ class MP3DecoderMAD  {
         }
 #endif
 
+        /// Defines an output which receives the decoded frames (not supported with MAD_SYNTH_NO_PCM)
+        void setOutput(MadPCMOutput &out){
+#ifdef MAD_SYNTH_NO_PCM
+            LOG(Error, "setOutput: not supported with MAD_SYNTH_NO_PCM");
+#endif
+            p_pcm_output = &out;
+        }
+
+        /**
+         * @brief Activates the slot streaming synthesis: each slot of 32 samples is converted to 
+         * int16_t as soon as it has been synthesized, so that the full mad_pcm frame buffer is not used.
+         * Compile with MAD_SYNTH_NO_PCM to remove this buffer (9 KB) from the decoder: this mode is then 
+         * always active.
+         */
+        void setSlotSynthesis(bool active){
+            is_slot_synthesis = active;
+        }
+
+        /**
+         * @brief Activates the granule decoding: Layer III frames are decoded and synthesized in 
+         * steps of 576 samples, so that the first result of a frame is available after half of the 
+         * work. MPEG-2 LSF frames have only one granule. If the second granule of a damaged frame can not
+         * be decoded it is muted, so that each frame keeps its length (the frame decoding drops the whole
+         * frame instead). Call before begin().
+         */
+        void setGranuleDecoding(bool active){
+            is_granules = active;
+        }
+
         /// Defines the callback which receives the decoded data
         void setDataCallback(MP3DataCallback cb){
             pcmCallback = cb;
         }
 
+        /**
+         * @brief Defines a callback which receives the requantized spectral lines of each Layer III
+         * granule before the hybrid filterbank (see mad_spectrum in frame.h). If the callback returns
+         * a nonzero value, the IMDCT, the synthesis and the output of the frame are skipped: so an
+         * analysis only pays for the Huffman decoding and the requantization. Call before begin().
+         */
+        void setSpectrumCallback(mad_spectrum_func cb, void *ref=nullptr){
+            spectrum_callback = cb;
+            spectrum_ref = ref;
+        }
+
+        /**
+         * @brief Limits the decoded bandwidth e.g. to 8000 Hz for speech recognition: the Huffman
+         * decoding stops at the cutoff and the requantization, the IMDCT and the synthesis of the
+         * subbands above it are skipped. If the bandwidth is at most a quarter of the sample rate,
+         * we synthesize at half the sample rate (see MadAudioInfo). 0 decodes the full bandwidth.
+         * Call before begin().
+         */
+        void setMaxBandwidth(int hz){
+            max_bandwidth = hz;
+        }
+
+        /**
+         * @brief Defines the linear gain (up to MAD_GAIN_MAX) which is applied in the conversion of the
+         * decoded samples (before the clipping), so no separate pass over the result is needed. The change
+         * is ramped over the indicated number of samples per channel. A MadPCMOutput receives the samples
+         * with the gain applied.
+         */
+        void setGain(float gain, size_t rampSamples=0){
+            user_gain = gain;
+            updateGain(rampSamples);
+        }
+
+        /// Defines the gain in dB (see setGain())
+        void setGainDb(float db, size_t rampSamples=0){
+            setGain(powf(10.0f, db / 20.0f), rampSamples);
+        }
+
+        /// Provides the effective linear gain (incl. the ReplayGain)
+        float gain(){
+            return sample_gain.value();
+        }
+
+        /**
+         * @brief Activates the ReplayGain: the track gain is taken from the LAME tag of the first frame
+         * or from setReplayGainDb() e.g. with the value from MadReplayGain::readID3(). The preamp is
+         * added to the ReplayGain and the result is combined with the gain of setGain().
+         */
+        void setReplayGain(bool active, float preampDb=0.0f){
+            is_replay_gain = active;
+            replay_gain_preamp = preampDb;
+            updateGain(0);
+        }
+
+        /// Defines the ReplayGain of the track in dB (e.g. from an ID3v2 tag)
+        void setReplayGainDb(float db){
+            replay_gain_db = db;
+            is_replay_gain_defined = true;
+            updateGain(0);
+        }
+
+        /// Provides the ReplayGain of the track in dB: 0 if it is not known
+        float replayGainDb(){
+            return is_replay_gain_defined ? replay_gain_db : 0.0f;
+        }
+
+        /**
+         * @brief Defines the sample rate and the number of channels (1 or 2) of the result: the decoded
+         * samples are converted before the conversion to int16_t or float, so that the info callback only
+         * reports this format. 0 keeps the sample rate or the channels of the mp3 data. A MadPCMOutput
+         * receives the frames in the original format. The filter of the MadRateConverter is allocated on
+         * the heap when the sample rate of the mp3 data changes: with setMemory() the filter for all mp3
+         * sample rates is allocated in begin() (see requiredMemory()), so call this method before.
+         */
+        void setOutputFormat(int sampleRate, int channels=0){
+            output_sample_rate = sampleRate;
+            output_channels = channels > 2 ? 2 : channels;
+            rate_converter.setOutput(output_sample_rate, output_channels);
+            input_info = MadAudioInfo();
+        }
+
+        /**
+         * @brief Measures the loudness (EBU R128) and the peaks of the synthesized samples while they are
+         * produced, so that no second pass over the decoded data is needed: the meter receives the samples
+         * before the gain, the rate conversion and the conversion to int16_t or float. The result is
+         * available with meter.loudness(). With setMemory() the true peak filter of the meter is allocated
+         * in begin() from this memory as long as the meter is used by the decoder.
+         */
+        void setLoudnessMeter(MadLoudnessMeter &meter){
+            if (p_loudness_meter != &meter) releaseLoudnessMeter();
+            p_loudness_meter = &meter;
+        }
+
+        /**
+         * @brief Defines a filter which can change the subband samples of each decoded frame (or granule)
+         * before the synthesis, like the filter_func of the libmad high-level API: e.g. the MadEqualizer
+         * with setFrameFilter(MadEqualizer::filter, &equalizer).
+         */
+        void setFrameFilter(MP3FrameFilter filter, void *ref=nullptr){
+            frame_filter = filter;
+            frame_filter_ref = ref;
+        }
+
         /// Defines the callback which receives the Info changes
         void setInfoCallback(MP3InfoCallback cb){
             infoCallback = cb;
         }
 
-        // mad low lever interface - start
-        void begin() {
-            if (buffer.data==nullptr){
-                buffer.data = new uint8_t[max_buffer_size];
-            } 
-            if (p_result_buffer==nullptr){
-                p_result_buffer = new int16_t[max_result_buffer_size];
-            }
+        /**
+         * @brief Defines the source of the encoded data for readPCM(): the data is requested
+         * on demand and the buffer (see setBufferSize()) must be able to hold the biggest frame.
+         */
+        void setInputSource(MP3InputCallback cb, void *ref=nullptr){
+            input_callback = cb;
+            input_ref = ref;
+        }
+
+#ifdef ARDUINO
+        /// Reads the encoded data for readPCM() from the indicated stream
+        void setInput(Stream &in){
+            setInputSource(readStream, &in);
+        }
+#endif
+
+        /// mad low lever interface - start: returns false if the memory defined with setMemory() is too small
+        bool begin() {
             if (active){
                 end();
             }
+            if (arena.isActive()){
+                arena.reset();
+                buffer.data = (uint8_t*) arena.alloc(max_buffer_size);
+                p_result_buffer = (int16_t*) arena.alloc(max_result_buffer_size * sizeof(int16_t));
+            } else {
+                if (buffer.data==nullptr){
+                    buffer.data = new uint8_t[max_buffer_size];
+                } 
+                if (p_result_buffer==nullptr){
+                    p_result_buffer = new int16_t[max_result_buffer_size];
+                }
+            }
             mad_stream_init(&stream);
             mad_frame_init(&frame);
             mad_synth_init(&synth);
+            mad_stream_options(&stream, is_granules ? MAD_OPTION_GRANULES : 0);
+            mad_frame_spectrum(&frame, spectrum_callback != nullptr ? spectrumTap : nullptr, this);
+            mad_frame_bandwidth(&frame, max_bandwidth > 0 ? max_bandwidth : 0);
+            is_spectrum_stop = false;
+            is_first_frame = true;
+            // the rate converter starts with the first frame
+            input_info = MadAudioInfo();
+
+            if (arena.isActive()){
+                // allocate the Layer III buffers now to avoid any allocation during decoding
+                mad_stream_memory(&stream, arena.madMemory());
+                mad_frame_memory(&frame, arena.madMemory());
+                stream.main_data = (unsigned char (*)[MAD_BUFFER_MDLEN]) mad_memory_alloc(stream.memory, MAD_BUFFER_MDLEN);
+                frame.overlap = (mad_fixed_t (*)[2][32][18]) mad_memory_alloc(frame.memory, sizeof(*frame.overlap));
+                if (is_granules){
+                    frame.granules = (struct mad_granules *) mad_memory_alloc(frame.memory, mad_granules_size);
+                }
+                // the filters for all mp3 sample rates
+                rate_converter.setMemory(arena.madMemory());
+                bool ok = buffer.data!=nullptr && p_result_buffer!=nullptr;
+                ok = ok && stream.main_data!=nullptr && frame.overlap!=nullptr;
+                ok = ok && (!is_granules || frame.granules!=nullptr);
+                ok = ok && (!isOutputFormat() || rate_converter.allocate());
+                ok = ok && (p_loudness_meter == nullptr || p_loudness_meter->setMemory(arena.madMemory()));
+                if (!ok){
+                    LOG(Error, "setMemory: %zu bytes required", requiredMemory());
+                    mad_synth_finish(&synth);
+                    mad_frame_finish(&frame);
+                    mad_stream_finish(&stream);
+                    return false;
+                }
+            }
 
             active = true;
             buffer.size = 0;
             frame_counter = 0;
+            pcm_pos = 0;
+            pcm_len = 0;
+            is_input_end = false;
+            return true;
         }
 
         // mad low lever interface - end
@@ -194,8 +505,9 @@ class MP3DecoderMAD  {
             return mad_info;
         }
 
-        /// Makes the mp3 data available for decoding: however we recommend to provide the data via a callback or input stream
+        /// Makes the mp3 data available for decoding: alternatively you can pull the decoded data with readPCM()
         size_t write(const void *in_ptr, size_t in_size) {
+            MadStatsScope scope(mad_stats_data);
             size_t result = 0;
             if (active){
                 LOG(Debug, "write %zu", in_size);
@@ -218,11 +530,81 @@ class MP3DecoderMAD  {
             return result;
         }
 
+        /// Decodes all complete frames of a contiguous buffer w/o copying the data. Returns the number of
+        /// consumed bytes: the remaining data must be provided again (with additional data) in the next call.
+        size_t decodeFrames(const void *data, size_t len){
+            if (!active || len==0) return 0;
+            MadStatsScope scope(mad_stats_data);
+            const uint8_t *start = (const uint8_t*) data;
+            mad_stream_buffer(&stream, start, len);
+            while(true){
+                if (mad_frame_decode(&frame, &stream)==-1){
+                    if (MAD_RECOVERABLE(stream.error)) {
+                        LOG(Warning,"-> decoding error");
+                        continue;
+                    }
+                    // MAD_ERROR_BUFLEN: we need more data
+                    break;
+                }
+                synthesize();
+                frame_counter++;
+            }
+            return stream.next_frame - start;
+        }
+
+        /**
+         * @brief Pull API: provides exactly the requested number of frames (samples per channel) of 
+         * interleaved int16_t samples. The encoded data is requested from the input source (see
+         * setInputSource()) and only as many frames are decoded as needed: the remaining samples 
+         * are kept for the next call. Returns less only at the end of the data or if the audio 
+         * format changes (see audioInfo()). Not supported with MAD_SYNTH_NO_PCM.
+         */
+        size_t readPCM(int16_t *data, size_t frames){
+            return readSamples(data, frames);
+        }
+
+        /// Pull API: provides the requested number of frames as interleaved float samples in the range of -1.0 to 1.0
+        size_t readPCM(float *data, size_t frames){
+            return readSamples(data, frames);
+        }
+
+        /// Pull API: provides the requested number of frames as interleaved samples in the internal libmad format
+        size_t readPCM(mad_fixed_t *data, size_t frames){
+            return readSamples(data, frames);
+        }
+
+        /// Provides the profiling information: the counters are only updated if compiled with MAD_STATS
+        MadStats &stats(){
+            return mad_stats_data;
+        }
+
         /// Returns true as long as we are processing data
         operator bool(){
             return active;
         }
 
+        /// Scales the sample from internal MAD format to float
+        static float scaleFloat(mad_fixed_t sample) {
+            if(sample>=MAD_F_ONE)
+                return 1.0f;
+            if(sample<=-MAD_F_ONE)
+                return -1.0f;
+            return (float) sample / MAD_F_ONE;
+        }
+
+        /// Scales the sample from internal MAD format to int16
+        static int16_t scale(mad_fixed_t sample) {
+            /* round */
+            if(sample>=MAD_F_ONE)
+                return(SHRT_MAX);
+            if(sample<=-MAD_F_ONE)
+                return(-SHRT_MAX);
+
+            /* Conversion. */
+            sample=sample>>(MAD_F_FRACBITS-15);
+            return((signed short)sample);
+        }
+
     protected:
         size_t max_buffer_size = MAD_MAX_BUFFER_SIZE;
         size_t max_result_buffer_size = MAD_MAX_RESULT_BUFFER_SIZE;
@@ -235,6 +617,258 @@ class MP3DecoderMAD  {
         MadInputBuffer buffer;
         MadAudioInfo mad_info;
         int16_t *p_result_buffer = nullptr;
+        MadPCMOutput *p_pcm_output = nullptr;
+        MadMemoryArena arena;
+#ifdef MAD_SYNTH_NO_PCM
+        bool is_slot_synthesis = true;
+#else
+        bool is_slot_synthesis = false;
+#endif
+        bool is_granules = false;
+        MadStats mad_stats_data;
+        size_t result_pos = 0;
+        MP3InputCallback input_callback = nullptr;
+        void *input_ref = nullptr;
+        bool is_input_end = false;
+        size_t pcm_pos = 0;     // next frame in synth.pcm for readPCM()
+        size_t pcm_len = 0;     // available frames in synth.pcm for readPCM()
+        mad_spectrum_func spectrum_callback = nullptr;
+        void *spectrum_ref = nullptr;
+        bool is_spectrum_stop = false;  // the spectrum callback skipped the hybrid filterbank
+        int max_bandwidth = 0;          // decoded bandwidth in Hz (0 = all)
+        MP3FrameFilter frame_filter = nullptr;
+        void *frame_filter_ref = nullptr;
+        MadGain sample_gain;            // applied in the conversion of the samples
+        float user_gain = 1.0f;
+        bool is_replay_gain = false;
+        bool is_replay_gain_defined = false;
+        float replay_gain_db = 0.0f;
+        float replay_gain_preamp = 0.0f;
+        bool is_first_frame = true;
+        MadRateConverter rate_converter;
+        MadAudioInfo input_info;        // format of the decoded frames
+        int output_sample_rate = 0;     // sample rate of the result (0 = as decoded)
+        int output_channels = 0;        // channels of the result (0 = as decoded)
+        MadLoudnessMeter *p_loudness_meter = nullptr;
+
+        /// Combines the gain with the ReplayGain
+        void updateGain(size_t rampSamples){
+            float result = user_gain;
+            if (is_replay_gain && is_replay_gain_defined){
+                result *= powf(10.0f, (replay_gain_db + replay_gain_preamp) / 20.0f);
+            }
+            sample_gain.set(result, rampSamples);
+        }
+
+        /// Reads the ReplayGain from the LAME tag if the actual frame is the first one
+        void readReplayGain(){
+            if (!is_first_frame) return;
+            is_first_frame = false;
+            float db;
+            if (is_replay_gain && !is_replay_gain_defined && MadReplayGain::readLAME(stream.this_frame, stream.next_frame - stream.this_frame, db)){
+                setReplayGainDb(db);
+            }
+        }
+
+        /// Calls the spectrum callback: called by libmad for each granule
+        static int spectrumTap(void *data, struct mad_frame const *frame, struct mad_spectrum const *spectrum){
+            MP3DecoderMAD *self = (MP3DecoderMAD*) data;
+            int result = self->spectrum_callback(self->spectrum_ref, frame, spectrum);
+            if (result != 0) self->is_spectrum_stop = true;
+            return result;
+        }
+
+        /// Selects the synthesis at half the sample rate if the decoded bandwidth allows it
+        void selectSampleRate(){
+            if (frame.bandwidth > 0 && mad_frame_sblimit(&frame) <= 16){
+                frame.options |= MAD_OPTION_HALFSAMPLERATE;
+            }
+        }
+
+        /// Returns true if the synthesis of the actual frame (or granule) must be skipped
+        bool isSpectrumStop(){
+            if (!is_spectrum_stop) return false;
+            is_spectrum_stop = false;
+            return true;
+        }
+
+        static void convert(mad_fixed_t sample, int16_t &result){
+            result = scale(sample);
+        }
+
+        static void convert(mad_fixed_t sample, float &result){
+            result = scaleFloat(sample);
+        }
+
+        static void convert(mad_fixed_t sample, mad_fixed_t &result){
+            result = sample;
+        }
+
+        /// Implementation of readPCM()
+        template <typename T>
+        size_t readSamples(T *data, size_t frames){
+#ifdef MAD_SYNTH_NO_PCM
+            (void) data;
+            (void) frames;
+            LOG(Error, "readPCM: not supported with MAD_SYNTH_NO_PCM");
+            return 0;
+#else
+            if (!active) return 0;
+            MadStatsScope scope(mad_stats_data);
+            size_t result = 0;
+            while (result < frames){
+                // the rate converter might still provide output from the last frame
+                bool is_converted = rate_converter.isActive() && !rate_converter.isInputNeeded();
+                if (pcm_pos >= pcm_len && !is_converted && !decodePCM()){
+                    break;
+                }
+                if (pcm_pos == 0){
+                    // we do not mix different formats in one result
+                    MadAudioInfo act_info(synth.pcm);
+                    if (act_info != input_info){
+                        if (result > 0 && outputInfo(act_info) != mad_info) break;
+                        updateInfo(act_info);
+                    }
+                }
+                if (rate_converter.isActive()){
+                    result += convertSamples(data, frames - result);
+                    continue;
+                }
+                size_t len = min(frames - result, pcm_len - pcm_pos);
+                int channels = synth.pcm.channels;
+                bool is_gain = !sample_gain.isUnity();
+                MAD_STATS_ENTER(MAD_STAGE_PCM);
+                for (size_t j=pcm_pos; j<pcm_pos+len; j++){
+                    mad_fixed_t gain = is_gain ? sample_gain.next() : MAD_F_ONE;
+                    for (int ch=0; ch<channels; ch++){
+                        mad_fixed_t sample = synth.pcm.samples[ch][j];
+                        convert(is_gain ? MadGain::mul(sample, gain) : sample, *data++);
+                    }
+                }
+                MAD_STATS_LEAVE();
+                pcm_pos += len;
+                result += len;
+            }
+            return result;
+#endif
+        }
+
+#ifndef MAD_SYNTH_NO_PCM
+        /// Converts the decoded samples with the rate converter for readPCM(): returns the number of frames
+        template <typename T>
+        size_t convertSamples(T *&data, size_t frames){
+            int channels = synth.pcm.channels;
+            bool is_gain = !sample_gain.isUnity();
+            mad_fixed_t out[2];
+            size_t result = 0;
+            MAD_STATS_ENTER(MAD_STAGE_PCM);
+            while (result < frames){
+                if (rate_converter.isInputNeeded()){
+                    if (pcm_pos >= pcm_len) break;
+                    convertFrame(synth.pcm.samples[0][pcm_pos], synth.pcm.samples[channels - 1][pcm_pos], is_gain);
+                    pcm_pos++;
+                    continue;
+                }
+                rate_converter.read(out);
+                for (int ch=0; ch<rate_converter.channels(); ch++){
+                    convert(out[ch], *data++);
+                }
+                result++;
+            }
+            MAD_STATS_LEAVE();
+            return result;
+        }
+
+        /// Decodes and synthesizes the next frame (or granule) for readPCM(): returns false at the end of the data
+        bool decodePCM(){
+            pcm_pos = 0;
+            pcm_len = 0;
+            // remaining granules of the actual frame: a damaged granule is muted
+            if (is_granules && mad_frame_decode_granule(&frame, &stream)==1){
+                if (stream.error != MAD_ERROR_NONE){
+                    LOG(Warning, "-> granule muted");
+                }
+                synthesizePCM();
+                return true;
+            }
+            while(true){
+                if (stream.buffer!=nullptr && mad_frame_decode(&frame, &stream)==0){
+                    frame_counter++;
+                    synthesizePCM();
+                    return true;
+                }
+                if (stream.buffer!=nullptr && MAD_RECOVERABLE(stream.error)){
+                    LOG(Warning,"-> decoding error");
+                    continue;
+                }
+                // MAD_ERROR_BUFLEN: we need more data
+                if (!fillBuffer()) return false;
+            }
+        }
+
+        void synthesizePCM(){
+            readReplayGain();
+#ifdef MAD_STATS
+            mad_stats_data.frames++;
+            mad_stats_data.samples += 32 * MAD_FRAME_NSBSAMPLES(&frame);
+#endif
+            if (isSpectrumStop()) return;
+            selectSampleRate();
+            if (frame_filter != nullptr) frame_filter(&frame, frame_filter_ref);
+            mad_synth_frame(&synth, &frame);
+            if (p_loudness_meter != nullptr) p_loudness_meter->write(&synth.pcm);
+            pcm_len = synth.pcm.length;
+        }
+#endif
+
+        /// Requests the next encoded data from the input source: the data which was not decoded yet is kept
+        bool fillBuffer(){
+            if (input_callback==nullptr || is_input_end) return false;
+            size_t keep = 0;
+            if (stream.buffer == buffer.data && stream.next_frame != nullptr){
+                keep = stream.bufend - stream.next_frame;
+                if (keep >= max_buffer_size){
+                    LOG(Error, "readPCM: frame is bigger than the buffer");
+                    keep = 0;
+                }
+                memmove(buffer.data, stream.next_frame, keep);
+            }
+            size_t len = input_callback(buffer.data + keep, max_buffer_size - keep, input_ref);
+            if (len == 0){
+                // end of data: the guard makes sure that the last frame is decoded as well
+                is_input_end = true;
+                len = min((size_t)MAD_BUFFER_GUARD, max_buffer_size - keep);
+                memset(buffer.data + keep, 0, len);
+            }
+            buffer.size = keep + len;
+            mad_stream_buffer(&stream, buffer.data, buffer.size);
+            return true;
+        }
+
+#ifdef ARDUINO
+        static size_t readStream(uint8_t *data, size_t len, void *ref){
+            return ((Stream*)ref)->readBytes((char*)data, len);
+        }
+#endif
+
+        /// Releases the buffers which were allocated on the heap
+        void releaseBuffers(){
+            if (arena.isActive()){
+                // the filters must not use the memory any more
+                rate_converter.setMemory(nullptr);
+                releaseLoudnessMeter();
+            }
+            if (!arena.isActive()){
+                if (buffer.data!=nullptr){
+                    delete [] buffer.data;
+                }
+                if (p_result_buffer!=nullptr){
+                    delete [] p_result_buffer;
+                } 
+            }
+            buffer.data = nullptr;
+            p_result_buffer = nullptr;
+        }
 
         /**
          * @brief Finds the MP3 synchronization word which demarks the start of a new segment
@@ -259,10 +893,7 @@ class MP3DecoderMAD  {
 
             int rc = mad_frame_decode(&frame, &stream);
             if (rc==0){
-                mad_synth_frame(&synth, &frame);
-                if (synth.pcm.length>0){
-                    output(this, &frame.header, &synth.pcm);
-                }
+                synthesize();
 
                 int decoded = (stream.next_frame - buffer.data);
                 assert(decoded>0);
@@ -363,6 +994,142 @@ class MP3DecoderMAD  {
         }
 
         /// output decoded data
+        /// Synthesizes the decoded frame: in granule mode we decode and synthesize the remaining granules
+        void synthesize() {
+            readReplayGain();
+            synthesizeSubbands();
+            // a damaged granule is muted, so that the frame keeps its length
+            while (mad_frame_decode_granule(&frame, &stream)==1){
+                if (stream.error != MAD_ERROR_NONE){
+                    LOG(Warning, "-> granule muted");
+                }
+                synthesizeSubbands();
+            }
+        }
+
+        /// Synthesizes the subband samples of the frame (or granule) and provides the result
+        void synthesizeSubbands() {
+#ifdef MAD_STATS
+            mad_stats_data.frames++;
+            mad_stats_data.samples += 32 * MAD_FRAME_NSBSAMPLES(&frame);
+#endif
+            if (isSpectrumStop()) return;
+            selectSampleRate();
+            if (frame_filter != nullptr) frame_filter(&frame, frame_filter_ref);
+#ifndef MAD_SYNTH_NO_PCM
+            if (!is_slot_synthesis || p_pcm_output!=nullptr){
+                mad_synth_frame(&synth, &frame);
+                if (p_loudness_meter != nullptr) p_loudness_meter->write(&synth.pcm);
+                if (synth.pcm.length>0){
+                    output(this, &frame.header, &synth.pcm);
+                }
+                return;
+            }
+#endif
+            MadAudioInfo act_info;
+            act_info.sample_rate = frame.header.samplerate;
+            if (frame.options & MAD_OPTION_HALFSAMPLERATE) act_info.sample_rate /= 2;
+            act_info.channels = MAD_NCHANNELS(&frame.header);
+            updateInfo(act_info);
+
+            result_pos = 0;
+            mad_synth_frame_slots(&synth, &frame, outputSlot, this);
+            if (result_pos>0){
+                outputBuffer(mad_info, p_result_buffer, result_pos);
+            }
+        }
+
+        /// Converts a synthesized slot to int16_t: called by mad_synth_frame_slots()
+        static void outputSlot(void *data, unsigned int nchannels, unsigned int nsamples, mad_fixed_t const samples[2][32]) {
+            MP3DecoderMAD *self = (MP3DecoderMAD*) data;
+            if (self->p_loudness_meter != nullptr){
+                self->p_loudness_meter->write(samples[0], samples[nchannels - 1], nsamples, self->input_info.sample_rate, nchannels);
+            }
+            if (!self->hasResultReceiver()){
+                return;
+            }
+            bool is_gain = !self->sample_gain.isUnity();
+            MAD_STATS_ENTER(MAD_STAGE_PCM);
+            if (self->rate_converter.isActive()){
+                for (unsigned int j=0;j<nsamples;j++){
+                    self->convertFrame(samples[0][j], samples[nchannels - 1][j], is_gain);
+                    self->outputConverted();
+                }
+                MAD_STATS_LEAVE();
+                return;
+            }
+            for (unsigned int j=0;j<nsamples;j++){
+                mad_fixed_t gain = is_gain ? self->sample_gain.next() : MAD_F_ONE;
+                for (unsigned int ch=0;ch<nchannels;ch++){
+                    mad_fixed_t sample = is_gain ? MadGain::mul(samples[ch][j], gain) : samples[ch][j];
+                    self->p_result_buffer[self->result_pos++] = scale(sample);
+                    if (self->result_pos>=self->max_result_buffer_size){
+                        self->outputBuffer(self->mad_info, self->p_result_buffer, self->result_pos);
+                        self->result_pos = 0;
+                    }
+                }
+            }
+            MAD_STATS_LEAVE();
+        }
+
+        /// Provides the next decoded frame to the rate converter: the gain is applied before the conversion
+        void convertFrame(mad_fixed_t left, mad_fixed_t right, bool is_gain){
+            if (is_gain){
+                mad_fixed_t gain = sample_gain.next();
+                left = MadGain::mul(left, gain);
+                right = MadGain::mul(right, gain);
+            }
+            rate_converter.write(left, right);
+        }
+
+        /// Converts the available output frames of the rate converter to int16_t
+        void outputConverted(){
+            mad_fixed_t out[2];
+            int channels = rate_converter.channels();
+            while (!rate_converter.isInputNeeded()){
+                rate_converter.read(out);
+                for (int ch=0; ch<channels; ch++){
+                    p_result_buffer[result_pos++] = scale(out[ch]);
+                }
+                if (result_pos + channels > max_result_buffer_size){
+                    outputBuffer(mad_info, p_result_buffer, result_pos);
+                    result_pos = 0;
+                }
+            }
+        }
+
+        /// Returns true if a sample rate or the channels of the result are defined
+        bool isOutputFormat(){
+            return output_sample_rate > 0 || output_channels > 0;
+        }
+
+        /// The meter uses the heap again if it was using our memory
+        void releaseLoudnessMeter(){
+            if (p_loudness_meter != nullptr && arena.isActive()) p_loudness_meter->setMemory(nullptr);
+        }
+
+        /// Provides the format of the result for the indicated decoded format
+        MadAudioInfo outputInfo(MadAudioInfo info){
+            if (output_sample_rate > 0) info.sample_rate = output_sample_rate;
+            if (output_channels > 0) info.channels = output_channels;
+            return info;
+        }
+
+        /// Notifies the info callback about changes: with a rate converter we report the converted format
+        void updateInfo(MadAudioInfo &act_info){
+            if (act_info != input_info){
+                input_info = act_info;
+                rate_converter.begin(act_info.sample_rate, act_info.channels);
+            }
+            MadAudioInfo info = rate_converter.isActive() ? outputInfo(act_info) : act_info;
+            if (info != mad_info){
+                if (infoCallback!=nullptr){
+                    infoCallback(info);
+                }
+                mad_info = info;
+            }
+        }
+
         void output(void *data, struct mad_header const *header, struct mad_pcm *pcm) {
             LOG(Debug, "output");
             unsigned int nchannels, nsamples;
@@ -370,16 +1137,40 @@ class MP3DecoderMAD  {
             MadAudioInfo act_info(*pcm);
             
             /// notify abmad_output_stream changes
-            if (act_info != mad_info){
-                if (infoCallback!=nullptr){
-                    infoCallback(act_info);
+            updateInfo(act_info);
+
+            bool is_gain = !sample_gain.isUnity();
+            if (p_pcm_output!=nullptr){
+                MAD_STATS_ENTER(MAD_STAGE_OUTPUT);
+                if (is_gain){
+                    // the output and the conversion below receive the samples with the gain
+                    sample_gain.apply(pcm);
+                    is_gain = false;
                 }
-                mad_info = act_info;
+                p_pcm_output->writeFrame(header, pcm);
+                MAD_STATS_LEAVE();
+            }
+            if (!hasResultReceiver()){
+                return;
             }
+            MAD_STATS_ENTER(MAD_STAGE_PCM);
 
             // convert to int16_t
             nchannels = pcm->channels;
             nsamples  = pcm->length;
+
+            if (rate_converter.isActive()){
+                result_pos = 0;
+                for (unsigned int j=0;j<nsamples;j++){
+                    convertFrame(pcm->samples[0][j], pcm->samples[nchannels - 1][j], is_gain);
+                    outputConverted();
+                }
+                if (result_pos>0){
+                    outputBuffer(mad_info, p_result_buffer, result_pos);
+                }
+                MAD_STATS_LEAVE();
+                return;
+            }
             
             // Output the reuslut in batches of max_result_buffer_size samples
             int total_open = nsamples*nchannels;
@@ -387,9 +1178,11 @@ class MP3DecoderMAD  {
             do {
                 i = 0;
                 for (int j=0;j<nsamples;j++){
+                    mad_fixed_t gain = is_gain ? sample_gain.next() : MAD_F_ONE;
                     for (int ch = 0;ch<nchannels;ch++){
                         // scale sample
-                        p_result_buffer[i++] = scale(pcm->samples[ch][j]);
+                        mad_fixed_t sample = pcm->samples[ch][j];
+                        p_result_buffer[i++] = scale(is_gain ? MadGain::mul(sample, gain) : sample);
                         total_open--;
                         if (i>=max_result_buffer_size){
                             // output full buffer
@@ -404,9 +1197,19 @@ class MP3DecoderMAD  {
             if (i>0){
                 outputBuffer(act_info, p_result_buffer,i);
             }
+            MAD_STATS_LEAVE();
         }
+        /// Returns true if someone is interested in the int16_t result
+        bool hasResultReceiver(){
+#ifdef ARDUINO
+            if (mad_output_stream!=nullptr) return true;
+#endif
+            return pcmCallback!=nullptr;
+        }
+
         /// Writes an individual buffer with max max_result_buffer_size samples
         void outputBuffer(MadAudioInfo &info, int16_t *result, int len ){
+            MAD_STATS_ENTER(MAD_STAGE_OUTPUT);
             // return result via callback
             if (pcmCallback!=nullptr){
                 pcmCallback(info, result, len);
@@ -418,19 +1221,7 @@ class MP3DecoderMAD  {
                 mad_output_stream->write((uint8_t*)result, len*sizeof(int16_t));
             }
 #endif
-        }
-
-        /// Scales the sample from internal MAD format to int16
-        static int16_t scale(mad_fixed_t sample) {
-            /* round */
-            if(sample>=MAD_F_ONE)
-                return(SHRT_MAX);
-            if(sample<=-MAD_F_ONE)
-                return(-SHRT_MAX);
-
-            /* Conversion. */
-            sample=sample>>(MAD_F_FRACBITS-15);
-            return((signed short)sample);
+            MAD_STATS_LEAVE();
         }
 
 };
@@ -0,0 +1,324 @@
+#pragma once
+
+#include "MP3DecoderMAD.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <chrono>
+
+namespace libmad {
+
+/**
+ * @brief Decoding result of an individual input of the MadBatchDecoder
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct MadBatchResult {
+    size_t index = 0;                     // position in the list of inputs
+    std::string name;                     // file path or name of the memory range
+    MadAudioInfo info;                    // last audio information
+    bool ok = false;                      // input could be read and at least one frame was decoded
+    size_t frames = 0;                    // number of decoded frames
+    size_t samples = 0;                   // number of decoded samples per channel
+    size_t errors = 0;                    // number of (recoverable) decoding errors
+    enum mad_error last_error = MAD_ERROR_NONE;
+    unsigned long duration_ms = 0;        // playing time of the decoded audio
+    double decode_sec = 0;                // wall time used for decoding
+
+    /// Decoding speed as multiple of the playing time
+    double realtimeFactor() const {
+        return decode_sec > 0 ? duration_ms / 1000.0 / decode_sec : 0;
+    }
+};
+
+/// Callback which receives the decoded data of an input (called by the decoding threads)
+typedef void (*MadBatchDataCallback)(MadBatchResult &result, MadAudioInfo &info, int16_t *pwm_buffer, size_t len);
+/// Callback which is called when an input has been processed (called by the decoding threads)
+typedef void (*MadBatchResultCallback)(MadBatchResult &result);
+
+/**
+ * @brief Decodes a list of mp3 files or memory ranges with a pool of threads. Each
+ * thread has its own decoder context and takes its inputs from its own queue: if the
+ * queue is empty it steals the work from the end of the queues of the other threads.
+ * The results are reported per input and as aggregated throughput.
+ *
+ * Please note that libmad must be compiled with MAD_STACK_HACK=0.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadBatchDecoder {
+
+    public:
+
+        MadBatchDecoder() = default;
+
+        MadBatchDecoder(MadBatchDataCallback dataCallback, MadBatchResultCallback resultCB=nullptr){
+            setDataCallback(dataCallback);
+            setResultCallback(resultCB);
+        }
+
+        /// Defines the callback which receives the decoded data: if not defined we do not convert the result to int16_t
+        void setDataCallback(MadBatchDataCallback cb){
+            data_callback = cb;
+        }
+
+        /// Defines the callback which is called when an input has been processed
+        void setResultCallback(MadBatchResultCallback cb){
+            result_callback = cb;
+        }
+
+        /// Defines the number of decoding threads (0 = number of cores)
+        void setThreads(int count){
+            threads = count;
+        }
+
+        /// Adds a file to the list of inputs
+        void add(const char *path){
+            Input input;
+            input.name = path;
+            inputs.push_back(input);
+        }
+
+        /// Adds a memory range to the list of inputs: the data must stay valid until decode() returns
+        void add(const void *data, size_t len, const char *name="memory"){
+            Input input;
+            input.name = name;
+            input.data = (const uint8_t*) data;
+            input.size = len;
+            inputs.push_back(input);
+        }
+
+        /// Removes all inputs and results
+        void clear(){
+            inputs.clear();
+            result_vector.clear();
+        }
+
+        /// Decodes all inputs: returns true if all of them were decoded successfully
+        bool decode(){
+            result_vector.clear();
+            result_vector.resize(inputs.size());
+            int thread_count = threadCount();
+            queues.clear();
+            for (int j=0; j<thread_count; j++){
+                queues.emplace_back(new Queue());
+            }
+            // distribute the work
+            for (size_t j=0; j<inputs.size(); j++){
+                queues[j % thread_count]->items.push_back(j);
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> pool;
+            for (int j=0; j<thread_count; j++){
+                pool.emplace_back([this, j](){ work(j); });
+            }
+            for (auto &t : pool){
+                t.join();
+            }
+            wall_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            bool result = true;
+            for (auto &r : result_vector){
+                if (!r.ok) result = false;
+            }
+            return result;
+        }
+
+        /// Provides the results of all inputs
+        std::vector<MadBatchResult> &results(){
+            return result_vector;
+        }
+
+        /// Total playing time of all decoded inputs
+        double audioSeconds(){
+            double result = 0;
+            for (auto &r : result_vector){
+                result += r.duration_ms / 1000.0;
+            }
+            return result;
+        }
+
+        /// Wall time of the last decode() call
+        double wallSeconds(){
+            return wall_sec;
+        }
+
+        /// Aggregated decoding speed as multiple of the playing time
+        double realtimeFactor(){
+            return wall_sec > 0 ? audioSeconds() / wall_sec : 0;
+        }
+
+    protected:
+        /// Memory range or file
+        struct Input {
+            std::string name;
+            const uint8_t *data = nullptr;
+            size_t size = 0;
+        };
+
+        /// Work queue of a thread
+        struct Queue {
+            std::mutex mtx;
+            std::deque<size_t> items;
+        };
+
+        /// Decoder state and buffers which are reused by a thread
+        struct Context {
+            struct mad_stream stream;
+            struct mad_frame frame;
+            struct mad_synth synth;
+            std::vector<uint8_t> file_data;
+            std::vector<uint8_t> tail;
+            int16_t pcm[2 * 1152];
+        };
+
+        MadBatchDataCallback data_callback = nullptr;
+        MadBatchResultCallback result_callback = nullptr;
+        int threads = 0;
+        double wall_sec = 0;
+        std::vector<Input> inputs;
+        std::vector<MadBatchResult> result_vector;
+        std::vector<std::unique_ptr<Queue>> queues;
+
+        int threadCount(){
+            int result = threads;
+            if (result<=0) result = std::thread::hardware_concurrency();
+            return result > 0 ? result : 1;
+        }
+
+        /// Takes the next input from the own queue or steals it from another one
+        bool nextInput(int id, size_t &idx){
+            {
+                Queue &own = *queues[id];
+                std::lock_guard<std::mutex> lock(own.mtx);
+                if (!own.items.empty()){
+                    idx = own.items.front();
+                    own.items.pop_front();
+                    return true;
+                }
+            }
+            for (size_t j=1; j<queues.size(); j++){
+                Queue &other = *queues[(id + j) % queues.size()];
+                std::lock_guard<std::mutex> lock(other.mtx);
+                if (!other.items.empty()){
+                    idx = other.items.back();
+                    other.items.pop_back();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// Thread: processes inputs until all queues are empty
+        void work(int id){
+            std::unique_ptr<Context> ctx(new Context());
+            size_t idx;
+            while (nextInput(id, idx)){
+                MadBatchResult &result = result_vector[idx];
+                result.index = idx;
+                result.name = inputs[idx].name;
+                auto start = std::chrono::steady_clock::now();
+                decodeInput(*ctx, inputs[idx], result);
+                result.decode_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                if (result_callback!=nullptr){
+                    result_callback(result);
+                }
+            }
+        }
+
+        /// Reads the file into the context buffer
+        bool readFile(Context &ctx, const char *path){
+            ctx.file_data.clear();
+            FILE *file = fopen(path, "rb");
+            if (file == nullptr) return false;
+            uint8_t tmp[4096];
+            size_t len;
+            while ((len = fread(tmp, 1, sizeof(tmp), file)) > 0){
+                ctx.file_data.insert(ctx.file_data.end(), tmp, tmp + len);
+            }
+            fclose(file);
+            // make sure that the last frame is decoded as well
+            ctx.file_data.resize(ctx.file_data.size() + MAD_BUFFER_GUARD, 0);
+            return true;
+        }
+
+        void decodeInput(Context &ctx, Input &input, MadBatchResult &result){
+            const uint8_t *data = input.data;
+            size_t size = input.size;
+            // memory inputs get the guard with the copy of the last bytes
+            bool is_guard = data == nullptr;
+            if (data == nullptr){
+                if (!readFile(ctx, input.name.c_str())){
+                    LOG(Error, "could not read %s", input.name.c_str());
+                    return;
+                }
+                data = ctx.file_data.data();
+                size = ctx.file_data.size();
+            }
+
+            mad_timer_t duration = mad_timer_zero;
+            mad_stream_init(&ctx.stream);
+            mad_frame_init(&ctx.frame);
+            mad_synth_init(&ctx.synth);
+            mad_stream_buffer(&ctx.stream, data, size);
+            while(true){
+                if (mad_frame_decode(&ctx.frame, &ctx.stream)==-1){
+                    if (ctx.stream.error == MAD_ERROR_BUFLEN && !is_guard){
+                        continueWithGuard(ctx);
+                        is_guard = true;
+                        continue;
+                    }
+                    if (!MAD_RECOVERABLE(ctx.stream.error)) break;
+                    // the guard at the end is not a decoding error
+                    if (ctx.stream.error == MAD_ERROR_LOSTSYNC && ctx.stream.bufend - ctx.stream.this_frame <= MAD_BUFFER_GUARD) continue;
+                    result.errors++;
+                    result.last_error = ctx.stream.error;
+                    continue;
+                }
+                mad_synth_frame(&ctx.synth, &ctx.frame);
+                mad_timer_add(&duration, ctx.frame.header.duration);
+                result.frames++;
+                result.samples += ctx.synth.pcm.length;
+                result.info = MadAudioInfo(ctx.synth.pcm);
+                if (data_callback!=nullptr){
+                    output(ctx, result);
+                }
+            }
+            mad_synth_finish(&ctx.synth);
+            mad_frame_finish(&ctx.frame);
+            mad_stream_finish(&ctx.stream);
+
+            result.duration_ms = mad_timer_count(duration, MAD_UNITS_MILLISECONDS);
+            result.ok = result.frames > 0;
+        }
+
+        /// Continues with a copy of the remaining data followed by MAD_BUFFER_GUARD zero bytes, so that the last frame is decoded as well
+        void continueWithGuard(Context &ctx){
+            const uint8_t *start = ctx.stream.next_frame;
+            ctx.tail.assign(start, (const uint8_t*) ctx.stream.bufend);
+            ctx.tail.resize(ctx.tail.size() + MAD_BUFFER_GUARD, 0);
+            mad_stream_buffer(&ctx.stream, ctx.tail.data(), ctx.tail.size());
+        }
+
+        /// Converts the frame to int16_t and provides it to the data callback
+        void output(Context &ctx, MadBatchResult &result){
+            struct mad_pcm &pcm = ctx.synth.pcm;
+            int16_t *out = ctx.pcm;
+            for (int j=0; j<pcm.length; j++){
+                for (int ch=0; ch<pcm.channels; ch++){
+                    *out++ = MP3DecoderMAD::scale(pcm.samples[ch][j]);
+                }
+            }
+            data_callback(result, result.info, ctx.pcm, out - ctx.pcm);
+        }
+
+};
+
+}
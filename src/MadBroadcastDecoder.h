@@ -0,0 +1,361 @@
+#pragma once
+
+#include "MP3DecoderMAD.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+namespace libmad {
+
+#ifndef MAD_BROADCAST_BLOCKS
+#define MAD_BROADCAST_BLOCKS 16
+#endif
+
+/**
+ * @brief Decoded frame which is shared by all subscribers of a MadBroadcastDecoder: the samples
+ * are stored interleaved in the internal libmad format. The block is reused when all subscribers
+ * which were registered at the time of the decoding have released it.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct MadPCMBlock {
+    MadAudioInfo info;
+    size_t frames = 0;                      // samples per channel
+    size_t seq = 0;                         // frame number
+    std::atomic<int> refs{0};               // subscribers which did not release the block yet
+    mad_fixed_t samples[2 * 1152];
+};
+
+class MadBroadcastDecoder;
+
+/**
+ * @brief Listener of a MadBroadcastDecoder with its own read position: a subscriber starts at
+ * the next decoded frame and is used by a single thread. The data can be accessed w/o copying
+ * with acquire() and release() or it can be converted with readPCM(). If the subscriber falls
+ * behind by all blocks of the decoder, it continues with the newest half of the blocks and the
+ * skipped frames are counted by overruns(). This does not affect the other subscribers: but a
+ * block from acquire() is never taken away, so it should be released promptly.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadBroadcastSubscriber {
+    public:
+        MadBroadcastSubscriber() = default;
+
+        MadBroadcastSubscriber(MadBroadcastDecoder &source){
+            subscribe(source);
+        }
+
+        ~MadBroadcastSubscriber(){
+            unsubscribe();
+        }
+
+        MadBroadcastSubscriber(const MadBroadcastSubscriber&) = delete;
+        MadBroadcastSubscriber& operator=(const MadBroadcastSubscriber&) = delete;
+
+        /// Starts to listen at the next frame boundary
+        inline void subscribe(MadBroadcastDecoder &source);
+
+        /// Stops listening: all blocks which were not read yet are released
+        inline void unsubscribe();
+
+        /// Provides the next decoded frame w/o copying or nullptr if no data is available: call release() when done
+        inline const MadPCMBlock *acquire();
+
+        /// Releases the actual frame
+        inline void release();
+
+        /// Provides up to the requested number of frames as interleaved int16_t samples: returns 0 if no data is available
+        size_t readPCM(int16_t *data, size_t frames){
+            return readSamples(data, frames);
+        }
+
+        /// Provides up to the requested number of frames as interleaved float samples
+        size_t readPCM(float *data, size_t frames){
+            return readSamples(data, frames);
+        }
+
+        /// Audio information of the last read data
+        MadAudioInfo audioInfo(){
+            return info;
+        }
+
+        /// Returns true if we are subscribed
+        bool isActive(){
+            return p_source != nullptr;
+        }
+
+        /// Number of the next frame which will be read
+        size_t position(){
+            return cursor.load(std::memory_order_acquire);
+        }
+
+        /// Number of frames which were skipped because this subscriber was too slow
+        size_t overruns(){
+            return skip_count.load(std::memory_order_relaxed);
+        }
+
+    protected:
+        friend class MadBroadcastDecoder;
+        MadBroadcastDecoder *p_source = nullptr;
+        std::atomic<size_t> cursor{0};      // next frame
+        std::atomic<size_t> skip_count{0};
+        size_t offset = 0;      // next sample in the actual frame
+        MadAudioInfo info;
+        // held while we access a block: the decoder only moves the cursor with this lock
+        std::mutex mtx;
+        bool is_acquired = false;
+        // the block is provided by acquire(), so the decoder does not wait for the release
+        std::atomic<bool> is_pinned{false};
+
+        /// Locks the block at the cursor: returns nullptr if no data is available
+        inline const MadPCMBlock *lockBlock();
+
+        /// Unlocks the actual block w/o releasing it
+        void unlockBlock(){
+            is_pinned.store(false, std::memory_order_relaxed);
+            is_acquired = false;
+            mtx.unlock();
+        }
+
+        /// Decoder: skips the frames before target if we are not accessing a block; called with the lock of the decoder
+        inline void skip(size_t target);
+
+        static void convert(mad_fixed_t sample, int16_t &result){
+            result = MP3DecoderMAD::scale(sample);
+        }
+
+        static void convert(mad_fixed_t sample, float &result){
+            result = MP3DecoderMAD::scaleFloat(sample);
+        }
+
+        template <typename T>
+        size_t readSamples(T *data, size_t frames){
+            size_t result = 0;
+            const MadPCMBlock *block;
+            while (result < frames && (block = lockBlock()) != nullptr){
+                if (offset == 0 && info != block->info){
+                    // we do not mix different formats in one result
+                    if (result > 0) break;
+                    info = block->info;
+                }
+                size_t len = min(frames - result, block->frames - offset / info.channels);
+                const mad_fixed_t *in = block->samples + offset;
+                size_t samples = len * info.channels;
+                for (size_t j=0; j<samples; j++){
+                    convert(in[j], *data++);
+                }
+                offset += samples;
+                result += len;
+                if (offset >= block->frames * info.channels){
+                    release();
+                }
+            }
+            // a partially read frame is not locked between the calls
+            if (is_acquired) unlockBlock();
+            return result;
+        }
+};
+
+/**
+ * @brief Decodes a single source once for many subscribers: each decoded frame is published
+ * as a reference counted MadPCMBlock and each MadBroadcastSubscriber reads it with its own read
+ * position and conversion. So the decoding cost does not depend on the number of listeners.
+ * The encoded data is provided with write() from a single thread. If the oldest block is still
+ * referenced by a slow subscriber, this subscriber skips it (see MadBroadcastSubscriber::overruns())
+ * unless the blocking mode is active: so the other subscribers do not depend on the slowest one.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadBroadcastDecoder : public MadPCMOutput {
+
+    friend class MadBroadcastSubscriber;
+
+    public:
+
+        MadBroadcastDecoder(size_t blockCount=MAD_BROADCAST_BLOCKS){
+            block_count = blockCount > 0 ? blockCount : 1;
+            blocks = new MadPCMBlock[block_count];
+        }
+
+        ~MadBroadcastDecoder(){
+            delete [] blocks;
+        }
+
+        MadBroadcastDecoder(const MadBroadcastDecoder&) = delete;
+        MadBroadcastDecoder& operator=(const MadBroadcastDecoder&) = delete;
+
+        /// Starts the decoder: returns false if the decoder could not be started
+        bool begin(){
+            mp3.setOutput(*this);
+            return mp3.begin();
+        }
+
+        /// Ends the decoder: the remaining data is still available for the subscribers
+        void end(){
+            mp3.end();
+        }
+
+        /// Provides the encoded data
+        size_t write(const void *data, size_t len){
+            return mp3.write(data, len);
+        }
+
+        /// If active we wait for slow subscribers instead of dropping the frame
+        void setBlocking(bool active){
+            is_blocking = active;
+        }
+
+        /// Provides access to the decoder e.g. to define the input source
+        MP3DecoderMAD &decoder(){
+            return mp3;
+        }
+
+        /// Number of frames which can be decoded w/o overrun
+        size_t availableForWrite(){
+            size_t result = 0;
+            size_t idx = write_idx.load(std::memory_order_relaxed);
+            while (result < block_count && blocks[(idx + result) % block_count].refs.load(std::memory_order_acquire) == 0){
+                result++;
+            }
+            return result;
+        }
+
+        /// Number of active subscribers
+        size_t subscribers(){
+            std::lock_guard<std::mutex> lock(mtx);
+            return subscriber_list.size();
+        }
+
+        /// Number of published frames
+        size_t frames(){
+            return write_idx.load(std::memory_order_acquire);
+        }
+
+        /// Number of frames which were dropped for all subscribers because a slow subscriber did not release the oldest block from acquire()
+        size_t overruns(){
+            return overrun_count.load(std::memory_order_relaxed);
+        }
+
+        /// Publishes the decoded frame to all subscribers: called by the decoder
+        void writeFrame(struct mad_header const *, struct mad_pcm *pcm) override {
+            size_t idx = write_idx.load(std::memory_order_relaxed);
+            MadPCMBlock &block = blocks[idx % block_count];
+            // the references are only released, so we can wait w/o lock
+            while (is_blocking && block.refs.load(std::memory_order_acquire) > 0){
+                std::this_thread::yield();
+            }
+            std::lock_guard<std::mutex> lock(mtx);
+            if (block.refs.load(std::memory_order_acquire) > 0){
+                // subscribers which did not read the oldest frame yet continue with the newest half of the blocks
+                for (MadBroadcastSubscriber *subscriber : subscriber_list){
+                    subscriber->skip(idx - block_count / 2);
+                }
+            }
+            if (block.refs.load(std::memory_order_acquire) > 0){
+                overrun_count++;
+                return;
+            }
+            block.info = MadAudioInfo(*pcm);
+            block.frames = pcm->length;
+            block.seq = idx;
+            mad_fixed_t *out = block.samples;
+            for (int j=0; j<pcm->length; j++){
+                for (int ch=0; ch<pcm->channels; ch++){
+                    *out++ = pcm->samples[ch][j];
+                }
+            }
+            block.refs.store(subscriber_list.size(), std::memory_order_relaxed);
+            write_idx.store(idx + 1, std::memory_order_release);
+        }
+
+    protected:
+        MP3DecoderMAD mp3;
+        MadPCMBlock *blocks = nullptr;
+        size_t block_count = 0;
+        std::atomic<size_t> write_idx{0};
+        std::vector<MadBroadcastSubscriber*> subscriber_list;
+        std::atomic<size_t> overrun_count{0};
+        bool is_blocking = false;
+        // protects the subscribers against the publishing of a frame
+        std::mutex mtx;
+};
+
+void MadBroadcastSubscriber::subscribe(MadBroadcastDecoder &source){
+    unsubscribe();
+    std::lock_guard<std::mutex> lock(source.mtx);
+    p_source = &source;
+    cursor.store(source.write_idx.load(std::memory_order_relaxed), std::memory_order_release);
+    offset = 0;
+    source.subscriber_list.push_back(this);
+}
+
+void MadBroadcastSubscriber::unsubscribe(){
+    if (p_source == nullptr) return;
+    // the decoder might wait for our block while it holds its lock
+    if (is_acquired) unlockBlock();
+    std::lock_guard<std::mutex> lock(p_source->mtx);
+    size_t end = p_source->write_idx.load(std::memory_order_relaxed);
+    for (size_t pos = cursor.load(std::memory_order_relaxed); pos < end; pos++){
+        p_source->blocks[pos % p_source->block_count].refs.fetch_sub(1, std::memory_order_release);
+    }
+    cursor.store(end, std::memory_order_release);
+    auto &list = p_source->subscriber_list;
+    list.erase(std::remove(list.begin(), list.end(), this), list.end());
+    p_source = nullptr;
+}
+
+const MadPCMBlock *MadBroadcastSubscriber::acquire(){
+    // set before the lock, so that the decoder never waits for a block which is held until release()
+    is_pinned.store(true, std::memory_order_release);
+    const MadPCMBlock *result = lockBlock();
+    if (result == nullptr) is_pinned.store(false, std::memory_order_relaxed);
+    return result;
+}
+
+const MadPCMBlock *MadBroadcastSubscriber::lockBlock(){
+    if (p_source == nullptr) return nullptr;
+    if (!is_acquired){
+        mtx.lock();
+        is_acquired = true;
+    }
+    size_t pos = cursor.load(std::memory_order_relaxed);
+    if (pos == p_source->write_idx.load(std::memory_order_acquire)){
+        unlockBlock();
+        return nullptr;
+    }
+    return &p_source->blocks[pos % p_source->block_count];
+}
+
+void MadBroadcastSubscriber::release(){
+    if (!is_acquired && lockBlock() == nullptr) return;
+    size_t pos = cursor.load(std::memory_order_relaxed);
+    p_source->blocks[pos % p_source->block_count].refs.fetch_sub(1, std::memory_order_release);
+    cursor.store(pos + 1, std::memory_order_release);
+    offset = 0;
+    unlockBlock();
+}
+
+void MadBroadcastSubscriber::skip(size_t target){
+    if (cursor.load(std::memory_order_acquire) >= target) return;
+    // readPCM() only holds the lock for the conversion of a frame: we never wait for acquire()
+    while (!mtx.try_lock()){
+        if (is_pinned.load(std::memory_order_acquire)) return;
+        std::this_thread::yield();
+    }
+    size_t pos;
+    for (pos = cursor.load(std::memory_order_relaxed); pos < target; pos++){
+        p_source->blocks[pos % p_source->block_count].refs.fetch_sub(1, std::memory_order_release);
+        skip_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    cursor.store(pos, std::memory_order_release);
+    offset = 0;
+    mtx.unlock();
+}
+
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "MP3DecoderMAD.h"
+#include <math.h>
+
+namespace libmad {
+
+#ifndef MAD_EQUALIZER_SMOOTHING
+/// Number of slots (of 32 samples) over which a gain change is ramped
+#define MAD_EQUALIZER_SMOOTHING 8
+#endif
+
+/**
+ * @brief Equalizer with a gain for each of the 32 subbands of the polyphase filterbank: the
+ * subband samples are scaled between the decoding and the synthesis, which only costs one
+ * multiplication per subband sample instead of a cascade of biquads per output sample. Each
+ * subband covers sample rate / 64 Hz (e.g. 689 Hz at 44.1 kHz), so the resolution is coarse
+ * at the low frequencies. Gain changes are ramped linearly over MAD_EQUALIZER_SMOOTHING slots.
+ * Use it with MP3DecoderMAD::setFrameFilter(MadEqualizer::filter, &equalizer) or call process()
+ * before mad_synth_frame().
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadEqualizer {
+
+    public:
+
+        MadEqualizer(){
+            for (int sb=0; sb<32; sb++){
+                current[sb] = target[sb] = MAD_F_ONE;
+                step[sb] = 0;
+            }
+        }
+
+        /// Defines the linear gain (0 to MAD_GAIN_MAX) of the indicated subband
+        void setGain(int subband, float gain){
+            if (subband < 0 || subband >= 32) return;
+            if (gain < 0.0f) gain = 0.0f;
+            if (gain > MAD_GAIN_MAX) gain = MAD_GAIN_MAX;
+            target[subband] = mad_f_tofixed(gain);
+            // a running ramp continues from the actual gains
+            for (int sb=0; sb<32; sb++){
+                step[sb] = (target[sb] - current[sb]) / smoothing_slots;
+            }
+            steps = smoothing_slots;
+            is_unity = false;
+        }
+
+        /// Defines the gain of the indicated subband in dB
+        void setGainDb(int subband, float db){
+            setGain(subband, powf(10.0f, db / 20.0f));
+        }
+
+        /// Defines the gain in dB for all subbands which overlap the indicated frequency range
+        void setGainDb(float fromHz, float toHz, float db, int sampleRate){
+            for (int sb=subband(fromHz, sampleRate); sb<=subband(toHz, sampleRate); sb++){
+                setGainDb(sb, db);
+            }
+        }
+
+        /// Provides the (target) gain of the indicated subband
+        float gain(int subband){
+            return mad_f_todouble(target[subband]);
+        }
+
+        /// Sets all gains back to 1.0
+        void reset(){
+            for (int sb=0; sb<32; sb++){
+                setGain(sb, 1.0f);
+            }
+        }
+
+        /// Defines the number of slots over which a gain change is ramped
+        void setSmoothing(int slots){
+            smoothing_slots = slots < 1 ? 1 : slots;
+        }
+
+        /// Determines the subband which contains the indicated frequency
+        static int subband(float hz, int sampleRate){
+            int result = sampleRate > 0 ? (int) (hz * 64.0f / sampleRate) : 0;
+            return result < 0 ? 0 : result > 31 ? 31 : result;
+        }
+
+        /// Scales the subband samples of the frame (or granule)
+        void process(struct mad_frame *frame){
+            if (is_unity) return;
+            int nch = MAD_NCHANNELS(&frame->header);
+            int ns = MAD_FRAME_NSBSAMPLES(frame);
+            for (int s=0; s<ns; s++){
+                for (int ch=0; ch<nch; ch++){
+                    mad_fixed_t *sample = frame->sbsample[ch][s];
+                    for (int sb=0; sb<32; sb++){
+                        sample[sb] = MadGain::mul(sample[sb], current[sb]);
+                    }
+                }
+                if (steps > 0) advance();
+            }
+        }
+
+        /// Frame filter for MP3DecoderMAD::setFrameFilter()
+        static void filter(struct mad_frame *frame, void *ref){
+            ((MadEqualizer*)ref)->process(frame);
+        }
+
+    protected:
+        mad_fixed_t current[32];
+        mad_fixed_t target[32];
+        mad_fixed_t step[32];
+        int steps = 0;              // remaining slots of the ramp
+        int smoothing_slots = MAD_EQUALIZER_SMOOTHING;
+        bool is_unity = true;       // all gains are 1.0: we do not need to process the samples
+
+        /// Moves the gains one slot towards the target
+        void advance(){
+            steps--;
+            bool unity = true;
+            for (int sb=0; sb<32; sb++){
+                current[sb] = steps == 0 ? target[sb] : current[sb] + step[sb];
+                if (current[sb] != MAD_F_ONE) unity = false;
+            }
+            is_unity = unity && steps == 0;
+        }
+};
+
+}
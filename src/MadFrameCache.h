@@ -0,0 +1,460 @@
+#pragma once
+
+#include "MadFrameTable.h"
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+
+namespace libmad {
+
+#ifndef MAD_FRAME_CACHE_BUDGET
+#define MAD_FRAME_CACHE_BUDGET (8 * 1024 * 1024)
+#endif
+
+/**
+ * @brief LRU cache of decoded frames (int16_t) which is keyed by the source id and the frame
+ * number: the least recently used frames are removed if the memory budget is exceeded. The
+ * frames can optionally be stored with a simple lossless compression (delta of the samples
+ * of each channel as variable length integer). The cache can be shared by several threads.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadFrameCache {
+
+    public:
+
+        MadFrameCache(size_t budgetBytes=MAD_FRAME_CACHE_BUDGET){
+            budget = budgetBytes;
+        }
+
+        /// Defines the maximum memory which is used by the cache
+        void setBudget(size_t bytes){
+            std::lock_guard<std::mutex> lock(mtx);
+            budget = bytes;
+            evict();
+        }
+
+        /// Activates the compression of the frames which are added to the cache
+        void setCompression(bool active){
+            is_compression.store(active, std::memory_order_relaxed);
+        }
+
+        /// Adds a decoded frame: returns false if it does not fit into the budget
+        bool put(uint32_t source, size_t frame, MadAudioInfo info, const int16_t *pcm, size_t samples){
+            if (samples == 0 || info.channels < 1) return false;
+            Entry entry;
+            entry.key = key(source, frame);
+            entry.info = info;
+            entry.samples = samples;
+            // the compression is done w/o lock
+            if (is_compression.load(std::memory_order_relaxed)){
+                entry.is_compressed = compress(pcm, samples, info.channels, entry.data);
+            }
+            if (!entry.is_compressed){
+                entry.data.resize(samples * sizeof(int16_t));
+                memcpy(entry.data.data(), pcm, entry.data.size());
+            }
+            entry.data.shrink_to_fit();
+
+            std::lock_guard<std::mutex> lock(mtx);
+            if (entry.size() > budget) return false;
+            remove(entry.key);
+            used += entry.size();
+            lru.push_front(std::move(entry));
+            map[lru.front().key] = lru.begin();
+            evict();
+            return true;
+        }
+
+        /// Provides the decoded frame: returns the number of samples (0 if the frame is not available)
+        size_t get(uint32_t source, size_t frame, int16_t *pcm, size_t maxSamples, MadAudioInfo &info){
+            std::lock_guard<std::mutex> lock(mtx);
+            auto it = map.find(key(source, frame));
+            if (it == map.end() || it->second->samples > maxSamples){
+                miss_count++;
+                return 0;
+            }
+            hit_count++;
+            // move to the front: most recently used
+            lru.splice(lru.begin(), lru, it->second);
+            Entry &entry = *it->second;
+            info = entry.info;
+            if (entry.is_compressed){
+                decompress(entry.data, pcm, entry.samples, info.channels);
+            } else {
+                memcpy(pcm, entry.data.data(), entry.samples * sizeof(int16_t));
+            }
+            return entry.samples;
+        }
+
+        /// Returns true if the frame is available (w/o updating the statistics)
+        bool contains(uint32_t source, size_t frame){
+            std::lock_guard<std::mutex> lock(mtx);
+            return map.find(key(source, frame)) != map.end();
+        }
+
+        /// Removes all frames of the indicated source
+        void erase(uint32_t source){
+            std::lock_guard<std::mutex> lock(mtx);
+            for (auto it = lru.begin(); it != lru.end();){
+                if ((it->key >> 32) == source){
+                    used -= it->size();
+                    map.erase(it->key);
+                    it = lru.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        /// Removes all frames
+        void clear(){
+            std::lock_guard<std::mutex> lock(mtx);
+            lru.clear();
+            map.clear();
+            used = 0;
+        }
+
+        /// Resets the statistics
+        void clearStatistics(){
+            std::lock_guard<std::mutex> lock(mtx);
+            hit_count = 0;
+            miss_count = 0;
+            eviction_count = 0;
+        }
+
+        /// Number of successful get() calls
+        size_t hits(){
+            std::lock_guard<std::mutex> lock(mtx);
+            return hit_count;
+        }
+
+        /// Number of get() calls for frames which were not available
+        size_t misses(){
+            std::lock_guard<std::mutex> lock(mtx);
+            return miss_count;
+        }
+
+        /// Number of frames which were removed to stay within the budget
+        size_t evictions(){
+            std::lock_guard<std::mutex> lock(mtx);
+            return eviction_count;
+        }
+
+        /// Ratio of hits to all get() calls
+        float hitRate(){
+            std::lock_guard<std::mutex> lock(mtx);
+            size_t total = hit_count + miss_count;
+            return total > 0 ? (float) hit_count / total : 0.0f;
+        }
+
+        /// Used memory in bytes
+        size_t size(){
+            std::lock_guard<std::mutex> lock(mtx);
+            return used;
+        }
+
+        /// Number of cached frames
+        size_t count(){
+            std::lock_guard<std::mutex> lock(mtx);
+            return lru.size();
+        }
+
+    protected:
+        /// Cached frame
+        struct Entry {
+            uint64_t key = 0;
+            MadAudioInfo info;
+            size_t samples = 0;
+            bool is_compressed = false;
+            std::vector<uint8_t> data;
+
+            /// Memory which is used by the entry incl. the list and map nodes
+            size_t size() const {
+                return data.capacity() + sizeof(Entry) + 4 * sizeof(void*);
+            }
+        };
+        std::list<Entry> lru;   // most recently used first
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> map;
+        std::mutex mtx;
+        size_t budget;
+        size_t used = 0;
+        size_t hit_count = 0;
+        size_t miss_count = 0;
+        size_t eviction_count = 0;
+        std::atomic<bool> is_compression{false};
+
+        static uint64_t key(uint32_t source, size_t frame){
+            return ((uint64_t) source << 32) | (uint32_t) frame;
+        }
+
+        void remove(uint64_t key){
+            auto it = map.find(key);
+            if (it == map.end()) return;
+            used -= it->second->size();
+            lru.erase(it->second);
+            map.erase(it);
+        }
+
+        /// Removes the least recently used frames until we are within the budget
+        void evict(){
+            while (used > budget && !lru.empty()){
+                used -= lru.back().size();
+                map.erase(lru.back().key);
+                lru.pop_back();
+                eviction_count++;
+            }
+        }
+
+        /// Stores the difference to the previous sample of the channel as zigzag encoded variable length integer
+        static bool compress(const int16_t *pcm, size_t samples, int channels, std::vector<uint8_t> &out){
+            size_t limit = samples * sizeof(int16_t);
+            out.resize(limit + 3);
+            uint8_t *data = out.data();
+            uint8_t *end = data + limit;
+            int32_t last[2] = {0, 0};
+            for (size_t j=0; j<samples; j++){
+                int ch = j % channels;
+                int32_t delta = pcm[j] - last[ch];
+                last[ch] = pcm[j];
+                uint32_t value = ((uint32_t) delta << 1) ^ (uint32_t)(delta >> 31);
+                while (value >= 0x80){
+                    *data++ = (uint8_t)(value | 0x80);
+                    value >>= 7;
+                }
+                *data++ = (uint8_t) value;
+                // the compression does not help
+                if (data >= end) return false;
+            }
+            out.resize(data - out.data());
+            return true;
+        }
+
+        static void decompress(const std::vector<uint8_t> &in, int16_t *pcm, size_t samples, int channels){
+            int32_t last[2] = {0, 0};
+            const uint8_t *data = in.data();
+            for (size_t j=0; j<samples; j++){
+                uint32_t value = 0;
+                int shift = 0;
+                uint8_t byte;
+                do {
+                    byte = *data++;
+                    value |= (uint32_t)(byte & 0x7F) << shift;
+                    shift += 7;
+                } while (byte & 0x80);
+                int32_t delta = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+                int ch = j % channels;
+                last[ch] += delta;
+                pcm[j] = (int16_t) last[ch];
+            }
+        }
+
+};
+
+/**
+ * @brief Decoder for mp3 data which is available in memory with random access to the frames:
+ * the frames are taken from a MadFrameCache if possible and otherwise they are decoded with
+ * libmad and added to the cache. After a seek or after cached frames the decoding is restarted
+ * a few warm-up frames early (see MadFrameTable), so the result is identical to a sequential
+ * decoding. The result is provided as int16_t via the data callback only: this is a separate
+ * decoder which does not use the output stage of MP3DecoderMAD, so the gain, setOutputFormat(),
+ * a MadPCMOutput, readPCM() and the Arduino Print output are not available. Apply such a
+ * processing in the data callback.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadCachedDecoder {
+
+    public:
+
+        MadCachedDecoder() = default;
+
+        MadCachedDecoder(MP3DataCallback dataCallback, MP3InfoCallback infoCB=nullptr){
+            setDataCallback(dataCallback);
+            setInfoCallback(infoCB);
+        }
+
+        ~MadCachedDecoder(){
+            end();
+        }
+
+        /// Defines the callback which receives the decoded data
+        void setDataCallback(MP3DataCallback cb){
+            data_callback = cb;
+        }
+
+        /// Defines the callback which receives the Info changes
+        void setInfoCallback(MP3InfoCallback cb){
+            info_callback = cb;
+        }
+
+        /// Defines the cache: if not defined, all frames are decoded with libmad
+        void setCache(MadFrameCache &cache){
+            p_cache = &cache;
+        }
+
+        /// Defines the minimum number of warm-up frames which are decoded after a seek
+        void setWarmupFrames(size_t frames){
+            warmup_frames = frames;
+        }
+
+        /// Defines the mp3 data with the id which is used in the cache: the data must stay valid until end()
+        bool begin(uint32_t sourceId, const void *data, size_t len){
+            end();
+            source_id = sourceId;
+            p_data = (const uint8_t*) data;
+            data_len = len;
+            table.build(p_data, data_len);
+            mad_stream_init(&stream);
+            mad_frame_init(&frame);
+            mad_synth_init(&synth);
+            active = true;
+            pos = 0;
+            next_decode = SIZE_MAX;
+            decoded_frames = 0;
+            return !table.empty();
+        }
+
+        /// Releases the libmad state
+        void end(){
+            if (active){
+                mad_synth_finish(&synth);
+                mad_frame_finish(&frame);
+                mad_stream_finish(&stream);
+                active = false;
+            }
+        }
+
+        /// Moves to the indicated frame
+        bool seek(size_t frameNo){
+            if (frameNo > table.size()) return false;
+            pos = frameNo;
+            return true;
+        }
+
+        /// Provides the next count frames from the cache or from libmad via the data callback: returns the number of processed frames
+        size_t decode(size_t count){
+            if (!active) return 0;
+            size_t result = 0;
+            while (result < count && pos < table.size()){
+                MadAudioInfo info;
+                size_t len = 0;
+                if (p_cache != nullptr){
+                    len = p_cache->get(source_id, pos, pcm, sizeof(pcm) / sizeof(int16_t), info);
+                }
+                if (len == 0){
+                    len = decodeFrame(pos, info);
+                    if (len > 0 && p_cache != nullptr){
+                        p_cache->put(source_id, pos, info, pcm, len);
+                    }
+                }
+                if (len > 0){
+                    output(info, len);
+                }
+                pos++;
+                result++;
+            }
+            return result;
+        }
+
+        /// Actual frame number
+        size_t position(){
+            return pos;
+        }
+
+        /// Number of frames
+        size_t frames(){
+            return table.size();
+        }
+
+        /// Number of frames which were decoded with libmad (incl. the warm-up frames)
+        size_t decodedFrames(){
+            return decoded_frames;
+        }
+
+        /// Provides the frame table
+        MadFrameTable &frameTable(){
+            return table;
+        }
+
+    protected:
+        MP3DataCallback data_callback = nullptr;
+        MP3InfoCallback info_callback = nullptr;
+        MadFrameCache *p_cache = nullptr;
+        MadFrameTable table;
+        MadAudioInfo mad_info;
+        size_t warmup_frames = 2;
+        uint32_t source_id = 0;
+        const uint8_t *p_data = nullptr;
+        size_t data_len = 0;
+        bool active = false;
+        size_t pos = 0;             // next frame which is provided
+        size_t next_decode = 0;     // next frame which is decoded by libmad
+        size_t decoded_frames = 0;
+        struct mad_stream stream;
+        struct mad_frame frame;
+        struct mad_synth synth;
+        int16_t pcm[2 * 1152];
+
+        /// Decodes the frame with libmad: returns the number of samples
+        size_t decodeFrame(size_t frameNo, MadAudioInfo &info){
+            // we can continue if the libmad state is valid and the gap is smaller than the warm-up
+            if (next_decode > frameNo || table.warmupStart(frameNo, warmup_frames) > next_decode){
+                restart(frameNo);
+            }
+            const uint8_t *frame_start = p_data + table[frameNo].offset;
+            size_t result = 0;
+            while (true){
+                if (mad_frame_decode(&frame, &stream)==-1){
+                    if (MAD_RECOVERABLE(stream.error) && stream.this_frame < frame_start) continue;
+                    // the requested frame is not valid
+                    break;
+                }
+                decoded_frames++;
+                mad_synth_frame(&synth, &frame);
+                if (stream.this_frame >= frame_start){
+                    info = MadAudioInfo(synth.pcm);
+                    int16_t *out = pcm;
+                    for (int j=0; j<synth.pcm.length; j++){
+                        for (int ch=0; ch<synth.pcm.channels; ch++){
+                            *out++ = MP3DecoderMAD::scale(synth.pcm.samples[ch][j]);
+                        }
+                    }
+                    result = out - pcm;
+                    break;
+                }
+            }
+            next_decode = frameNo + 1;
+            return result;
+        }
+
+        /// Starts the decoding a few frames before the indicated frame
+        void restart(size_t frameNo){
+            size_t start = table.warmupStart(frameNo, warmup_frames);
+            LOG(Debug, "restart at %zu for %zu", start, frameNo);
+            mad_stream_finish(&stream);
+            mad_stream_init(&stream);
+            mad_frame_mute(&frame);
+            mad_synth_mute(&synth);
+            mad_stream_buffer(&stream, p_data + table[start].offset, data_len - table[start].offset);
+            next_decode = start;
+        }
+
+        void output(MadAudioInfo &info, size_t len){
+            if (info != mad_info){
+                if (info_callback != nullptr){
+                    info_callback(info);
+                }
+                mad_info = info;
+            }
+            if (data_callback != nullptr){
+                data_callback(info, pcm, len);
+            }
+        }
+
+};
+
+}
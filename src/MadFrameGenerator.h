@@ -0,0 +1,235 @@
+#pragma once
+
+#include "MP3DecoderMAD.h"
+#include <coroutine>
+#include <exception>
+
+#if !defined(__cpp_impl_coroutine)
+#error "MadFrameGenerator.h requires C++20 coroutines"
+#endif
+
+namespace libmad {
+
+#ifndef MAD_FRAME_GENERATOR_BUFFER_SIZE
+#define MAD_FRAME_GENERATOR_BUFFER_SIZE 4096
+#endif
+
+/**
+ * @brief View on a decoded frame (or granule) which is provided by decodeFrames(): the data
+ * is only valid until the generator is resumed. If no pcm is available the generator is
+ * waiting for more input data.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct MadFrameView {
+    const struct mad_header *header = nullptr;
+    const struct mad_pcm *pcm = nullptr;
+    mad_timer_t timestamp = mad_timer_zero;     // playing position of the first sample
+    size_t index = 0;                           // frame number
+
+    /// Returns true if the source has no data at the moment
+    bool isWaiting() const {
+        return pcm == nullptr;
+    }
+
+    MadAudioInfo audioInfo() const {
+        MadAudioInfo info;
+        if (pcm != nullptr){
+            info.sample_rate = pcm->samplerate;
+            info.channels = pcm->channels;
+        }
+        return info;
+    }
+};
+
+/**
+ * @brief Generator which lazily provides the decoded frames: call next() to decode the next
+ * frame or iterate over it with a range based for loop.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadFrameGenerator {
+    public:
+        struct promise_type {
+            MadFrameView view;
+
+            MadFrameGenerator get_return_object(){
+                return MadFrameGenerator(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            std::suspend_always yield_value(const MadFrameView &value) noexcept {
+                view = value;
+                return {};
+            }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+
+        /// Range based for loop support
+        class iterator {
+            public:
+                iterator(MadFrameGenerator *generator) : p_generator(generator) {}
+                const MadFrameView &operator*() const { return p_generator->value(); }
+                iterator &operator++() {
+                    if (!p_generator->next()) p_generator = nullptr;
+                    return *this;
+                }
+                bool operator!=(const iterator &alt) const { return p_generator != alt.p_generator; }
+            protected:
+                MadFrameGenerator *p_generator;
+        };
+
+        MadFrameGenerator(MadFrameGenerator &&alt) noexcept : handle(alt.handle) {
+            alt.handle = nullptr;
+        }
+
+        MadFrameGenerator(const MadFrameGenerator&) = delete;
+        MadFrameGenerator& operator=(const MadFrameGenerator&) = delete;
+
+        ~MadFrameGenerator(){
+            if (handle) handle.destroy();
+        }
+
+        /// Decodes the next frame: returns false at the end of the data
+        bool next(){
+            if (!handle || handle.done()) return false;
+            handle.resume();
+            return !handle.done();
+        }
+
+        /// Provides the actual frame
+        const MadFrameView &value() const {
+            return handle.promise().view;
+        }
+
+        iterator begin(){
+            return iterator(next() ? this : nullptr);
+        }
+
+        iterator end(){
+            return iterator(nullptr);
+        }
+
+    protected:
+        std::coroutine_handle<promise_type> handle;
+
+        MadFrameGenerator(std::coroutine_handle<promise_type> h) : handle(h) {}
+};
+
+/**
+ * @brief Source which provides a memory range to decodeFrames()
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadMemorySource {
+    public:
+        MadMemorySource(const void *data, size_t len){
+            p_data = (const uint8_t*) data;
+            size = len;
+        }
+
+        /// Copies the next data: returns 0 if no data is available at the moment
+        size_t read(uint8_t *data, size_t len){
+            size_t result = min(len, size - pos);
+            memcpy(data, p_data + pos, result);
+            pos += result;
+            return result;
+        }
+
+        /// Returns true if all data has been provided
+        bool isEnd(){
+            return pos >= size;
+        }
+
+    protected:
+        const uint8_t *p_data;
+        size_t size;
+        size_t pos = 0;
+};
+
+/// Releases the libmad state when the generator is destroyed
+struct MadFrameGeneratorState {
+    struct mad_stream stream;
+    struct mad_frame frame;
+    struct mad_synth synth;
+
+    MadFrameGeneratorState(int options){
+        mad_stream_init(&stream);
+        mad_frame_init(&frame);
+        mad_synth_init(&synth);
+        mad_stream_options(&stream, options);
+    }
+
+    ~MadFrameGeneratorState(){
+        mad_synth_finish(&synth);
+        mad_frame_finish(&frame);
+        mad_stream_finish(&stream);
+    }
+};
+
+/**
+ * @brief Decodes the data of the source lazily: the generator provides a view on each decoded
+ * frame and suspends with a waiting view (see MadFrameView::isWaiting()) if the source has no
+ * data at the moment. So many streams can be processed by a few threads by just calling next()
+ * on the generators in turn. The source must provide size_t read(uint8_t *data, size_t len) and
+ * bool isEnd(). All memory is allocated when the generator is created (and by libmad for the
+ * first Layer III frame): the source must be valid as long as the generator is used.
+ */
+template <class Source>
+MadFrameGenerator decodeFrames(Source &source, int options = 0){
+    MadFrameGeneratorState state(options);
+    struct mad_stream &stream = state.stream;
+    uint8_t buffer[MAD_FRAME_GENERATOR_BUFFER_SIZE];
+    bool is_end = false;
+    mad_timer_t timestamp = mad_timer_zero;
+    size_t index = 0;
+
+    while (true){
+        // decode all complete frames
+        if (stream.buffer != nullptr){
+            while (true){
+                if (mad_frame_decode(&state.frame, &stream) == -1){
+                    if (MAD_RECOVERABLE(stream.error)) continue;
+                    // MAD_ERROR_BUFLEN: we need more data
+                    break;
+                }
+                // in granule mode we provide each granule separately: a damaged granule is muted
+                do {
+                    mad_synth_frame(&state.synth, &state.frame);
+                    co_yield MadFrameView{&state.frame.header, &state.synth.pcm, timestamp, index};
+                    mad_timer_t duration;
+                    mad_timer_set(&duration, 0, state.synth.pcm.length, state.synth.pcm.samplerate);
+                    mad_timer_add(&timestamp, duration);
+                } while (mad_frame_decode_granule(&state.frame, &stream) == 1);
+                index++;
+            }
+        }
+        if (is_end) break;
+
+        // keep the data which was not decoded yet and request more data
+        size_t keep = 0;
+        if (stream.buffer != nullptr){
+            keep = stream.bufend - stream.next_frame;
+            if (keep >= sizeof(buffer)) keep = 0;
+            memmove(buffer, stream.next_frame, keep);
+        }
+        size_t len = 0;
+        while ((len = source.read(buffer + keep, sizeof(buffer) - keep)) == 0){
+            if (source.isEnd()){
+                // the guard makes sure that the last frame is decoded as well
+                is_end = true;
+                len = min((size_t) MAD_BUFFER_GUARD, sizeof(buffer) - keep);
+                memset(buffer + keep, 0, len);
+                break;
+            }
+            co_yield MadFrameView{nullptr, nullptr, timestamp, index};
+        }
+        mad_stream_buffer(&stream, buffer, keep + len);
+    }
+}
+
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "MP3DecoderMAD.h"
+#include <vector>
+
+namespace libmad {
+
+/**
+ * @brief Position and Layer III reservoir information of a single frame
+ * in the encoded data
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct MadFrameIndex {
+    size_t offset = 0;            // start of the frame in the data
+    uint16_t main_data_begin = 0; // Layer III bytes taken from previous frames
+    uint16_t payload = 0;         // Layer III bytes after header and side info
+};
+
+/**
+ * @brief Frame boundaries of mp3 data which is available in memory: this allows to
+ * start the decoding at any frame. The decoding must start a few warm-up frames early,
+ * so that the Layer III bit reservoir (main_data), the IMDCT overlap and the synthesis
+ * filter are rebuilt before the requested frame (see warmupStart()).
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadFrameTable {
+
+    public:
+
+        /// Determines all frame boundaries with the help of mad_header_decode
+        void build(const uint8_t *data, size_t len){
+            frames.clear();
+            struct mad_stream stream;
+            struct mad_header header;
+            mad_stream_init(&stream);
+            mad_header_init(&header);
+            mad_stream_buffer(&stream, data, len);
+            while(true){
+                if (mad_header_decode(&header, &stream)==-1){
+                    if (MAD_RECOVERABLE(stream.error)) continue;
+                    break;
+                }
+                MadFrameIndex idx;
+                idx.offset = stream.this_frame - data;
+                if (header.layer == MAD_LAYER_III){
+                    readReservoirInfo(header, stream.this_frame, stream.next_frame - stream.this_frame, idx);
+                }
+                frames.push_back(idx);
+            }
+            mad_header_finish(&header);
+            mad_stream_finish(&stream);
+        }
+
+        /// Determines the first frame which needs to be decoded to get exact results for the frame
+        size_t warmupStart(size_t first, size_t warmupFrames){
+            if (first==0) return 0;
+            // IMDCT overlap and synthesis filter need the previous 2 frames
+            size_t start = first > warmupFrames ? first - warmupFrames : 0;
+            // the bit reservoir of the start frame is filled by the preceding frames
+            long open = frames[start].main_data_begin;
+            while (open > 0 && start > 0){
+                start--;
+                open -= frames[start].payload;
+            }
+            return start;
+        }
+
+        /// Provides all frames
+        std::vector<MadFrameIndex> &index(){
+            return frames;
+        }
+
+        MadFrameIndex &operator[](size_t idx){
+            return frames[idx];
+        }
+
+        size_t size(){
+            return frames.size();
+        }
+
+        bool empty(){
+            return frames.empty();
+        }
+
+        void clear(){
+            frames.clear();
+        }
+
+    protected:
+        std::vector<MadFrameIndex> frames;
+
+        /// Determines the main_data_begin and the main data size of a Layer III frame
+        void readReservoirInfo(struct mad_header &header, const uint8_t *frame, size_t frame_len, MadFrameIndex &idx){
+            bool lsf = header.flags & MAD_FLAG_LSF_EXT;
+            size_t nch = MAD_NCHANNELS(&header);
+            size_t si_len = lsf ? (nch == 1 ? 9 : 17) : (nch == 1 ? 17 : 32);
+            size_t pos = (header.flags & MAD_FLAG_PROTECTION) ? 6 : 4;
+            if (pos + si_len > frame_len) return;
+            // main_data_begin: 9 bits for MPEG-1, 8 bits for the LSF extension
+            idx.main_data_begin = lsf ? frame[pos] : ((frame[pos] << 1) | (frame[pos+1] >> 7));
+            idx.payload = frame_len - pos - si_len;
+        }
+
+};
+
+}
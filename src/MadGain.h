@@ -0,0 +1,190 @@
+#pragma once
+
+#include "libmad/mad.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+namespace libmad {
+
+/// Biggest gain which can be represented in the libmad fixed point format
+#define MAD_GAIN_MAX 7.99f
+
+/**
+ * @brief Gain in the libmad fixed point format which is applied in the conversion of the decoded
+ * samples, so that no separate pass over the result is needed and the clipping happens only after
+ * the gain. Changes are ramped linearly over the indicated number of samples (per channel) to
+ * avoid clicks.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadGain {
+
+    public:
+
+        /// Defines the new linear gain (0 to MAD_GAIN_MAX) which is reached after the indicated number of samples
+        void set(float gain, size_t rampSamples=0){
+            if (gain < 0.0f) gain = 0.0f;
+            if (gain > MAD_GAIN_MAX) gain = MAD_GAIN_MAX;
+            target = mad_f_tofixed(gain);
+            steps = rampSamples;
+            if (steps == 0 || target == current){
+                current = target;
+                step = 0;
+                steps = 0;
+            } else {
+                step = (target - current) / (mad_fixed_t) steps;
+            }
+        }
+
+        /// Provides the (target) gain
+        float value(){
+            return mad_f_todouble(target);
+        }
+
+        /// Returns true if the samples are not changed: the conversion can skip the gain
+        bool isUnity(){
+            return current == MAD_F_ONE && steps == 0;
+        }
+
+        /// Returns true while the gain is ramped
+        bool isRamping(){
+            return steps > 0;
+        }
+
+        /// Provides the gain for the next sample (of all channels)
+        mad_fixed_t next(){
+            if (steps > 0){
+                current = --steps == 0 ? target : current + step;
+            }
+            return current;
+        }
+
+        /// Multiplies the sample with the gain: unlike mad_f_mul() with FPM_DEFAULT we keep the full precision
+        static mad_fixed_t mul(mad_fixed_t sample, mad_fixed_t gain){
+            return (mad_fixed_t) (((int64_t) sample * gain) >> MAD_F_FRACBITS);
+        }
+
+        /// Applies the gain to the samples of a mad_pcm frame
+        void apply(struct mad_pcm *pcm){
+            for (unsigned j=0; j<pcm->length; j++){
+                mad_fixed_t gain = next();
+                for (unsigned ch=0; ch<pcm->channels; ch++){
+                    pcm->samples[ch][j] = mul(pcm->samples[ch][j], gain);
+                }
+            }
+        }
+
+    protected:
+        mad_fixed_t current = MAD_F_ONE;
+        mad_fixed_t target = MAD_F_ONE;
+        mad_fixed_t step = 0;
+        size_t steps = 0;
+};
+
+/**
+ * @brief Reads the ReplayGain (in dB) of a track from the LAME tag in the first (Xing/Info) frame
+ * or from the REPLAYGAIN_TRACK_GAIN (TXXX) frame of an ID3v2 tag at the start of the mp3 data.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadReplayGain {
+
+    public:
+
+        /// Reads the Radio (track) Replay Gain from the LAME tag of the indicated frame
+        static bool readLAME(const uint8_t *frame, size_t len, float &db){
+            if (len < 4 || frame[0] != 0xff || (frame[1] & 0xe0) != 0xe0) return false;
+            bool lsf = (frame[1] & 0x08) == 0;
+            bool mono = (frame[3] & 0xc0) == 0xc0;
+            // the Xing header follows the side info
+            size_t pos = 4 + (lsf ? (mono ? 9 : 17) : (mono ? 17 : 32));
+            if (pos + 8 > len) return false;
+            if (memcmp(frame + pos, "Xing", 4) != 0 && memcmp(frame + pos, "Info", 4) != 0) return false;
+            uint32_t flags = readUInt32(frame + pos + 4);
+            pos += 8;
+            if (flags & 0x1) pos += 4;      // frames
+            if (flags & 0x2) pos += 4;      // bytes
+            if (flags & 0x4) pos += 100;    // toc
+            if (flags & 0x8) pos += 4;      // quality
+            // LAME extension: encoder (9), revision (1), lowpass (1), peak (4), radio replay gain (2)
+            if (pos + 17 > len || memcmp(frame + pos, "LAME", 4) != 0) return false;
+            return readGainField((frame[pos + 15] << 8) | frame[pos + 16], 1, db);
+        }
+
+        /// Reads the REPLAYGAIN_TRACK_GAIN from an ID3v2.3 or ID3v2.4 tag at the start of the data
+        static bool readID3(const uint8_t *data, size_t len, float &db){
+            if (len < 10 || memcmp(data, "ID3", 3) != 0) return false;
+            int version = data[3];
+            if (version < 3 || version > 4) return false;
+            size_t end = 10 + readSynchsafe(data + 6);
+            if (end > len) end = len;
+            size_t pos = 10;
+            if (data[5] & 0x40){
+                // extended header
+                if (pos + 4 > end) return false;
+                pos += version == 4 ? readSynchsafe(data + pos) : readUInt32(data + pos) + 4;
+            }
+            while (pos + 10 <= end && data[pos] != 0){
+                size_t size = version == 4 ? readSynchsafe(data + pos + 4) : readUInt32(data + pos + 4);
+                const uint8_t *content = data + pos + 10;
+                pos += 10 + size;
+                if (pos > end) break;
+                if (memcmp(content - 10, "TXXX", 4) == 0 && readTXXX(content, size, db)) return true;
+            }
+            return false;
+        }
+
+        /// Tries the ID3v2 tag at the start of the data and the LAME tag of the first frame
+        static bool read(const uint8_t *data, size_t len, float &db){
+            if (readID3(data, len, db)) return true;
+            // the first frame follows the ID3v2 tag
+            size_t pos = 0;
+            if (len >= 10 && memcmp(data, "ID3", 3) == 0){
+                pos = 10 + readSynchsafe(data + 6) + ((data[5] & 0x10) ? 10 : 0);
+            }
+            while (pos + 1 < len && !(data[pos] == 0xff && (data[pos + 1] & 0xe0) == 0xe0)) pos++;
+            return pos < len && readLAME(data + pos, len - pos, db);
+        }
+
+    protected:
+        static uint32_t readUInt32(const uint8_t *data){
+            return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+        }
+
+        static uint32_t readSynchsafe(const uint8_t *data){
+            return ((uint32_t)(data[0] & 0x7f) << 21) | ((data[1] & 0x7f) << 14) | ((data[2] & 0x7f) << 7) | (data[3] & 0x7f);
+        }
+
+        /// Decodes a ReplayGain field: name code (3 bits), originator (3 bits), sign (1 bit), gain in 0.1 dB (9 bits)
+        static bool readGainField(int field, int name, float &db){
+            if ((field >> 13) != name) return false;
+            int value = field & 0x1ff;
+            db = (field & 0x200 ? -value : value) / 10.0f;
+            return true;
+        }
+
+        /// Reads the value of a Latin-1 or UTF-8 user defined text frame with the description REPLAYGAIN_TRACK_GAIN
+        static bool readTXXX(const uint8_t *content, size_t size, float &db){
+            const char *key = "REPLAYGAIN_TRACK_GAIN";
+            size_t key_len = strlen(key);
+            if (size < key_len + 3 || (content[0] != 0 && content[0] != 3)) return false;
+            for (size_t j=0; j<key_len; j++){
+                if (toupper(content[1 + j]) != key[j]) return false;
+            }
+            if (content[1 + key_len] != 0) return false;
+            // the value is e.g. "-6.54 dB"
+            char value[16] = {0};
+            size_t value_len = size - key_len - 2;
+            memcpy(value, content + key_len + 2, value_len < sizeof(value) - 1 ? value_len : sizeof(value) - 1);
+            char *end = nullptr;
+            db = strtof(value, &end);
+            return end != value;
+        }
+};
+
+}
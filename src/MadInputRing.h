@@ -0,0 +1,129 @@
+#pragma once
+
+#include "MP3DecoderMAD.h"
+#include <atomic>
+
+namespace libmad {
+
+#ifndef MAD_CACHE_LINE_SIZE
+#define MAD_CACHE_LINE_SIZE 64
+#endif
+
+#ifndef MAD_INPUT_RING_SIZE
+#define MAD_INPUT_RING_SIZE (16 * 1024)
+#endif
+
+/// Max frame size (Layer II LSF 160 kbps at 8 kHz) + guard
+#ifndef MAD_INPUT_RING_MIRROR_SIZE
+#define MAD_INPUT_RING_MIRROR_SIZE (2881 + MAD_BUFFER_GUARD)
+#endif
+
+/**
+ * @brief Lock-free single-producer/single-consumer ring buffer for the encoded mp3 data:
+ * e.g. a network thread is writing the data and the decoder thread is decoding it.
+ *
+ * The beginning of the ring is mirrored after its end, so that a frame which wraps around
+ * can still be read as one contiguous region and we can pass the data directly to
+ * mad_stream_buffer() w/o copying. The read and write positions are placed in separate
+ * cache lines to avoid false sharing between the two threads.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadInputRing {
+
+    public:
+
+        MadInputRing(size_t size=MAD_INPUT_RING_SIZE, size_t mirrorSize=MAD_INPUT_RING_MIRROR_SIZE){
+            mirror_size = mirrorSize;
+            capacity = size > mirror_size ? size : mirror_size;
+            data = new uint8_t[capacity + mirror_size];
+        }
+
+        ~MadInputRing(){
+            delete [] data;
+        }
+
+        MadInputRing(const MadInputRing&) = delete;
+        MadInputRing& operator=(const MadInputRing&) = delete;
+
+        /// Producer: adds the data to the ring; returns the number of bytes which could be written
+        size_t write(const void *in_ptr, size_t in_size){
+            const uint8_t *in = (const uint8_t*) in_ptr;
+            size_t head = write_pos.load(std::memory_order_relaxed);
+            size_t free = capacity - (head - producer_read_pos);
+            if (free < in_size){
+                // refresh the cached read position
+                producer_read_pos = read_pos.load(std::memory_order_acquire);
+                free = capacity - (head - producer_read_pos);
+            }
+            size_t len = min(in_size, free);
+            size_t pos = head % capacity;
+            size_t len1 = min(len, capacity - pos);
+            memcpy(data + pos, in, len1);
+            memcpy(data, in + len1, len - len1);
+            updateMirror(pos, in, len1);
+            updateMirror(0, in + len1, len - len1);
+            write_pos.store(head + len, std::memory_order_release);
+            return len;
+        }
+
+        /// Producer: number of bytes which can be written
+        size_t availableForWrite(){
+            return capacity - (write_pos.load(std::memory_order_relaxed) - read_pos.load(std::memory_order_acquire));
+        }
+
+        /// Consumer: provides the next contiguous region of data: returns its length
+        size_t peek(const uint8_t *&ptr){
+            size_t tail = read_pos.load(std::memory_order_relaxed);
+            size_t head = write_pos.load(std::memory_order_acquire);
+            size_t pos = tail % capacity;
+            ptr = data + pos;
+            return min(head - tail, capacity + mirror_size - pos);
+        }
+
+        /// Consumer: releases the indicated number of bytes after a peek()
+        void consume(size_t len){
+            read_pos.store(read_pos.load(std::memory_order_relaxed) + len, std::memory_order_release);
+        }
+
+        /// Consumer: number of bytes which are available for reading
+        size_t available(){
+            return write_pos.load(std::memory_order_acquire) - read_pos.load(std::memory_order_relaxed);
+        }
+
+        /// Consumer: decodes all complete frames which are available
+        size_t decode(MP3DecoderMAD &mp3){
+            const uint8_t *ptr;
+            size_t len = peek(ptr);
+            size_t result = mp3.decodeFrames(ptr, len);
+            consume(result);
+            return result;
+        }
+
+        /// Total size of the ring
+        size_t size(){
+            return capacity;
+        }
+
+    protected:
+        // written by the producer
+        alignas(MAD_CACHE_LINE_SIZE) std::atomic<size_t> write_pos{0};
+        size_t producer_read_pos = 0;
+        // written by the consumer
+        alignas(MAD_CACHE_LINE_SIZE) std::atomic<size_t> read_pos{0};
+        // read only
+        alignas(MAD_CACHE_LINE_SIZE) uint8_t *data = nullptr;
+        size_t capacity = 0;
+        size_t mirror_size = 0;
+
+        /// copies the data which was written at the beginning of the ring also after its end
+        void updateMirror(size_t pos, const uint8_t *in, size_t len){
+            if (pos < mirror_size && len > 0){
+                memcpy(data + capacity + pos, in, min(len, mirror_size - pos));
+            }
+        }
+
+};
+
+}
@@ -0,0 +1,310 @@
+#pragma once
+
+#include "libmad/mad.h"
+#include "MadRateConverter.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+namespace libmad {
+
+#ifndef MAD_LOUDNESS_MIN
+/// Lowest reported loudness in LUFS: this is also the absolute gate of the integrated loudness
+#define MAD_LOUDNESS_MIN -70.0f
+#endif
+
+#ifndef MAD_LOUDNESS_MAX
+/// Highest loudness in LUFS which is resolved by the histogram of the integrated loudness
+#define MAD_LOUDNESS_MAX 5.0f
+#endif
+
+/**
+ * @brief Loudness according to EBU R128 (ITU-R BS.1770) and the peaks of the measured signal.
+ * Loudness values are in LUFS and are never lower than MAD_LOUDNESS_MIN. The peaks are linear with
+ * 1.0 for full scale.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct MadLoudness {
+    float momentary = MAD_LOUDNESS_MIN;     // last 400 ms
+    float short_term = MAD_LOUDNESS_MIN;    // last 3 s
+    float integrated = MAD_LOUDNESS_MIN;    // gated loudness since begin()
+    float sample_peak = 0.0f;               // biggest absolute sample
+    float true_peak = 0.0f;                 // biggest absolute value of the oversampled signal
+    size_t frames = 0;                      // measured samples per channel
+
+    /// Sample peak in dBFS
+    float samplePeakDb() const {
+        return toDb(sample_peak);
+    }
+
+    /// True peak in dBTP
+    float truePeakDb() const {
+        return toDb(true_peak);
+    }
+
+    /// Gain in dB which brings the integrated loudness to the indicated target (e.g. -23 LUFS for EBU R128)
+    float gainDb(float targetLufs = -23.0f) const {
+        return targetLufs - integrated;
+    }
+
+    /// Writes the values as JSON into the buffer: returns the length like snprintf()
+    int toJson(char *buffer, size_t len) const {
+        return snprintf(buffer, len, "{\"momentary\":%.2f,\"short_term\":%.2f,\"integrated\":%.2f,"
+            "\"sample_peak\":%.2f,\"true_peak\":%.2f,\"frames\":%zu}", momentary, short_term, integrated,
+            samplePeakDb(), truePeakDb(), frames);
+    }
+
+    protected:
+        static float toDb(float value){
+            return value > 0.0f ? 20.0f * log10f(value) : -120.0f;
+        }
+};
+
+/**
+ * @brief Streaming loudness meter (EBU R128 / ITU-R BS.1770) which measures the decoded samples in
+ * the libmad fixed point format while they are produced, so that the result is available after a
+ * single decoding pass. The samples are K-weighted with two biquads per channel and the mean square
+ * is collected in blocks of 100 ms: the momentary loudness uses the last 4 blocks and the short-term
+ * loudness the last 30 blocks. The integrated loudness is gated (-70 LUFS absolute, -10 LU relative)
+ * with a histogram of the 400 ms blocks in steps of 0.1 LU which keeps the number and the sum of the
+ * mean squares per step, so that the memory does not grow with the length of the stream. The true
+ * peak is determined on the signal which is 4 times (2 times from 96 kHz) oversampled with the
+ * MadRateConverter: the oversampled values are only calculated where the input is high enough to
+ * exceed the actual true peak. Use it with MP3DecoderMAD::setLoudnessMeter() or call write() with
+ * the synthesized samples.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadLoudnessMeter {
+
+    public:
+
+        MadLoudnessMeter(){
+            begin();
+        }
+
+        /// Resets all measurements e.g. for a new stream
+        void begin(){
+            memset(histogram, 0, sizeof(histogram));
+            memset(histogram_sum, 0, sizeof(histogram_sum));
+            result = MadLoudness();
+            peak = 0;
+            oversampled_peak = 0;
+            peak_limit = 0;
+            sample_rate = 0;
+            channels = 0;
+        }
+
+        /// Defines the allocator for the true peak filter (e.g. of a MadMemoryArena) and reserves the memory: nullptr uses the heap
+        bool setMemory(struct mad_memory const *memory){
+            oversampling.setMemory(memory);
+            // the filter is recalculated with the next samples
+            channels = 0;
+            return memory == nullptr || oversampling.allocate(4, 1);
+        }
+
+        /// Memory in bytes which is needed by setMemory(): each block is aligned to the indicated number of bytes
+        static size_t requiredMemory(size_t alignment){
+            return MadRateConverter::requiredMemory(4, 1, alignment);
+        }
+
+        /// Activates or deactivates the (more expensive) measurement of the true peak
+        void setTruePeak(bool active){
+            is_true_peak = active;
+            channels = 0;
+        }
+
+        /// Measures the samples of a synthesized frame
+        void write(struct mad_pcm const *pcm){
+            write(pcm->samples[0], pcm->samples[pcm->channels - 1], pcm->length, pcm->samplerate, pcm->channels);
+        }
+
+        /// Measures len samples of 1 or 2 channels: the right channel is ignored for mono
+        void write(const mad_fixed_t *left, const mad_fixed_t *right, unsigned len, int sampleRate, int channelCount){
+            if (len == 0 || sampleRate <= 0 || channelCount <= 0) return;
+            if (sampleRate != sample_rate || channelCount != channels){
+                setup(sampleRate, channelCount);
+            }
+            const mad_fixed_t *samples[2] = {left, right};
+            mad_fixed_t out[2];
+            for (unsigned j=0; j<len; j++){
+                mad_fixed_t frame_peak = 0;
+                for (int ch=0; ch<channels; ch++){
+                    mad_fixed_t sample = samples[ch][j];
+                    mad_fixed_t abs_sample = sample < 0 ? -sample : sample;
+                    if (abs_sample > frame_peak) frame_peak = abs_sample;
+                    block_sum += kWeighting(filter[ch], sample * (1.0f / MAD_F_ONE));
+                }
+                if (is_true_peak){
+                    oversampling.write(left[j], right[j]);
+                    if (frame_peak > peak_limit){
+                        peak_frames = oversampling.inputFrames();
+                    }
+                    if (peak_frames > 0){
+                        peak_frames--;
+                        while (!oversampling.isInputNeeded()){
+                            oversampling.read(out);
+                            for (int ch=0; ch<channels; ch++){
+                                mad_fixed_t abs_sample = out[ch] < 0 ? -out[ch] : out[ch];
+                                if (abs_sample > oversampled_peak){
+                                    oversampled_peak = abs_sample;
+                                    peak_limit = (mad_fixed_t) (oversampled_peak / oversampling.maxGain());
+                                }
+                            }
+                        }
+                    } else {
+                        // the last input frames can not exceed the actual true peak
+                        while (!oversampling.isInputNeeded()) oversampling.skip();
+                    }
+                }
+                if (frame_peak > peak) peak = frame_peak;
+                if (++block_pos >= block_len){
+                    endBlock();
+                }
+            }
+            result.frames += len;
+        }
+
+        /// Provides the actual loudness and peaks
+        MadLoudness loudness(){
+            result.sample_peak = mad_f_todouble(peak);
+            result.true_peak = mad_f_todouble(oversampled_peak > peak ? oversampled_peak : peak);
+            result.integrated = integrated();
+            return result;
+        }
+
+    protected:
+        static const int bins = (int) ((MAD_LOUDNESS_MAX - MAD_LOUDNESS_MIN) * 10);
+        static const int short_term_blocks = 30;
+        uint32_t histogram[bins];       // number of 400 ms blocks per 0.1 LU
+        float histogram_sum[bins];      // sum of the mean squares of the blocks per 0.1 LU
+        float blocks[short_term_blocks];    // mean square of the last 100 ms blocks
+        int block_count = 0;            // available entries in blocks
+        int block_idx = 0;              // next entry in blocks
+        int block_len = 0;              // samples per 100 ms
+        int block_pos = 0;
+        float block_sum = 0;
+        struct Biquad {
+            float b0, b1, b2, a1, a2;
+        } stages[2];                    // K-weighting: high shelf and high pass
+        float filter[2][4];             // state of the biquads per channel
+        MadRateConverter oversampling;
+        bool is_true_peak = true;
+        mad_fixed_t peak = 0;
+        mad_fixed_t oversampled_peak = 0;
+        mad_fixed_t peak_limit = 0;     // input samples above this limit can exceed the oversampled peak
+        int peak_frames = 0;            // remaining input frames for which we need the oversampled values
+        int sample_rate = 0;
+        int channels = 0;
+        MadLoudness result;
+
+        /// Calculates the filters for a new format: the integrated loudness and the peaks are kept
+        void setup(int sampleRate, int channelCount){
+            channels = channelCount > 2 ? 2 : channelCount;
+            if (is_true_peak){
+                int rate = sampleRate * (sampleRate < 96000 ? 4 : 2);
+                if (rate != oversampling.sampleRate()) oversampling.setOutput(rate, 0);
+                oversampling.begin(sampleRate, channels);
+                peak_limit = (mad_fixed_t) (oversampled_peak / oversampling.maxGain());
+                peak_frames = 0;
+            }
+            // a change of the channels keeps the blocks
+            if (sampleRate == sample_rate) return;
+            sample_rate = sampleRate;
+            block_len = sample_rate / 10;
+            block_pos = 0;
+            block_sum = 0;
+            block_count = 0;
+            block_idx = 0;
+            memset(filter, 0, sizeof(filter));
+            // ITU-R BS.1770 pre-filter (high shelf) and RLB filter (high pass) for the actual sample rate
+            double k = tan(M_PI * 1681.974450955533 / sample_rate);
+            double q = 0.7071752369554196;
+            double vh = pow(10.0, 3.999843853973347 / 20.0);
+            double vb = pow(vh, 0.4996667741545416);
+            double a0 = 1.0 + k / q + k * k;
+            stages[0] = {(float) ((vh + vb * k / q + k * k) / a0), (float) (2.0 * (k * k - vh) / a0),
+                (float) ((vh - vb * k / q + k * k) / a0), (float) (2.0 * (k * k - 1.0) / a0), (float) ((1.0 - k / q + k * k) / a0)};
+            k = tan(M_PI * 38.13547087602444 / sample_rate);
+            q = 0.5003270373238773;
+            a0 = 1.0 + k / q + k * k;
+            stages[1] = {1.0f, -2.0f, 1.0f, (float) (2.0 * (k * k - 1.0) / a0), (float) ((1.0 - k / q + k * k) / a0)};
+        }
+
+        /// Filters the sample with both biquads (transposed direct form II): returns the square of the result
+        float kWeighting(float *state, float x){
+            for (int j=0; j<2; j++){
+                Biquad &b = stages[j];
+                float y = b.b0 * x + state[2 * j];
+                state[2 * j] = b.b1 * x - b.a1 * y + state[2 * j + 1];
+                state[2 * j + 1] = b.b2 * x - b.a2 * y;
+                x = y;
+            }
+            return x * x;
+        }
+
+        static float toLufs(double meanSquare){
+            return meanSquare > 0 ? -0.691f + 10.0f * (float) log10(meanSquare) : MAD_LOUDNESS_MIN;
+        }
+
+        static float limit(float lufs){
+            return lufs < MAD_LOUDNESS_MIN ? MAD_LOUDNESS_MIN : lufs;
+        }
+
+        /// Mean square (summed over the channels) of the last blocks
+        double meanSquare(int count){
+            double sum = 0;
+            for (int j=1; j<=count; j++){
+                sum += blocks[(block_idx - j + short_term_blocks) % short_term_blocks];
+            }
+            return sum / count;
+        }
+
+        /// Closes a 100 ms block: updates the momentary and short-term loudness and adds the 400 ms block to the histogram
+        void endBlock(){
+            blocks[block_idx] = block_sum / block_len;
+            block_idx = (block_idx + 1) % short_term_blocks;
+            if (block_count < short_term_blocks) block_count++;
+            block_pos = 0;
+            block_sum = 0;
+            result.short_term = limit(toLufs(meanSquare(block_count)));
+            if (block_count >= 4){
+                float momentary = toLufs(meanSquare(4));
+                result.momentary = limit(momentary);
+                // gating blocks of 400 ms overlap by 75%: the absolute gate drops all silent blocks
+                if (momentary >= MAD_LOUDNESS_MIN){
+                    int bin = (int) ((momentary - MAD_LOUDNESS_MIN) * 10.0f);
+                    if (bin >= bins) bin = bins - 1;
+                    histogram[bin]++;
+                    histogram_sum[bin] += meanSquare(4);
+                }
+            }
+        }
+
+        /// Integrated loudness of the blocks in the histogram which pass the relative gate
+        float integrated(){
+            double sum = 0;
+            uint32_t count = 0;
+            for (int j=0; j<bins; j++){
+                sum += histogram_sum[j];
+                count += histogram[j];
+            }
+            if (count == 0) return MAD_LOUDNESS_MIN;
+            float gate = toLufs(sum / count) - 10.0f;
+            int start = (int) ceilf((gate - MAD_LOUDNESS_MIN) * 10.0f);
+            if (start < 0) start = 0;
+            sum = 0;
+            count = 0;
+            for (int j=start; j<bins; j++){
+                sum += histogram_sum[j];
+                count += histogram[j];
+            }
+            return count > 0 ? limit(toLufs(sum / count)) : MAD_LOUDNESS_MIN;
+        }
+};
+
+}
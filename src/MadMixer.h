@@ -0,0 +1,311 @@
+#pragma once
+
+#include "MP3DecoderMAD.h"
+#include <vector>
+
+namespace libmad {
+
+#ifndef MAD_MIXER_FRAMES
+#define MAD_MIXER_FRAMES 256
+#endif
+
+#ifndef MAD_RESAMPLER_FRAMES
+#define MAD_RESAMPLER_FRAMES 64
+#endif
+
+/**
+ * @brief Hook which adapts the sample rate of a decoder for the MadMixer: the decoded data is
+ * requested with readPCM() from the decoder and the result is provided at the indicated sample
+ * rate with the channels of the decoder.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadResampler {
+    public:
+        virtual ~MadResampler() = default;
+        /// Provides the requested number of frames at the indicated sample rate: returns 0 at the end of the data
+        virtual size_t read(MP3DecoderMAD &decoder, mad_fixed_t *data, size_t frames, int sampleRate) = 0;
+        /// Resets the state for a new stream
+        virtual void reset() {}
+};
+
+/**
+ * @brief Resampler which interpolates linearly between two frames: use one instance per decoder.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadLinearResampler : public MadResampler {
+    public:
+        size_t read(MP3DecoderMAD &decoder, mad_fixed_t *data, size_t frames, int sampleRate) override {
+            if (in_len == 0 && !fill(decoder)) return 0;
+            int in_rate = decoder.audioInfo().sample_rate;
+            // same sample rate: we just copy the data
+            if (in_rate == sampleRate && pos == 0){
+                return copy(decoder, data, frames);
+            }
+            int64_t step = ((int64_t) in_rate << MAD_F_FRACBITS) / sampleRate;
+            size_t result = 0;
+            while (result < frames){
+                // we interpolate between in[in_pos] and in[in_pos+1]
+                while (pos >= MAD_F_ONE || in_pos + 1 >= in_len){
+                    if (in_pos + 1 >= in_len){
+                        if (fill(decoder)) continue;
+                        // end of the data: the last frame is held until its period is complete
+                        if (in_len == 0 || pos >= MAD_F_ONE) return result;
+                        break;
+                    }
+                    in_pos++;
+                    pos -= MAD_F_ONE;
+                }
+                mad_fixed_t *left = in + in_pos * channels;
+                mad_fixed_t *right = in_pos + 1 < in_len ? left + channels : left;
+                for (int ch=0; ch<channels; ch++){
+                    *data++ = left[ch] + mad_f_mul(right[ch] - left[ch], (mad_fixed_t) pos);
+                }
+                pos += step;
+                result++;
+            }
+            return result;
+        }
+
+        void reset() override {
+            in_len = 0;
+            in_pos = 0;
+            pos = 0;
+        }
+
+    protected:
+        mad_fixed_t in[(MAD_RESAMPLER_FRAMES + 1) * 2];
+        size_t in_len = 0;      // available frames in in
+        size_t in_pos = 0;      // left frame of the interpolation
+        int channels = 0;
+        int64_t pos = 0;        // position between in_pos and in_pos+1
+
+        /// Requests the next frames from the decoder: the last frame is kept
+        bool fill(MP3DecoderMAD &decoder){
+            size_t keep = 0;
+            if (in_len > 0){
+                memmove(in, in + (in_len - 1) * channels, channels * sizeof(mad_fixed_t));
+                in_pos -= in_len - 1;
+                keep = 1;
+            }
+            size_t len = decoder.readPCM(in + keep * channels, MAD_RESAMPLER_FRAMES);
+            if (len == 0){
+                in_len = keep;
+                return false;
+            }
+            if (decoder.audioInfo().channels != channels){
+                // we do not interpolate over a format change
+                if (keep > 0) memmove(in, in + channels, len * decoder.audioInfo().channels * sizeof(mad_fixed_t));
+                channels = decoder.audioInfo().channels;
+                keep = 0;
+                in_pos = 0;
+            }
+            in_len = keep + len;
+            return true;
+        }
+
+        /// Provides the remaining input or the decoded data
+        size_t copy(MP3DecoderMAD &decoder, mad_fixed_t *data, size_t frames){
+            if (in_pos < in_len){
+                size_t result = min(frames, in_len - in_pos);
+                memcpy(data, in + in_pos * channels, result * channels * sizeof(mad_fixed_t));
+                in_pos += result;
+                return result;
+            }
+            return decoder.readPCM(data, frames);
+        }
+};
+
+/**
+ * @brief Mixes the decoded data of several decoders: the data is requested with readPCM() from each
+ * decoder in the internal libmad format and summed up with the gain of the stream in fixed point.
+ * The result is clipped and converted only once at the end. Mono streams are copied to both
+ * channels and stereo streams are downmixed for a mono output. Streams with a different sample rate
+ * are adapted with a MadResampler: please note that the sum of all streams must stay below
+ * 8.0 (18 dB of headroom) to avoid an overflow before clipping.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadMixer {
+
+    public:
+
+        MadMixer(size_t maxFrames=MAD_MIXER_FRAMES){
+            max_frames = maxFrames > 0 ? maxFrames : 1;
+            mix_buffer.resize(max_frames * 2);
+            in_buffer.resize(max_frames * 2);
+            info.channels = 2;
+        }
+
+        /// Adds a decoder with a defined input source: returns the index of the stream
+        int add(MP3DecoderMAD &decoder, float gain=1.0f, MadResampler *resampler=nullptr){
+            Input input;
+            input.decoder = &decoder;
+            input.resampler = resampler;
+            streams.push_back(input);
+            int index = streams.size() - 1;
+            setGain(index, gain);
+            return index;
+        }
+
+        /// Defines the gain of the indicated stream
+        void setGain(int index, float gain){
+            streams[index].gain = mad_f_tofixed(gain);
+        }
+
+        /// Defines the sample rate and the number of channels (1 or 2) of the result: if the sample rate is 0 we use the rate of the first stream
+        void setAudioInfo(MadAudioInfo newInfo){
+            info = newInfo;
+            if (info.channels < 1 || info.channels > 2) info.channels = 2;
+        }
+
+        /// Provides the audio information of the result
+        MadAudioInfo audioInfo(){
+            return info;
+        }
+
+        /// Starts all decoders
+        void begin(){
+            for (auto &stream : streams){
+                stream.decoder->begin();
+                stream.is_active = true;
+                stream.is_rate_warning = false;
+                if (stream.resampler != nullptr) stream.resampler->reset();
+            }
+        }
+
+        /// Stops all decoders
+        void end(){
+            for (auto &stream : streams){
+                stream.decoder->end();
+                stream.is_active = false;
+            }
+        }
+
+        /// Provides the requested number of frames of the mixed streams as interleaved int16_t samples: returns less only at the end of all streams
+        size_t readPCM(int16_t *data, size_t frames){
+            return readSamples(data, frames);
+        }
+
+        /// Provides the requested number of frames of the mixed streams as interleaved float samples
+        size_t readPCM(float *data, size_t frames){
+            return readSamples(data, frames);
+        }
+
+        /// Returns true as long as at least one stream provides data
+        operator bool(){
+            for (auto &stream : streams){
+                if (stream.is_active) return true;
+            }
+            return false;
+        }
+
+    protected:
+        /// Decoder with its mixing parameters
+        struct Input {
+            MP3DecoderMAD *decoder = nullptr;
+            MadResampler *resampler = nullptr;
+            mad_fixed_t gain = MAD_F_ONE;
+            bool is_active = false;
+            bool is_rate_warning = false;
+        };
+        std::vector<Input> streams;
+        std::vector<mad_fixed_t> mix_buffer;
+        std::vector<mad_fixed_t> in_buffer;
+        size_t max_frames;
+        MadAudioInfo info;
+
+        static void convert(mad_fixed_t sample, int16_t &result){
+            result = MP3DecoderMAD::scale(sample);
+        }
+
+        static void convert(mad_fixed_t sample, float &result){
+            result = MP3DecoderMAD::scaleFloat(sample);
+        }
+
+        template <typename T>
+        size_t readSamples(T *data, size_t frames){
+            size_t result = 0;
+            while (result < frames){
+                size_t len = mix(min(frames - result, max_frames));
+                // clip and convert once
+                mad_fixed_t *mix_data = mix_buffer.data();
+                for (size_t j=0; j<len * info.channels; j++){
+                    convert(mix_data[j], *data++);
+                }
+                result += len;
+                if (len == 0) break;
+            }
+            return result;
+        }
+
+        /// Sums up max frames of all streams in mix_buffer: returns the number of frames of the longest stream
+        size_t mix(size_t frames){
+            mad_fixed_t *mix_data = mix_buffer.data();
+            memset(mix_data, 0, frames * info.channels * sizeof(mad_fixed_t));
+            size_t result = 0;
+            for (auto &stream : streams){
+                size_t pos = 0;
+                while (stream.is_active && pos < frames){
+                    size_t len = readStream(stream, in_buffer.data(), frames - pos);
+                    if (len == 0){
+                        stream.is_active = false;
+                        break;
+                    }
+                    accumulate(mix_data + pos * info.channels, in_buffer.data(), len, stream.decoder->audioInfo().channels, stream.gain);
+                    pos += len;
+                }
+                if (pos > result) result = pos;
+            }
+            return result;
+        }
+
+        size_t readStream(Input &stream, mad_fixed_t *data, size_t frames){
+            MP3DecoderMAD &decoder = *stream.decoder;
+            if (stream.resampler != nullptr && info.sample_rate > 0){
+                return stream.resampler->read(decoder, data, frames, info.sample_rate);
+            }
+            size_t result = decoder.readPCM(data, frames);
+            if (result > 0){
+                int rate = decoder.audioInfo().sample_rate;
+                if (info.sample_rate == 0){
+                    info.sample_rate = rate;
+                } else if (rate != info.sample_rate && !stream.is_rate_warning){
+                    LOG(Warning, "mixer: sample rate %d without resampler", rate);
+                    stream.is_rate_warning = true;
+                }
+            }
+            return result;
+        }
+
+        /// Adds the frames with the indicated gain to the result
+        void accumulate(mad_fixed_t *out, const mad_fixed_t *in, size_t frames, int channels, mad_fixed_t gain){
+            if (channels == info.channels){
+                size_t len = frames * channels;
+                if (gain == MAD_F_ONE){
+                    for (size_t j=0; j<len; j++) out[j] += in[j];
+                } else {
+                    for (size_t j=0; j<len; j++) out[j] += mad_f_mul(in[j], gain);
+                }
+            } else if (channels == 1){
+                // mono to stereo
+                for (size_t j=0; j<frames; j++){
+                    mad_fixed_t sample = mad_f_mul(in[j], gain);
+                    out[2*j] += sample;
+                    out[2*j+1] += sample;
+                }
+            } else {
+                // stereo to mono
+                for (size_t j=0; j<frames; j++){
+                    out[j] += mad_f_mul((in[2*j] >> 1) + (in[2*j+1] >> 1), gain);
+                }
+            }
+        }
+
+};
+
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "MP3DecoderMAD.h"
+#include <atomic>
+
+namespace libmad {
+
+#ifndef MAD_CACHE_LINE_SIZE
+#define MAD_CACHE_LINE_SIZE 64
+#endif
+
+#ifndef MAD_PCM_QUEUE_BLOCKS
+#define MAD_PCM_QUEUE_BLOCKS 8
+#endif
+
+/**
+ * @brief Lock-free single-producer/single-consumer queue of decoded frames: the decoder
+ * thread is writing the frames and e.g. a real time audio thread is reading a fixed
+ * number of samples. All memory is allocated in the constructor and read() is wait-free:
+ * if not enough data is available the result is filled up with silence (underrun). A result
+ * does not mix different audio formats: it ends at a format change, so that audioInfo() is
+ * valid for all samples of the result.
+ * If the queue is full the frame is dropped (overrun): use availableForWrite() to
+ * throttle the decoder.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadPCMQueue : public MadPCMOutput {
+
+    public:
+
+        MadPCMQueue(size_t blockCount=MAD_PCM_QUEUE_BLOCKS){
+            block_count = blockCount > 0 ? blockCount : 1;
+            blocks = new Block[block_count];
+        }
+
+        ~MadPCMQueue(){
+            delete [] blocks;
+        }
+
+        MadPCMQueue(const MadPCMQueue&) = delete;
+        MadPCMQueue& operator=(const MadPCMQueue&) = delete;
+
+        /// Producer: converts the frame to int16_t and adds it to the queue
+        void writeFrame(struct mad_header const *, struct mad_pcm *pcm) override {
+            Block *block = beginWrite();
+            if (block == nullptr) return;
+            block->info = MadAudioInfo(*pcm);
+            int16_t *out = block->samples;
+            for (int j=0; j<pcm->length; j++){
+                for (int ch=0; ch<pcm->channels; ch++){
+                    *out++ = MP3DecoderMAD::scale(pcm->samples[ch][j]);
+                }
+            }
+            block->len = out - block->samples;
+            commitWrite(block->len);
+        }
+
+        /// Producer: adds int16_t data with max 2 * 1152 samples to the queue
+        bool write(MadAudioInfo &info, const int16_t *data, size_t len){
+            if (len > MAD_PCM_QUEUE_BLOCK_SAMPLES) return false;
+            Block *block = beginWrite();
+            if (block == nullptr) return false;
+            block->info = info;
+            memcpy(block->samples, data, len * sizeof(int16_t));
+            block->len = len;
+            commitWrite(len);
+            return true;
+        }
+
+        /// Producer: number of frames which can be written w/o overrun
+        size_t availableForWrite(){
+            return block_count - (write_idx.load(std::memory_order_relaxed) - read_idx.load(std::memory_order_acquire));
+        }
+
+        /// Consumer: copies exactly len samples; missing data and the data after a format change are filled with 0. Returns the number of decoded samples
+        size_t read(int16_t *data, size_t len){
+            size_t result = 0;
+            size_t idx = read_idx.load(std::memory_order_relaxed);
+            while (result < len){
+                if (idx == write_idx.load(std::memory_order_acquire)){
+                    memset(data + result, 0, (len - result) * sizeof(int16_t));
+                    underrun_count.store(underrun_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    break;
+                }
+                Block &block = blocks[idx % block_count];
+                if (read_offset == 0 && block.info != read_info){
+                    // we do not mix different formats in one result
+                    if (result > 0){
+                        memset(data + result, 0, (len - result) * sizeof(int16_t));
+                        break;
+                    }
+                    read_info = block.info;
+                }
+                size_t copy_len = min(len - result, block.len - read_offset);
+                memcpy(data + result, block.samples + read_offset, copy_len * sizeof(int16_t));
+                result += copy_len;
+                read_offset += copy_len;
+                if (read_offset == block.len){
+                    read_offset = 0;
+                    read_idx.store(++idx, std::memory_order_release);
+                }
+            }
+            read_samples.store(read_samples.load(std::memory_order_relaxed) + result, std::memory_order_release);
+            return result;
+        }
+
+        /// Consumer: audio information of the data of the last read()
+        MadAudioInfo audioInfo(){
+            return read_info;
+        }
+
+        /// Number of samples which are available for reading
+        size_t available(){
+            return written_samples.load(std::memory_order_acquire) - read_samples.load(std::memory_order_acquire);
+        }
+
+        /// Number of frames in the queue
+        size_t frames(){
+            return write_idx.load(std::memory_order_acquire) - read_idx.load(std::memory_order_acquire);
+        }
+
+        /// Number of read() calls which could not be served completely
+        size_t underruns(){
+            return underrun_count.load(std::memory_order_relaxed);
+        }
+
+        /// Number of frames which were dropped because the queue was full
+        size_t overruns(){
+            return overrun_count.load(std::memory_order_relaxed);
+        }
+
+    protected:
+        static const size_t MAD_PCM_QUEUE_BLOCK_SAMPLES = 2 * 1152;
+
+        /// Decoded frame
+        struct Block {
+            MadAudioInfo info;
+            size_t len = 0;
+            int16_t samples[MAD_PCM_QUEUE_BLOCK_SAMPLES];
+        };
+
+        // written by the producer
+        alignas(MAD_CACHE_LINE_SIZE) std::atomic<size_t> write_idx{0};
+        std::atomic<size_t> written_samples{0};
+        std::atomic<size_t> overrun_count{0};
+        // written by the consumer
+        alignas(MAD_CACHE_LINE_SIZE) std::atomic<size_t> read_idx{0};
+        std::atomic<size_t> read_samples{0};
+        std::atomic<size_t> underrun_count{0};
+        size_t read_offset = 0;
+        MadAudioInfo read_info;
+        // read only
+        alignas(MAD_CACHE_LINE_SIZE) Block *blocks = nullptr;
+        size_t block_count = 0;
+
+        Block *beginWrite(){
+            size_t idx = write_idx.load(std::memory_order_relaxed);
+            if (idx - read_idx.load(std::memory_order_acquire) >= block_count){
+                overrun_count.store(overrun_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            return &blocks[idx % block_count];
+        }
+
+        void commitWrite(size_t len){
+            written_samples.store(written_samples.load(std::memory_order_relaxed) + len, std::memory_order_release);
+            write_idx.store(write_idx.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+};
+
+}
@@ -0,0 +1,262 @@
+#pragma once
+
+#include "MadFrameTable.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+
+namespace libmad {
+
+#ifndef MAD_PARALLEL_SEGMENT_FRAMES
+#define MAD_PARALLEL_SEGMENT_FRAMES 512
+#endif
+
+#ifndef MAD_PARALLEL_WARMUP_FRAMES
+#define MAD_PARALLEL_WARMUP_FRAMES 2
+#endif
+
+/**
+ * @brief Decodes a complete MP3 file which is available in memory with the help
+ * of multiple threads. The data is split into segments at frame boundaries which
+ * are decoded in parallel. Each segment starts a few warm-up frames early so that
+ * the Layer III bit reservoir (main_data), the IMDCT overlap and the synthesis
+ * filter are rebuilt before the first output frame: the PCM of the warm-up frames
+ * is discarded. The segments are reported in order via the data callback, so the
+ * result is sample identical to a sequential decoding of the same data.
+ *
+ * Please note that libmad must be compiled with MAD_STACK_HACK=0, otherwise the
+ * decoders in the different threads share some static working buffers!
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadParallelDecoder {
+
+    public:
+
+        MadParallelDecoder() = default;
+
+        MadParallelDecoder(MP3DataCallback dataCallback, MP3InfoCallback infoCB=nullptr){
+            setDataCallback(dataCallback);
+            setInfoCallback(infoCB);
+        }
+
+        /// Defines the callback which receives the decoded data in the original sequence
+        void setDataCallback(MP3DataCallback cb){
+            data_callback = cb;
+        }
+
+        /// Defines the callback which receives the Info changes
+        void setInfoCallback(MP3InfoCallback cb){
+            info_callback = cb;
+        }
+
+        /// Defines the number of decoding threads (0 = number of cores)
+        void setThreads(int count){
+            threads = count;
+        }
+
+        /// Defines the number of output frames per segment
+        void setSegmentFrames(size_t frames){
+            segment_frames = frames > 0 ? frames : 1;
+        }
+
+        /// Defines the minimum number of warm-up frames which are decoded before each segment
+        void setWarmupFrames(size_t frames){
+            warmup_frames = frames;
+        }
+
+        /// Decodes the mp3 data which must stay valid until the method returns. As with
+        /// mad_stream_buffer() the last frame is only decoded if it is followed by
+        /// MAD_BUFFER_GUARD bytes.
+        bool decode(const void *data, size_t len){
+            const uint8_t *data8 = (const uint8_t*) data;
+            if (data8==nullptr || len==0) return false;
+            frames.build(data8, len);
+            if (frames.empty()) return false;
+            splitSegments();
+            LOG(Info, "decode: %zu frames in %zu segments", frames.size(), segments.size());
+
+            int thread_count = threadCount();
+            next_segment = 0;
+            delivered = 0;
+            max_in_flight = thread_count * 2;
+            std::vector<std::thread> pool;
+            for (int j=0; j<thread_count; j++){
+                pool.emplace_back([this, data8, len](){ work(data8, len); });
+            }
+            deliver();
+            for (auto &t : pool){
+                t.join();
+            }
+            return true;
+        }
+
+        /// Provides the frame index of the last decode() call
+        std::vector<MadFrameIndex> &frameIndex(){
+            return frames.index();
+        }
+
+        /// Provides the last valid audio information
+        MadAudioInfo audioInfo(){
+            return mad_info;
+        }
+
+    protected:
+        /// Decoded PCM data of consecutive frames with the same audio info
+        struct Run {
+            MadAudioInfo info;
+            size_t start;
+            size_t len;
+        };
+
+        /// Output frames [first, end) and the decoded result
+        struct Segment {
+            size_t first = 0;
+            size_t end = 0;
+            bool ready = false;
+            std::vector<int16_t> pcm;
+            std::vector<Run> runs;
+        };
+
+        /// libmad decoder state which is used by a single thread
+        struct Context {
+            struct mad_stream stream;
+            struct mad_frame frame;
+            struct mad_synth synth;
+        };
+
+        MP3DataCallback data_callback = nullptr;
+        MP3InfoCallback info_callback = nullptr;
+        int threads = 0;
+        size_t segment_frames = MAD_PARALLEL_SEGMENT_FRAMES;
+        size_t warmup_frames = MAD_PARALLEL_WARMUP_FRAMES;
+        MadFrameTable frames;
+        std::vector<Segment> segments;
+        size_t next_segment = 0;
+        size_t delivered = 0;
+        size_t max_in_flight = 0;
+        std::mutex mtx;
+        std::condition_variable cond;
+        MadAudioInfo mad_info;
+
+        int threadCount(){
+            int result = threads;
+            if (result<=0) result = std::thread::hardware_concurrency();
+            return result > 0 ? result : 1;
+        }
+
+        void splitSegments(){
+            segments.clear();
+            for (size_t first=0; first<frames.size(); first+=segment_frames){
+                Segment seg;
+                seg.first = first;
+                seg.end = min(first + segment_frames, frames.size());
+                segments.push_back(std::move(seg));
+            }
+        }
+
+        /// Thread: decodes the next available segment
+        void work(const uint8_t *data, size_t len){
+            std::unique_ptr<Context> ctx(new Context());
+            while(true){
+                size_t idx;
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    cond.wait(lock, [this](){ return next_segment >= segments.size() || next_segment < delivered + max_in_flight; });
+                    if (next_segment >= segments.size()) break;
+                    idx = next_segment++;
+                }
+                decodeSegment(*ctx, segments[idx], data, len);
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    segments[idx].ready = true;
+                }
+                cond.notify_all();
+            }
+        }
+
+        /// Decodes the segment starting at the warm-up frame and drops the PCM of the warm-up frames
+        void decodeSegment(Context &ctx, Segment &seg, const uint8_t *data, size_t len){
+            size_t start = frames.warmupStart(seg.first, warmup_frames);
+            const uint8_t *output_start = data + frames[seg.first].offset;
+            const uint8_t *output_end = seg.end < frames.size() ? data + frames[seg.end].offset : data + len;
+
+            mad_stream_init(&ctx.stream);
+            mad_frame_init(&ctx.frame);
+            mad_synth_init(&ctx.synth);
+            mad_stream_buffer(&ctx.stream, data + frames[start].offset, len - frames[start].offset);
+
+            while(true){
+                if (mad_header_decode(&ctx.frame.header, &ctx.stream)==-1){
+                    if (MAD_RECOVERABLE(ctx.stream.error)) continue;
+                    break;
+                }
+                if (ctx.stream.this_frame >= output_end) break;
+                if (mad_frame_decode(&ctx.frame, &ctx.stream)==-1){
+                    if (MAD_RECOVERABLE(ctx.stream.error)) continue;
+                    break;
+                }
+                mad_synth_frame(&ctx.synth, &ctx.frame);
+                if (ctx.stream.this_frame >= output_start){
+                    append(seg, ctx.synth.pcm);
+                }
+            }
+
+            mad_synth_finish(&ctx.synth);
+            mad_frame_finish(&ctx.frame);
+            mad_stream_finish(&ctx.stream);
+        }
+
+        /// Converts the pcm data to int16_t and adds it to the segment result
+        void append(Segment &seg, struct mad_pcm &pcm){
+            MadAudioInfo info(pcm);
+            size_t len = pcm.length * pcm.channels;
+            if (seg.runs.empty() || seg.runs.back().info != info){
+                seg.runs.push_back(Run{info, seg.pcm.size(), 0});
+            }
+            size_t pos = seg.pcm.size();
+            seg.pcm.resize(pos + len);
+            int16_t *out = seg.pcm.data() + pos;
+            for (int j=0; j<pcm.length; j++){
+                for (int ch=0; ch<pcm.channels; ch++){
+                    *out++ = MP3DecoderMAD::scale(pcm.samples[ch][j]);
+                }
+            }
+            seg.runs.back().len += len;
+        }
+
+        /// Reports the decoded segments in sequence
+        void deliver(){
+            for (size_t j=0; j<segments.size(); j++){
+                Segment &seg = segments[j];
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    cond.wait(lock, [&seg](){ return seg.ready; });
+                }
+                for (Run &run : seg.runs){
+                    if (run.info != mad_info){
+                        if (info_callback!=nullptr){
+                            info_callback(run.info);
+                        }
+                        mad_info = run.info;
+                    }
+                    if (data_callback!=nullptr){
+                        data_callback(run.info, seg.pcm.data() + run.start, run.len);
+                    }
+                }
+                // release the memory
+                std::vector<int16_t>().swap(seg.pcm);
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    delivered = j + 1;
+                }
+                cond.notify_all();
+            }
+        }
+
+};
+
+}
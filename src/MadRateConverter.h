@@ -0,0 +1,341 @@
+#pragma once
+
+#include "libmad/mad.h"
+#include "mad_log.h"
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+namespace libmad {
+
+#ifndef MAD_RESAMPLE_TAPS
+/// Number of filter coefficients per phase (multiplied by the decimation factor for a lower output rate)
+#define MAD_RESAMPLE_TAPS 24
+#endif
+
+#ifndef MAD_RESAMPLE_MAX_PHASES
+/// Biggest supported interpolation factor: 11025 Hz to 48000 Hz needs 640 phases
+#define MAD_RESAMPLE_MAX_PHASES 1024
+#endif
+
+/**
+ * @brief Converts the decoded samples to a fixed sample rate and number of channels. The sample
+ * rates are converted with a polyphase FIR filter for the rational ratio of the two rates (e.g.
+ * 160/147 for 44100 Hz to 48000 Hz): the coefficients of each phase are stored contiguously in
+ * Q14 and the history of each channel is kept twice, so that each output sample is a single dot
+ * product over the taps which the compiler can vectorize. The table and the history are allocated
+ * on the heap when the ratio changes: with setMemory() and allocate() the memory for all mp3 sample
+ * rates is reserved in advance, so that begin() does not allocate. Stereo is downmixed before the
+ * filter and mono is duplicated after the filter. The samples are provided one frame (of all
+ * channels) at a time with write() and the result is requested with read() as long as
+ * isInputNeeded() is false, so that the conversion can be fused with the output of the decoder.
+ * n input frames give ceil(n * out rate / in rate) output frames: all frames which start before
+ * the end of the input.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadRateConverter {
+
+    public:
+
+        MadRateConverter() = default;
+        MadRateConverter(const MadRateConverter&) = delete;
+        MadRateConverter& operator=(const MadRateConverter&) = delete;
+
+        ~MadRateConverter(){
+            release();
+        }
+
+        /// Defines the allocator for the table and the history (e.g. of a MadMemoryArena): nullptr uses the heap
+        void setMemory(struct mad_memory const *memory){
+            release();
+            p_memory = memory;
+        }
+
+        /// Reserves the memory for the conversion of all mp3 sample rates to the output sample rate
+        bool allocate(){
+            size_t coefficient_count, history_count;
+            maxSize(coefficient_count, history_count);
+            return reserve(coefficient_count, history_count);
+        }
+
+        /// Reserves the memory for the conversion with the indicated interpolation and decimation factor
+        bool allocate(int upFactor, int downFactor){
+            int len = tapsFor(upFactor, downFactor);
+            return reserve(upFactor == downFactor ? 0 : upFactor * len, 4 * len);
+        }
+
+        /// Memory in bytes which is needed by allocate(): each block is aligned to the indicated number of bytes
+        size_t requiredMemory(size_t alignment){
+            size_t coefficient_count, history_count;
+            maxSize(coefficient_count, history_count);
+            return blockSize(coefficient_count * sizeof(int16_t), alignment) + blockSize(history_count * sizeof(mad_fixed_t), alignment);
+        }
+
+        /// Memory in bytes which is needed by allocate(upFactor, downFactor)
+        static size_t requiredMemory(int upFactor, int downFactor, size_t alignment){
+            int len = tapsFor(upFactor, downFactor);
+            return blockSize(upFactor == downFactor ? 0 : upFactor * len * sizeof(int16_t), alignment) + blockSize(4 * len * sizeof(mad_fixed_t), alignment);
+        }
+
+        /// Defines the output format: 0 keeps the sample rate or the channels of the input
+        void setOutput(int sampleRate, int channels){
+            out_rate = sampleRate;
+            out_channels = channels;
+            in_rate = 0;
+            in_channels = 0;
+            is_active = false;
+        }
+
+        /// Defines the input format: the filter is only recalculated and the history is only cleared if the ratio has changed
+        void begin(int inRate, int inChannels){
+            int old_up = up, old_down = down;
+            bool was_active = is_active;
+            in_rate = inRate;
+            in_channels = inChannels;
+            is_active = false;
+            if (in_rate <= 0 || in_channels <= 0) return;
+            if (sampleRate() == in_rate && channels() == in_channels) return;
+            int divisor = gcd(sampleRate(), in_rate);
+            up = sampleRate() / divisor;
+            down = in_rate / divisor;
+            if (up == down){
+                if (!reserve(0, 4)) return;
+                if (taps != 1) table_up = 0;
+                taps = 1;
+            } else if ((up != table_up || down != table_down) && !createTable()){
+                return;
+            }
+            history_channels = channels() == 1 ? 1 : in_channels;
+            if (!was_active || up != old_up || down != old_down) reset();
+            is_active = true;
+        }
+
+        /// Clears the history e.g. for a new stream
+        void reset(){
+            if (history != nullptr) memset(history, 0, 4 * taps * sizeof(mad_fixed_t));
+            pos = 0;
+            phase = up;
+        }
+
+        /// Returns true if the input needs to be converted
+        bool isActive(){
+            return is_active;
+        }
+
+        /// Provides the output sample rate
+        int sampleRate(){
+            return out_rate > 0 ? out_rate : in_rate;
+        }
+
+        /// Provides the output channels
+        int channels(){
+            return out_channels > 0 ? out_channels : in_channels;
+        }
+
+        /// Returns true if the next output sample needs a new input frame
+        bool isInputNeeded(){
+            return phase >= up;
+        }
+
+        /// Adds the next input frame: the right sample is ignored for mono
+        void write(mad_fixed_t left, mad_fixed_t right){
+            phase -= up;
+            if (history_channels == 1 && in_channels == 2){
+                left = (left >> 1) + (right >> 1);
+            }
+            pos = pos + 1 == taps ? 0 : pos + 1;
+            history[pos] = history[pos + taps] = left;
+            history[2 * taps + pos] = history[3 * taps + pos] = right;
+        }
+
+        /// Provides the next output frame with channels() samples: the result needs space for 2 samples
+        void read(mad_fixed_t *result){
+            if (up == down){
+                // we only convert the channels
+                result[0] = history[pos];
+                result[1] = history[(history_channels - 1) * 2 * taps + pos];
+            } else {
+                const int16_t *coef = coefficients + phase * taps;
+                for (int ch=0; ch<history_channels; ch++){
+                    result[ch] = convolve(history + ch * 2 * taps + pos + 1, coef, taps);
+                }
+                if (history_channels == 1) result[1] = result[0];
+            }
+            phase += down;
+        }
+
+        /// Skips the next output frame
+        void skip(){
+            phase += down;
+        }
+
+        /// Number of input frames which contribute to an output frame
+        int inputFrames(){
+            return taps;
+        }
+
+        /// Biggest sum of the absolute coefficients of a phase: no output sample exceeds the input by more than this factor
+        float maxGain(){
+            return up == down ? 1.0f : (float) max_gain / (1 << 14);
+        }
+
+    protected:
+        int out_rate = 0;
+        int out_channels = 0;
+        int in_rate = 0;
+        int in_channels = 0;
+        bool is_active = false;
+        int up = 1;                 // interpolation factor
+        int down = 1;               // decimation factor
+        int table_up = 0;           // ratio of the coefficients
+        int table_down = 0;
+        int phase = 1;              // position of the next output sample between the last two input frames in 1/up
+        int history_channels = 1;
+        int pos = 0;                // last written history entry
+        int taps = 1;               // coefficients per phase
+        int max_gain = 1 << 14;     // biggest sum of the absolute coefficients of a phase in Q14
+        int16_t *coefficients = nullptr;    // up phases of taps coefficients in Q14
+        mad_fixed_t *history = nullptr;     // 2 channels with 2 copies of the last taps frames
+        size_t coefficients_capacity = 0;
+        size_t history_capacity = 0;
+        struct mad_memory const *p_memory = nullptr;
+
+        /// Coefficients per phase: a lower output rate needs a longer filter for the same transition band
+        static int tapsFor(int upFactor, int downFactor){
+            if (upFactor == downFactor) return 1;
+            return MAD_RESAMPLE_TAPS * (downFactor > upFactor ? (downFactor + upFactor - 1) / upFactor : 1);
+        }
+
+        static size_t blockSize(size_t size, size_t alignment){
+            return size == 0 ? 0 : (size + alignment - 1) / alignment * alignment;
+        }
+
+        /// Biggest table and history for the conversion of the mp3 sample rates (also at half the sample rate) to the output rate
+        void maxSize(size_t &coefficientCount, size_t &historyCount){
+            static const int rates[] = {48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 6000, 5512, 4000};
+            coefficientCount = 0;
+            historyCount = 4;
+            if (out_rate <= 0) return;
+            for (int rate : rates){
+                int divisor = gcd(out_rate, rate);
+                int up_factor = out_rate / divisor, down_factor = rate / divisor;
+                if (up_factor == down_factor || up_factor > MAD_RESAMPLE_MAX_PHASES) continue;
+                int len = tapsFor(up_factor, down_factor);
+                if ((size_t) (up_factor * len) > coefficientCount) coefficientCount = up_factor * len;
+                if ((size_t) (4 * len) > historyCount) historyCount = 4 * len;
+            }
+        }
+
+        /// Makes sure that the table and the history can hold the indicated number of entries
+        bool reserve(size_t coefficientCount, size_t historyCount){
+            if (coefficientCount > coefficients_capacity){
+                mad_memory_free(p_memory, coefficients);
+                coefficients = (int16_t*) mad_memory_alloc(p_memory, coefficientCount * sizeof(int16_t));
+                coefficients_capacity = coefficients != nullptr ? coefficientCount : 0;
+                table_up = 0;
+            }
+            if (historyCount > history_capacity){
+                mad_memory_free(p_memory, history);
+                history = (mad_fixed_t*) mad_memory_alloc(p_memory, historyCount * sizeof(mad_fixed_t));
+                history_capacity = history != nullptr ? historyCount : 0;
+            }
+            if (coefficientCount > coefficients_capacity || historyCount > history_capacity){
+                LOG(Error, "resampling: %zu coefficients not available", coefficientCount);
+                return false;
+            }
+            return true;
+        }
+
+        /// Releases the table and the history
+        void release(){
+            mad_memory_free(p_memory, coefficients);
+            mad_memory_free(p_memory, history);
+            coefficients = nullptr;
+            history = nullptr;
+            coefficients_capacity = 0;
+            history_capacity = 0;
+            table_up = 0;
+            is_active = false;
+        }
+
+        static int gcd(int a, int b){
+            while (b != 0){
+                int tmp = a % b;
+                a = b;
+                b = tmp;
+            }
+            return a;
+        }
+
+        /// Dot product of the history (from the oldest to the newest frame) with the coefficients of a phase
+        static mad_fixed_t convolve(const mad_fixed_t *samples, const int16_t *coef, int len){
+            int64_t sum = 1 << 13;
+            for (int j=0; j<len; j++){
+                sum += (int64_t) samples[j] * coef[j];
+            }
+            return (mad_fixed_t) (sum >> 14);
+        }
+
+        /// Modified Bessel function of the first kind for the Kaiser window
+        static double besselI0(double x){
+            double sum = 1.0, term = 1.0;
+            for (int k=1; k<32; k++){
+                term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                sum += term;
+            }
+            return sum;
+        }
+
+        /// Calculates the polyphase filter: a Kaiser windowed sinc low-pass at the Nyquist frequency of the lower rate
+        bool createTable(){
+            if (up > MAD_RESAMPLE_MAX_PHASES){
+                LOG(Error, "resampling from %d to %d is not supported", in_rate, sampleRate());
+                return false;
+            }
+            int phase_taps = tapsFor(up, down);
+            if (!reserve(up * phase_taps, 4 * phase_taps)) return false;
+            taps = phase_taps;
+            table_up = up;
+            table_down = down;
+            max_gain = 0;
+            const double beta = 7.0;
+            int len = up * taps;
+            double cutoff = 0.95 * 0.5 / (up > down ? up : down);
+            double center = (len - 1) / 2.0;
+            double i0_beta = besselI0(beta);
+            // phase p uses every up-th coefficient: the newest input frame is the last one of the history
+            auto filter = [&](int p, int k){
+                double n = p + (taps - 1 - k) * up - center;
+                double x = 2.0 * cutoff * n;
+                double sinc = n == 0 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+                double r = n / (center + 0.5);
+                return sinc * besselI0(beta * sqrt(r * r < 1.0 ? 1.0 - r * r : 0.0)) / i0_beta;
+            };
+            for (int p=0; p<up; p++){
+                // we calculate the coefficients twice to avoid a temporary buffer
+                double sum = 0;
+                for (int k=0; k<taps; k++){
+                    sum += filter(p, k);
+                }
+                // each phase has a gain of 1: the rounding error is added to the biggest coefficient
+                int16_t *coef = coefficients + p * taps;
+                int total = 0, biggest = 0;
+                for (int k=0; k<taps; k++){
+                    coef[k] = (int16_t) lround(filter(p, k) / sum * (1 << 14));
+                    total += coef[k];
+                    if (coef[k] > coef[biggest]) biggest = k;
+                }
+                coef[biggest] += (1 << 14) - total;
+                int gain = 0;
+                for (int k=0; k<taps; k++){
+                    gain += coef[k] < 0 ? -coef[k] : coef[k];
+                }
+                if (gain > max_gain) max_gain = gain;
+            }
+            return true;
+        }
+};
+
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "libmad/mad.h"
+#include <stdio.h>
+#include <stddef.h>
+
+namespace libmad {
+
+/**
+ * @brief Profiling information of a decoder: clock ticks (see clock()) and number of
+ * invocations per decoding stage. The time of nested stages is not included in the
+ * outer stage. The requantization is only counted: its time is part of the Huffman
+ * decoding. The counters are only updated if everything is compiled with MAD_STATS:
+ * otherwise the instrumentation has no cost.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct MadStats : public mad_stats {
+    size_t frames = 0;      // number of synthesized frames (or granules)
+    size_t samples = 0;     // number of samples per channel
+
+    MadStats(){
+        clear();
+    }
+
+    /// Resets all counters
+    void clear(){
+        mad_stats_init(this);
+        frames = 0;
+        samples = 0;
+    }
+
+    /// Unit of the ticks: rdtsc, ns, us
+    static const char *clock(){
+        return mad_stats_clock();
+    }
+
+    /// Name of the stage
+    static const char *name(int stage){
+        return mad_stats_name((enum mad_stage)stage);
+    }
+
+    /// Sum of the ticks of all stages
+    unsigned long long totalTicks() const {
+        unsigned long long result = 0;
+        for (int j=0; j<MAD_STAGE_COUNT; j++){
+            result += ticks[j];
+        }
+        return result;
+    }
+
+    /// Average ticks per sample (and channel) of a stage
+    double ticksPerSample(int stage) const {
+        return samples > 0 ? (double) ticks[stage] / samples : 0;
+    }
+
+    /// Writes the statistics as JSON into the buffer: returns the length like snprintf()
+    int toJson(char *buffer, size_t len) const {
+        size_t pos = 0;
+        pos += format(buffer, len, pos, "{\"clock\":\"%s\",\"frames\":%zu,\"samples\":%zu,\"ticks\":%llu,\"stages\":{",
+            clock(), frames, samples, totalTicks());
+        for (int j=0; j<MAD_STAGE_COUNT; j++){
+            pos += format(buffer, len, pos, "%s\"%s\":{\"ticks\":%llu,\"calls\":%lu}", j==0 ? "" : ",", 
+                name(j), ticks[j], calls[j]);
+        }
+        pos += format(buffer, len, pos, "}}");
+        return pos;
+    }
+
+    protected:
+        template <typename... Args>
+        static size_t format(char *buffer, size_t len, size_t pos, const char *fmt, Args... args){
+            int result = snprintf(pos < len ? buffer + pos : nullptr, pos < len ? len - pos : 0, fmt, args...);
+            return result > 0 ? result : 0;
+        }
+};
+
+/**
+ * @brief Selects the statistics which are updated by libmad in the actual thread as long 
+ * as the object is in scope.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadStatsScope {
+    public:
+        MadStatsScope(MadStats &stats){
+#ifdef MAD_STATS
+            previous = mad_stats_select(&stats);
+#else
+            (void) stats;
+#endif
+        }
+
+        ~MadStatsScope(){
+#ifdef MAD_STATS
+            mad_stats_select(previous);
+#endif
+        }
+
+    protected:
+        struct mad_stats *previous = nullptr;
+};
+
+}
@@ -0,0 +1,299 @@
+#pragma once
+
+#include "MP3DecoderMAD.h"
+#include <math.h>
+#include <vector>
+
+namespace libmad {
+
+#ifndef MAD_WAVEFORM_BUFFER_SIZE
+#define MAD_WAVEFORM_BUFFER_SIZE 4096
+#endif
+
+/// Delay of the synthesis filterbank in samples: the subband samples are ahead of the pcm data
+#define MAD_WAVEFORM_SUBBAND_DELAY 224
+
+/**
+ * @brief Processing which is used by the MadWaveform to determine the envelope
+ */
+enum MadWaveformMode {
+    /// Energy of the subband samples w/o synthesis: the rms is exact within about 2 dB, the peak is estimated
+    MadWaveformSubband,
+    /// Synthesis at half the sample rate: the content above 1/4 of the sample rate is missing
+    MadWaveformHalfRate,
+    /// Synthesis at the full sample rate: exact result
+    MadWaveformFull
+};
+
+/**
+ * @brief Envelope of one channel for a range of samples: the values are relative to full scale
+ */
+struct MadWaveformPoint {
+    float min = 0.0f;
+    float max = 0.0f;
+    float rms = 0.0f;
+};
+
+/**
+ * @brief Determines the peak and rms envelope of mp3 data e.g. to draw a waveform: we provide
+ * one MadWaveformPoint per channel for each range of the indicated number of samples (per channel).
+ * The frames are only decoded by libmad and the envelope is calculated from the internal fixed
+ * point data, so there is no conversion to int16_t and no callback.
+ * In the MadWaveformSubband mode we skip the synthesis and use the subband samples: since the
+ * polyphase filterbank is almost orthogonal, 32 times their energy matches the energy of the
+ * 32 pcm samples. The peak is estimated from the sum of the absolute subband values of a slot.
+ * Measured against the int16_t decoding with 1152 samples per point (see the mp3_waveform example):
+ * - subband: 2-2.8 times faster, rms within -1.7/+1.1 dB (mean 0.1 dB), peak within -1.7/+3.5 dB
+ *   for 98% of the points (-5/+14 dB worst case). The deviation increases for shorter ranges and
+ *   at mono/stereo changes.
+ * - half rate: 1.7-2.1 times faster, rms within 1 dB, the peak is up to 8 dB too low (3.5 dB for 98%).
+ * - full: 1.3-1.5 times faster, exact result (the rms is not clipped).
+ * An order of magnitude is not possible because the Huffman decoding, the requantization and
+ * the IMDCT, which are needed in all modes, take about 60% of the decoding time.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MadWaveform {
+
+    public:
+
+        MadWaveform() = default;
+
+        ~MadWaveform(){
+            end();
+        }
+
+        MadWaveform(const MadWaveform&) = delete;
+        MadWaveform& operator=(const MadWaveform&) = delete;
+
+        /// Starts the processing: the points are determined for the indicated number of samples per channel (multiple of 32)
+        bool begin(size_t samplesPerPoint=1152, MadWaveformMode newMode=MadWaveformSubband){
+            end();
+            mode = newMode;
+            // we work with complete subband slots
+            samples_per_point = (samplesPerPoint + 31) / 32 * 32;
+            if (samples_per_point == 0) samples_per_point = 32;
+            mad_stream_init(&stream);
+            mad_frame_init(&frame);
+            mad_synth_init(&synth);
+            mad_stream_options(&stream, mode == MadWaveformHalfRate ? MAD_OPTION_HALFSAMPLERATE : 0);
+            buffer.resize(MAD_WAVEFORM_BUFFER_SIZE);
+            buffer_len = 0;
+            result.clear();
+            channel_count = 0;
+            sample_rate = 0;
+            total_samples = 0;
+            count = 0;
+            active = true;
+            return true;
+        }
+
+        /// Processes the remaining data and releases the libmad state
+        void end(){
+            if (active){
+                // the guard makes sure that the last frame is processed as well
+                memset(buffer.data() + buffer_len, 0, MAD_BUFFER_GUARD);
+                decode(buffer.data(), buffer_len + MAD_BUFFER_GUARD);
+                buffer_len = 0;
+                if (count > 0) addPoint();
+                mad_synth_finish(&synth);
+                mad_frame_finish(&frame);
+                mad_stream_finish(&stream);
+                active = false;
+            }
+        }
+
+        /// Provides the mp3 data
+        size_t write(const void *data, size_t len){
+            if (!active) return 0;
+            const uint8_t *in = (const uint8_t*) data;
+            size_t result = 0;
+            while (result < len){
+                // we keep some space for the guard
+                size_t space = buffer.size() - MAD_BUFFER_GUARD - buffer_len;
+                size_t copy_len = min(space, len - result);
+                memcpy(buffer.data() + buffer_len, in + result, copy_len);
+                buffer_len += copy_len;
+                result += copy_len;
+                size_t consumed = decode(buffer.data(), buffer_len);
+                if (consumed == 0 && buffer_len + MAD_BUFFER_GUARD == buffer.size()){
+                    // a frame which does not fit into the buffer
+                    buffer.resize(buffer.size() * 2);
+                }
+                buffer_len -= consumed;
+                memmove(buffer.data(), buffer.data() + consumed, buffer_len);
+            }
+            return result;
+        }
+
+        /// Determines the envelope of complete mp3 data w/o copying it: returns the number of points per channel
+        size_t process(const void *data, size_t len){
+            if (!active) return 0;
+            size_t consumed = decode((const uint8_t*) data, len);
+            write((const uint8_t*)data + consumed, len - consumed);
+            end();
+            return points();
+        }
+
+        /// Number of points per channel
+        size_t points(){
+            return channel_count == 0 ? 0 : result.size() / channel_count;
+        }
+
+        /// Provides the point of the indicated channel
+        MadWaveformPoint &point(size_t index, int channel=0){
+            return result[index * channel_count + channel];
+        }
+
+        /// Provides all points: the channels are interleaved
+        std::vector<MadWaveformPoint> &data(){
+            return result;
+        }
+
+        /// Number of channels of the first frame: mono frames in a stereo stream are used for both channels
+        int channels(){
+            return channel_count;
+        }
+
+        /// Sample rate of the first frame
+        int sampleRate(){
+            return sample_rate;
+        }
+
+        /// Number of samples per channel which are represented by a point
+        size_t samplesPerPoint(){
+            return samples_per_point;
+        }
+
+        /// Number of processed samples per channel
+        size_t samples(){
+            return total_samples;
+        }
+
+    protected:
+        struct mad_stream stream;
+        struct mad_frame frame;
+        struct mad_synth synth;
+        MadWaveformMode mode = MadWaveformSubband;
+        std::vector<uint8_t> buffer;
+        size_t buffer_len = 0;
+        std::vector<MadWaveformPoint> result;
+        size_t samples_per_point = 1152;
+        size_t total_samples = 0;
+        int channel_count = 0;
+        int sample_rate = 0;
+        bool active = false;
+        // state of the actual point
+        mad_fixed_t peak_min[2];
+        mad_fixed_t peak_max[2];
+        int64_t energy[2];
+        size_t count = 0;       // processed samples (at the full rate)
+
+        /// Decodes all complete frames: returns the number of consumed bytes
+        size_t decode(const uint8_t *data, size_t len){
+            mad_stream_buffer(&stream, data, len);
+            while (true){
+                if (mad_frame_decode(&frame, &stream) == -1){
+                    if (MAD_RECOVERABLE(stream.error)) continue;
+                    // MAD_ERROR_BUFLEN: we need more data
+                    break;
+                }
+                if (channel_count == 0) setup();
+                if (mode == MadWaveformSubband){
+                    addSubbands();
+                } else {
+                    mad_synth_frame(&synth, &frame);
+                    addPCM();
+                }
+            }
+            return stream.next_frame - data;
+        }
+
+        /// Defines the format with the first frame
+        void setup(){
+            channel_count = MAD_NCHANNELS(&frame.header);
+            sample_rate = frame.header.samplerate;
+            resetPoint();
+            if (mode == MadWaveformSubband){
+                // we align the subband samples with the pcm data
+                count = MAD_WAVEFORM_SUBBAND_DELAY;
+            }
+        }
+
+        void resetPoint(){
+            for (int ch=0; ch<2; ch++){
+                peak_min[ch] = 0;
+                peak_max[ch] = 0;
+                energy[ch] = 0;
+            }
+            count = 0;
+        }
+
+        /// Adds the subband samples of the actual frame: each slot represents 32 samples
+        void addSubbands(){
+            int slots = MAD_NSBSAMPLES(&frame.header);
+            int channels = MAD_NCHANNELS(&frame.header);
+            for (int s=0; s<slots; s++){
+                for (int ch=0; ch<channel_count; ch++){
+                    // a mono frame is used for both channels
+                    const mad_fixed_t *sb = frame.sbsample[ch < channels ? ch : 0][s];
+                    int64_t sum = 0;
+                    mad_fixed_t abs_sum = 0;
+                    for (int j=0; j<32; j++){
+                        sum += ((int64_t) sb[j] * sb[j]) >> MAD_F_FRACBITS;
+                        abs_sum += sb[j] < 0 ? -sb[j] : sb[j];
+                    }
+                    // 32 * sum for 32 samples
+                    energy[ch] += sum << 5;
+                    if (abs_sum > peak_max[ch]){
+                        peak_max[ch] = abs_sum;
+                        peak_min[ch] = -abs_sum;
+                    }
+                }
+                count += 32;
+                total_samples += 32;
+                if (count >= samples_per_point) addPoint();
+            }
+        }
+
+        /// Adds the synthesized samples of the actual frame
+        void addPCM(){
+            struct mad_pcm &pcm = synth.pcm;
+            int channels = pcm.channels;
+            // in the half rate mode each sample represents 2 samples
+            int step = mode == MadWaveformHalfRate ? 2 : 1;
+            for (int j=0; j<pcm.length; j++){
+                for (int ch=0; ch<channel_count; ch++){
+                    // a mono frame is used for both channels
+                    mad_fixed_t sample = pcm.samples[ch < channels ? ch : 0][j];
+                    energy[ch] += (((int64_t) sample * sample) >> MAD_F_FRACBITS) * step;
+                    if (sample > peak_max[ch]) peak_max[ch] = sample;
+                    if (sample < peak_min[ch]) peak_min[ch] = sample;
+                }
+                count += step;
+                total_samples += step;
+                if (count >= samples_per_point) addPoint();
+            }
+        }
+
+        /// Adds the point of the actual range
+        void addPoint(){
+            for (int ch=0; ch<channel_count; ch++){
+                MadWaveformPoint point;
+                point.min = clip(mad_f_todouble(peak_min[ch]));
+                point.max = clip(mad_f_todouble(peak_max[ch]));
+                point.rms = sqrtf((float) energy[ch] / MAD_F_ONE / count);
+                result.push_back(point);
+            }
+            resetPoint();
+        }
+
+        static float clip(float value){
+            if (value > 1.0f) return 1.0f;
+            if (value < -1.0f) return -1.0f;
+            return value;
+        }
+};
+
+}
@@ -25,6 +25,11 @@
 /* Define to 1 if you have the `fork' function. */
 #undef HAVE_FORK
 
+/* Define to 1 if you have POSIX threads (used by MAD_DECODER_MODE_ASYNC). */
+#if !defined(HAVE_PTHREAD) && (defined(__unix__) || defined(__APPLE__) || defined(ESP_PLATFORM))
+#define HAVE_PTHREAD 1
+#endif
+
 /* Define to 1 if you have the <inttypes.h> header file. */
 #undef HAVE_INTTYPES_H
 
@@ -135,7 +140,9 @@
 /* Define to `int' if <sys/types.h> does not define. */
 /* #undef pid_t */
 
-#if defined(__arm__)	&& !defined(ARDUINO)
+/* the fixed point implementation can be selected by the build (e.g. -DFPM_64BIT) */
+#if defined(FPM_DEFAULT) || defined(FPM_64BIT) || defined(FPM_INTEL) || defined(FPM_ARM) || defined(FPM_MIPS) || defined(FPM_SPARC) || defined(FPM_PPC)
+#elif defined(__arm__)	&& !defined(ARDUINO)
 # define FPM_ARM
 #elif defined(_X64_)
 # define FPM_INTEL
@@ -143,8 +150,13 @@
 #define FPM_DEFAULT
 #endif
 
-/// Move major data from the stack to the heap
+/// Move major data from the stack to the heap. This makes the decoder non reentrant:
+/// set it to 0 if multiple decoders are running in parallel threads
+#ifndef MAD_STACK_HACK
 #define MAD_STACK_HACK 1
+#endif
 
 /// Move additinal (small) data sizes from the stack to the heap - unnecessarily wasting heap space
-#define MAD_STACK_HACK1 0
\ No newline at end of file
+#ifndef MAD_STACK_HACK1
+#define MAD_STACK_HACK1 0
+#endif
\ No newline at end of file
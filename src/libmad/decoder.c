@@ -28,22 +28,29 @@
 #include <sys/types.h>
 # endif
 
-# ifdef HAVE_SYS_WAIT_H
-#include <sys/wait.h>
-# endif
-
-# ifdef HAVE_UNISTD_H
-#include <unistd.h>
-# endif
-
-# ifdef HAVE_FCNTL_H
-#include <fcntl.h>
-# endif
-
 #include <stdlib.h>
 
-# ifdef HAVE_ERRNO_H
-#include <errno.h>
+#include <string.h>
+
+# if defined(USE_ASYNC)
+#include <pthread.h>
+
+/* the command queue is shared with the decoder thread w/o locks */
+#  define ASYNC_LOAD(var)		__atomic_load_n(&(var), __ATOMIC_ACQUIRE)
+#  define ASYNC_STORE(var, value)	__atomic_store_n(&(var), (value), __ATOMIC_RELEASE)
+
+/* number of checks before a thread blocks in async_wait() */
+#  if !defined(MAD_DECODER_SPINS)
+#   define MAD_DECODER_SPINS  256
+#  endif
+
+/* the lock and condition are only used by a thread which waits longer */
+struct async_thread {
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  unsigned int sleepers;		/* threads waiting for the condition */
+};
 # endif
 
 #include "stream.h"
@@ -76,9 +83,8 @@ void mad_decoder_init(struct mad_decoder *decoder, void *data,
 
   decoder->options      = 0;
 
-  decoder->async.pid    = 0;
-  decoder->async.in     = -1;
-  decoder->async.out    = -1;
+  decoder->async.thread = 0;
+  decoder->async.result = 0;
 
   decoder->sync         = 0;
 
@@ -90,206 +96,170 @@ void mad_decoder_init(struct mad_decoder *decoder, void *data,
   decoder->output_func  = output_func;
   decoder->error_func   = error_func;
   decoder->message_func = message_func;
-}
-
-int mad_decoder_finish(struct mad_decoder *decoder)
-{
-# if defined(USE_ASYNC)
-  if (decoder->mode == MAD_DECODER_MODE_ASYNC && decoder->async.pid) {
-    pid_t pid;
-    int status;
-
-    close(decoder->async.in);
-
-    do
-      pid = waitpid(decoder->async.pid, &status, 0);
-    while (pid == -1 && errno == EINTR);
 
-    decoder->mode = -1;
-
-    close(decoder->async.out);
-
-    decoder->async.pid = 0;
-    decoder->async.in  = -1;
-    decoder->async.out = -1;
-
-    if (pid == -1)
-      return -1;
-
-    return (!WIFEXITED(status) || WEXITSTATUS(status)) ? -1 : 0;
-  }
-# endif
-
-  return 0;
+  decoder->memory       = 0;
 }
 
 # if defined(USE_ASYNC)
+/*
+ * NAME:	async_notify()
+ * DESCRIPTION:	wake up the other thread if it is blocked in async_wait()
+ */
 static
-enum mad_flow send_io(int fd, void const *data, size_t len)
+void async_notify(struct mad_decoder *decoder)
 {
-  char const *ptr = data;
-  ssize_t count;
-
-  while (len) {
-    do
-      count = write(fd, ptr, len);
-    while (count == -1 && errno == EINTR);
+  struct async_thread *thread = decoder->async.thread;
 
-    if (count == -1)
-      return MAD_FLOW_BREAK;
+  /* the read-modify-write orders the preceding store with the increment
+     of a sleeper, so that it either sees the store or we see the sleeper */
 
-    len -= count;
-    ptr += count;
+  if (__atomic_fetch_add(&thread->sleepers, 0, __ATOMIC_ACQ_REL)) {
+    pthread_mutex_lock(&thread->mutex);
+    pthread_cond_broadcast(&thread->cond);
+    pthread_mutex_unlock(&thread->mutex);
   }
-
-  return MAD_FLOW_CONTINUE;
 }
 
+/*
+ * NAME:	async_wait()
+ * DESCRIPTION:	wait until *var differs from value or *end is set: we check
+ *		the value a few times (a fast reply on another core) and then
+ *		block until the other thread calls async_notify(); yielding
+ *		instead would let the other thread use up its time slice on a
+ *		single core before we get the processor again
+ */
 static
-enum mad_flow receive_io(int fd, void *buffer, size_t len)
+void async_wait(struct mad_decoder *decoder, unsigned int const *var,
+		unsigned int value, unsigned int const *end,
+		unsigned int *spins)
 {
-  char *ptr = buffer;
-  ssize_t count;
+  struct async_thread *thread = decoder->async.thread;
 
-  while (len) {
-    do
-      count = read(fd, ptr, len);
-    while (count == -1 && errno == EINTR);
+  if (++*spins < MAD_DECODER_SPINS)
+    return;
 
-    if (count == -1)
-      return (errno == EAGAIN) ? MAD_FLOW_IGNORE : MAD_FLOW_BREAK;
-    else if (count == 0)
-      return MAD_FLOW_STOP;
+  pthread_mutex_lock(&thread->mutex);
+  __atomic_fetch_add(&thread->sleepers, 1, __ATOMIC_ACQ_REL);
 
-    len -= count;
-    ptr += count;
-  }
+  while (ASYNC_LOAD(*var) == value && !ASYNC_LOAD(*end))
+    pthread_cond_wait(&thread->cond, &thread->mutex);
 
-  return MAD_FLOW_CONTINUE;
+  __atomic_fetch_sub(&thread->sleepers, 1, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&thread->mutex);
 }
+# endif
 
-static
-enum mad_flow receive_io_blocking(int fd, void *buffer, size_t len)
+int mad_decoder_finish(struct mad_decoder *decoder)
 {
-  int flags, blocking;
-  enum mad_flow result;
-
-  flags = fcntl(fd, F_GETFL);
-  if (flags == -1)
-    return MAD_FLOW_BREAK;
-
-  blocking = flags & ~O_NONBLOCK;
-
-  if (blocking != flags &&
-      fcntl(fd, F_SETFL, blocking) == -1)
-    return MAD_FLOW_BREAK;
-
-  result = receive_io(fd, buffer, len);
-
-  if (flags != blocking &&
-      fcntl(fd, F_SETFL, flags) == -1)
-    return MAD_FLOW_BREAK;
+# if defined(USE_ASYNC)
+  if (decoder->mode == MAD_DECODER_MODE_ASYNC && decoder->async.thread) {
+    struct async_thread *thread = decoder->async.thread;
 
-  return result;
-}
+    /* the decoder thread stops at the next frame */
 
-static
-enum mad_flow send(int fd, void const *message, unsigned int size)
-{
-  enum mad_flow result;
+    ASYNC_STORE(decoder->async.stop, 1);
+    async_notify(decoder);
+    pthread_join(thread->thread, 0);
 
-  /* send size */
+    pthread_cond_destroy(&thread->cond);
+    pthread_mutex_destroy(&thread->mutex);
+    mad_memory_free(decoder->memory, thread);
+    decoder->async.thread = 0;
 
-  result = send_io(fd, &size, sizeof(size));
+    mad_memory_free(decoder->memory, decoder->sync);
+    decoder->sync = 0;
 
-  /* send message */
+    decoder->mode = -1;
 
-  if (result == MAD_FLOW_CONTINUE)
-    result = send_io(fd, message, size);
+    return decoder->async.result;
+  }
+# endif
 
-  return result;
+  return 0;
 }
 
+# if defined(USE_ASYNC)
+/*
+ * NAME:	check_message()
+ * DESCRIPTION:	process the next command of the queue; if message_func()
+ *		returns MAD_FLOW_PAUSE (or pause is set) we wait for the next
+ *		command
+ */
 static
-enum mad_flow receive(int fd, void **message, unsigned int *size)
+enum mad_flow check_message(struct mad_decoder *decoder, int pause)
 {
-  enum mad_flow result;
-  unsigned int actual;
+  enum mad_flow result = pause ? MAD_FLOW_PAUSE : MAD_FLOW_IGNORE;
+  struct mad_decoder_command *command;
+  unsigned int tail, spins = 0;
 
-  if (*message == 0)
-    *size = 0;
-
-  /* receive size */
+  while (1) {
+    if (ASYNC_LOAD(decoder->async.stop))
+      return MAD_FLOW_STOP;
 
-  result = receive_io(fd, &actual, sizeof(actual));
+    tail = decoder->async.tail;
 
-  /* receive message */
+    if (tail == ASYNC_LOAD(decoder->async.head)) {
+      if (result != MAD_FLOW_PAUSE)
+	return result;
 
-  if (result == MAD_FLOW_CONTINUE) {
-    if (actual > *size)
-      actual -= *size;
-    else {
-      *size  = actual;
-      actual = 0;
+      async_wait(decoder, &decoder->async.head, tail,
+		 &decoder->async.stop, &spins);
+      continue;
     }
 
-    if (*size > 0) {
-      if (*message == 0) {
-	*message = malloc(*size);
-	if (*message == 0)
-	  return MAD_FLOW_BREAK;
-      }
+    command = &decoder->async.queue[tail % MAD_DECODER_QUEUE];
 
-      result = receive_io_blocking(fd, *message, *size);
+    if (decoder->message_func == 0) {
+      *command->len = 0;
+      result = MAD_FLOW_CONTINUE;
     }
+    else {
+      result = decoder->message_func(decoder->cb_data,
+				     command->message, command->len);
 
-    /* throw away remainder of message */
+      if (result == MAD_FLOW_IGNORE ||
+	  result == MAD_FLOW_BREAK)
+	*command->len = 0;
+    }
 
-    while (actual && result == MAD_FLOW_CONTINUE) {
-      char sink[256];
-      unsigned int len;
+    /* the command must not be used after the reply */
 
-      len = actual > sizeof(sink) ? sizeof(sink) : actual;
+    ASYNC_STORE(command->done, 1);
+    ASYNC_STORE(decoder->async.tail, tail + 1);
+    async_notify(decoder);
 
-      result = receive_io_blocking(fd, sink, len);
+    if (result != MAD_FLOW_PAUSE)
+      return result;
 
-      actual -= len;
-    }
+    spins = 0;
   }
-
-  return result;
 }
+# endif
 
+/*
+ * NAME:	resume()
+ * DESCRIPTION:	handle MAD_FLOW_PAUSE of a callback: in async mode we wait
+ *		for the next command, otherwise we continue normally
+ */
 static
-enum mad_flow check_message(struct mad_decoder *decoder)
+enum mad_flow resume(struct mad_decoder *decoder, enum mad_flow flow)
 {
-  enum mad_flow result;
-  void *message = 0;
-  unsigned int size;
+  if (flow != MAD_FLOW_PAUSE)
+    return flow;
 
-  result = receive(decoder->async.in, &message, &size);
-
-  if (result == MAD_FLOW_CONTINUE) {
-    if (decoder->message_func == 0)
-      size = 0;
-    else {
-      result = decoder->message_func(decoder->cb_data, message, &size);
-
-      if (result == MAD_FLOW_IGNORE ||
-	  result == MAD_FLOW_BREAK)
-	size = 0;
-    }
+# if defined(USE_ASYNC)
+  if (decoder->mode == MAD_DECODER_MODE_ASYNC) {
+    flow = check_message(decoder, 1);
 
-    if (send(decoder->async.out, message, size) != MAD_FLOW_CONTINUE)
-      result = MAD_FLOW_BREAK;
+    if (flow == MAD_FLOW_STOP || flow == MAD_FLOW_BREAK)
+      return flow;
   }
+# else
+  (void) decoder;
+# endif
 
-  if (message)
-    free(message);
-
-  return result;
+  return MAD_FLOW_CONTINUE;
 }
-# endif
 
 static
 enum mad_flow error_default(void *data, struct mad_stream *stream,
@@ -311,6 +281,27 @@ enum mad_flow error_default(void *data, struct mad_stream *stream,
   }
 }
 
+# if defined(MAD_SYNTH_NO_PCM)
+/*
+ * NAME:	synth_pcm()
+ * DESCRIPTION:	collect the synthesized slots of a frame for output_func()
+ */
+static
+void synth_pcm(void *data, unsigned int nch, unsigned int length,
+	       mad_fixed_t const samples[2][32])
+{
+  struct mad_pcm *pcm = data;
+  unsigned int ch;
+
+  for (ch = 0; ch < nch; ++ch) {
+    memcpy(&pcm->samples[ch][pcm->length], samples[ch],
+	   length * sizeof(mad_fixed_t));
+  }
+
+  pcm->length += length;
+}
+# endif
+
 static
 int run_sync(struct mad_decoder *decoder)
 {
@@ -320,6 +311,7 @@ int run_sync(struct mad_decoder *decoder)
   struct mad_stream *stream;
   struct mad_frame *frame;
   struct mad_synth *synth;
+  struct mad_pcm *pcm;
   int result = 0;
 
   if (decoder->input_func == 0)
@@ -337,15 +329,22 @@ int run_sync(struct mad_decoder *decoder)
   stream = &decoder->sync->stream;
   frame  = &decoder->sync->frame;
   synth  = &decoder->sync->synth;
+# if defined(MAD_SYNTH_NO_PCM)
+  pcm    = &decoder->sync->pcm;
+# else
+  pcm    = &synth->pcm;
+# endif
 
   mad_stream_init(stream);
   mad_frame_init(frame);
   mad_synth_init(synth);
 
   mad_stream_options(stream, decoder->options);
+  mad_stream_memory(stream, decoder->memory);
+  mad_frame_memory(frame, decoder->memory);
 
   do {
-    switch (decoder->input_func(decoder->cb_data, stream)) {
+    switch (resume(decoder, decoder->input_func(decoder->cb_data, stream))) {
     case MAD_FLOW_STOP:
       goto done;
     case MAD_FLOW_BREAK:
@@ -353,15 +352,17 @@ int run_sync(struct mad_decoder *decoder)
     case MAD_FLOW_IGNORE:
       continue;
     case MAD_FLOW_CONTINUE:
+    case MAD_FLOW_PAUSE:
       break;
     }
 
     while (1) {
 # if defined(USE_ASYNC)
       if (decoder->mode == MAD_DECODER_MODE_ASYNC) {
-	switch (check_message(decoder)) {
+	switch (check_message(decoder, 0)) {
 	case MAD_FLOW_IGNORE:
 	case MAD_FLOW_CONTINUE:
+	case MAD_FLOW_PAUSE:
 	  break;
 	case MAD_FLOW_BREAK:
 	  goto fail;
@@ -376,7 +377,7 @@ int run_sync(struct mad_decoder *decoder)
 	  if (!MAD_RECOVERABLE(stream->error))
 	    break;
 
-	  switch (error_func(error_data, stream, frame)) {
+	  switch (resume(decoder, error_func(error_data, stream, frame))) {
 	  case MAD_FLOW_STOP:
 	    goto done;
 	  case MAD_FLOW_BREAK:
@@ -388,7 +389,8 @@ int run_sync(struct mad_decoder *decoder)
 	  }
 	}
 
-	switch (decoder->header_func(decoder->cb_data, &frame->header)) {
+	switch (resume(decoder,
+		       decoder->header_func(decoder->cb_data, &frame->header))) {
 	case MAD_FLOW_STOP:
 	  goto done;
 	case MAD_FLOW_BREAK:
@@ -396,6 +398,7 @@ int run_sync(struct mad_decoder *decoder)
 	case MAD_FLOW_IGNORE:
 	  continue;
 	case MAD_FLOW_CONTINUE:
+	case MAD_FLOW_PAUSE:
 	  break;
 	}
       }
@@ -404,7 +407,7 @@ int run_sync(struct mad_decoder *decoder)
 	if (!MAD_RECOVERABLE(stream->error))
 	  break;
 
-	switch (error_func(error_data, stream, frame)) {
+	switch (resume(decoder, error_func(error_data, stream, frame))) {
 	case MAD_FLOW_STOP:
 	  goto done;
 	case MAD_FLOW_BREAK:
@@ -420,7 +423,8 @@ int run_sync(struct mad_decoder *decoder)
 	bad_last_frame = 0;
 
       if (decoder->filter_func) {
-	switch (decoder->filter_func(decoder->cb_data, stream, frame)) {
+	switch (resume(decoder,
+		       decoder->filter_func(decoder->cb_data, stream, frame))) {
 	case MAD_FLOW_STOP:
 	  goto done;
 	case MAD_FLOW_BREAK:
@@ -428,24 +432,42 @@ int run_sync(struct mad_decoder *decoder)
 	case MAD_FLOW_IGNORE:
 	  continue;
 	case MAD_FLOW_CONTINUE:
+	case MAD_FLOW_PAUSE:
 	  break;
 	}
       }
 
-      mad_synth_frame(synth, frame);
+      /* Layer III granules (MAD_OPTION_GRANULES) are synthesized one by one */
 
-      if (decoder->output_func) {
-	switch (decoder->output_func(decoder->cb_data,
-				     &frame->header, &synth->pcm)) {
-	case MAD_FLOW_STOP:
-	  goto done;
-	case MAD_FLOW_BREAK:
-	  goto fail;
-	case MAD_FLOW_IGNORE:
-	case MAD_FLOW_CONTINUE:
-	  break;
+      do {
+# if defined(MAD_SYNTH_NO_PCM)
+	pcm->samplerate = frame->header.samplerate;
+	pcm->channels   = MAD_NCHANNELS(&frame->header);
+	pcm->length     = 0;
+
+	if (frame->options & MAD_OPTION_HALFSAMPLERATE)
+	  pcm->samplerate /= 2;
+
+	mad_synth_frame_slots(synth, frame, synth_pcm, pcm);
+# else
+	mad_synth_frame(synth, frame);
+# endif
+
+	if (decoder->output_func) {
+	  switch (resume(decoder, decoder->output_func(decoder->cb_data,
+						       &frame->header, pcm))) {
+	  case MAD_FLOW_STOP:
+	    goto done;
+	  case MAD_FLOW_BREAK:
+	    goto fail;
+	  case MAD_FLOW_IGNORE:
+	  case MAD_FLOW_CONTINUE:
+	  case MAD_FLOW_PAUSE:
+	    break;
+	  }
 	}
       }
+      while (mad_frame_decode_granule(frame, stream) == 1);
     }
   }
   while (stream->error == MAD_ERROR_BUFLEN);
@@ -463,65 +485,59 @@ int run_sync(struct mad_decoder *decoder)
 
 # if defined(USE_ASYNC)
 static
-int run_async(struct mad_decoder *decoder)
+void *async_main(void *data)
 {
-  pid_t pid;
-  int ptoc[2], ctop[2], flags;
+  struct mad_decoder *decoder = data;
 
-  if (pipe(ptoc) == -1)
-    return -1;
+  decoder->async.result = run_sync(decoder);
+  ASYNC_STORE(decoder->async.finished, 1);
+  async_notify(decoder);
 
-  if (pipe(ctop) == -1) {
-    close(ptoc[0]);
-    close(ptoc[1]);
-    return -1;
-  }
+  return 0;
+}
 
-  flags = fcntl(ptoc[0], F_GETFL);
-  if (flags == -1 ||
-      fcntl(ptoc[0], F_SETFL, flags | O_NONBLOCK) == -1) {
-    close(ctop[0]);
-    close(ctop[1]);
-    close(ptoc[0]);
-    close(ptoc[1]);
-    return -1;
-  }
+static
+int run_async(struct mad_decoder *decoder)
+{
+  struct async_thread *thread;
+  pthread_attr_t attr;
+  int error;
 
-  pid = fork();
-  if (pid == -1) {
-    close(ctop[0]);
-    close(ctop[1]);
-    close(ptoc[0]);
-    close(ptoc[1]);
+  thread = mad_memory_alloc(decoder->memory, sizeof(*thread));
+  if (thread == 0)
     return -1;
-  }
 
-  decoder->async.pid = pid;
+  decoder->async.result   = 0;
+  decoder->async.stop     = 0;
+  decoder->async.finished = 0;
+  decoder->async.head     = 0;
+  decoder->async.tail     = 0;
 
-  if (pid) {
-    /* parent */
+  thread->sleepers = 0;
+  pthread_mutex_init(&thread->mutex, 0);
+  pthread_cond_init(&thread->cond, 0);
 
-    close(ptoc[0]);
-    close(ctop[1]);
+  /* the decoder thread might notify us right away */
 
-    decoder->async.in  = ctop[0];
-    decoder->async.out = ptoc[1];
+  decoder->async.thread = thread;
 
-    return 0;
-  }
-
-  /* child */
-
-  close(ptoc[1]);
-  close(ctop[0]);
+  pthread_attr_init(&attr);
+# if defined(MAD_DECODER_STACK_SIZE)
+  pthread_attr_setstacksize(&attr, MAD_DECODER_STACK_SIZE);
+# endif
 
-  decoder->async.in  = ptoc[0];
-  decoder->async.out = ctop[1];
+  error = pthread_create(&thread->thread, &attr, async_main, decoder);
+  pthread_attr_destroy(&attr);
 
-  _exit(run_sync(decoder));
+  if (error) {
+    decoder->async.thread = 0;
+    pthread_cond_destroy(&thread->cond);
+    pthread_mutex_destroy(&thread->mutex);
+    mad_memory_free(decoder->memory, thread);
+    return -1;
+  }
 
-  /* not reached */
-  return -1;
+  return 0;
 }
 # endif
 
@@ -549,13 +565,18 @@ int mad_decoder_run(struct mad_decoder *decoder, enum mad_decoder_mode mode)
   if (run == 0)
     return -1;
 
-  decoder->sync = malloc(sizeof(*decoder->sync));
+  decoder->sync = mad_memory_alloc(decoder->memory, sizeof(*decoder->sync));
   if (decoder->sync == 0)
     return -1;
 
   result = run(decoder);
 
-  free(decoder->sync);
+  /* the decoder thread releases the buffers in mad_decoder_finish() */
+
+  if (mode == MAD_DECODER_MODE_ASYNC && result == 0)
+    return 0;
+
+  mad_memory_free(decoder->memory, decoder->sync);
   decoder->sync = 0;
 
   return result;
@@ -563,17 +584,48 @@ int mad_decoder_run(struct mad_decoder *decoder, enum mad_decoder_mode mode)
 
 /*
  * NAME:	decoder->message()
- * DESCRIPTION:	send a message to and receive a reply from the decoder process
+ * DESCRIPTION:	send a message to the decoder thread and wait for the reply,
+ *		which replaces the message; only one thread may send messages
  */
 int mad_decoder_message(struct mad_decoder *decoder,
 			void *message, unsigned int *len)
 {
 # if defined(USE_ASYNC)
-  if (decoder->mode != MAD_DECODER_MODE_ASYNC ||
-      send(decoder->async.out, message, *len) != MAD_FLOW_CONTINUE ||
-      receive(decoder->async.in, &message, len) != MAD_FLOW_CONTINUE)
+  struct mad_decoder_command *command;
+  unsigned int head, spins = 0;
+
+  if (decoder->mode != MAD_DECODER_MODE_ASYNC || decoder->async.thread == 0)
     return -1;
 
+  head = decoder->async.head;
+
+  while (head - ASYNC_LOAD(decoder->async.tail) >= MAD_DECODER_QUEUE) {
+    if (ASYNC_LOAD(decoder->async.finished))
+      return -1;
+
+    async_wait(decoder, &decoder->async.tail, head - MAD_DECODER_QUEUE,
+	       &decoder->async.finished, &spins);
+  }
+
+  command = &decoder->async.queue[head % MAD_DECODER_QUEUE];
+  command->message = message;
+  command->len     = len;
+  command->done    = 0;
+
+  ASYNC_STORE(decoder->async.head, head + 1);
+  async_notify(decoder);
+
+  /* the decoder thread checks the queue before every frame */
+
+  spins = 0;
+
+  while (!ASYNC_LOAD(command->done)) {
+    if (ASYNC_LOAD(decoder->async.finished))
+      return ASYNC_LOAD(command->done) ? 0 : -1;
+
+    async_wait(decoder, &command->done, 0, &decoder->async.finished, &spins);
+  }
+
   return 0;
 # else
   return -1;
@@ -35,7 +35,19 @@ enum mad_flow {
   MAD_FLOW_CONTINUE = 0x0000,	/* continue normally */
   MAD_FLOW_STOP     = 0x0010,	/* stop decoding normally */
   MAD_FLOW_BREAK    = 0x0011,	/* stop decoding and signal an error */
-  MAD_FLOW_IGNORE   = 0x0020	/* ignore the current frame */
+  MAD_FLOW_IGNORE   = 0x0020,	/* ignore the current frame */
+  MAD_FLOW_PAUSE    = 0x0030	/* wait for the next message (async),
+				   continue normally (sync) */
+};
+
+# if !defined(MAD_DECODER_QUEUE)
+#  define MAD_DECODER_QUEUE  4
+# endif
+
+struct mad_decoder_command {
+  void *message;			/* message, replaced by the reply */
+  unsigned int *len;			/* message and reply length */
+  unsigned int done;			/* the reply is available */
 };
 
 struct mad_decoder {
@@ -44,15 +56,22 @@ struct mad_decoder {
   int options;
 
   struct {
-    long pid;
-    int in;
-    int out;
+    void *thread;			/* decoder thread */
+    int result;				/* result of the decoder thread */
+    unsigned int stop;			/* mad_decoder_finish() was called */
+    unsigned int finished;		/* the decoder thread has ended */
+    unsigned int head;			/* number of sent commands */
+    unsigned int tail;			/* number of processed commands */
+    struct mad_decoder_command queue[MAD_DECODER_QUEUE];
   } async;
 
   struct {
     struct mad_stream stream;
     struct mad_frame frame;
     struct mad_synth synth;
+# if defined(MAD_SYNTH_NO_PCM)
+    struct mad_pcm pcm;
+# endif
   } *sync;
 
   void *cb_data;
@@ -65,6 +84,8 @@ struct mad_decoder {
 			       struct mad_header const *, struct mad_pcm *);
   enum mad_flow (*error_func)(void *, struct mad_stream *, struct mad_frame *);
   enum mad_flow (*message_func)(void *, void *, unsigned int *);
+
+  struct mad_memory const *memory;	/* allocator (0 = malloc) */
 };
 
 void mad_decoder_init(struct mad_decoder *, void *,
@@ -85,6 +106,9 @@ int mad_decoder_finish(struct mad_decoder *);
 # define mad_decoder_options(decoder, opts)  \
     ((void) ((decoder)->options = (opts)))
 
+# define mad_decoder_memory(decoder, mem)  \
+    ((void) ((decoder)->memory = (mem)))
+
 int mad_decoder_run(struct mad_decoder *, enum mad_decoder_mode);
 int mad_decoder_message(struct mad_decoder *, void *, unsigned int *);
 
@@ -32,6 +32,7 @@
 #include "timer.h"
 #include "layer12.h"
 #include "layer3.h"
+#include "stats.h"
 
 static
 unsigned long const bitrate_table[5][15] = {
@@ -93,7 +94,16 @@ void mad_frame_init(struct mad_frame *frame)
 
   frame->options = 0;
 
-  frame->overlap = 0;
+  frame->overlap  = 0;
+  frame->granule  = 0;
+  frame->granules = 0;
+  frame->memory   = 0;
+
+  frame->spectrum_func = 0;
+  frame->spectrum_data = 0;
+
+  frame->bandwidth = 0;
+
   mad_frame_mute(frame);
 }
 
@@ -106,9 +116,14 @@ void mad_frame_finish(struct mad_frame *frame)
   mad_header_finish(&frame->header);
 
   if (frame->overlap) {
-    free(frame->overlap);
+    mad_memory_free(frame->memory, frame->overlap);
     frame->overlap = 0;
   }
+
+  if (frame->granules) {
+    mad_memory_free(frame->memory, frame->granules);
+    frame->granules = 0;
+  }
 }
 
 /*
@@ -447,12 +462,24 @@ int mad_frame_decode(struct mad_frame *frame, struct mad_stream *stream)
 {
   frame->options = stream->options;
 
+  /* complete a pending Layer III frame (granule mode) */
+
+  while (frame->granules && mad_layer_III_granule(stream, frame) == 1)
+    ;
+
   /* header() */
   /* error_check() */
 
-  if (!(frame->header.flags & MAD_FLAG_INCOMPLETE) &&
-      mad_header_decode(&frame->header, stream) == -1)
-    goto fail;
+  if (!(frame->header.flags & MAD_FLAG_INCOMPLETE)) {
+    int result;
+
+    MAD_STATS_ENTER(MAD_STAGE_HEADER);
+    result = mad_header_decode(&frame->header, stream);
+    MAD_STATS_LEAVE();
+
+    if (result == -1)
+      goto fail;
+  }
 
   /* audio_data() */
 
@@ -485,6 +512,26 @@ int mad_frame_decode(struct mad_frame *frame, struct mad_stream *stream)
   return -1;
 }
 
+/*
+ * NAME:	frame->decode_granule()
+ * DESCRIPTION:	decode the next granule of a Layer III frame into sbsample
+ *		when MAD_OPTION_GRANULES is set: returns 1 if a granule was
+ *		decoded and 0 if the frame is complete. A granule
+ *		which can not be decoded is muted and returned with
+ *		stream->error set, so that each frame provides all samples
+ *		once its first granule was decoded. The stream buffer must
+ *		not change before all granules are decoded.
+ */
+int mad_frame_decode_granule(struct mad_frame *frame, struct mad_stream *stream)
+{
+  if (frame->granules == 0)
+    return 0;
+
+  stream->error = MAD_ERROR_NONE;
+
+  return mad_layer_III_granule(stream, frame);
+}
+
 /*
  * NAME:	frame->mute()
  * DESCRIPTION:	zero all subband values so the frame becomes silent
@@ -509,3 +556,26 @@ void mad_frame_mute(struct mad_frame *frame)
     }
   }
 }
+
+/*
+ * NAME:	frame->sblimit()
+ * DESCRIPTION:	return the number of subbands which cover the bandwidth
+ */
+unsigned int mad_frame_sblimit(struct mad_frame const *frame)
+{
+  unsigned long samplerate = frame->header.samplerate;
+  unsigned long sblimit;
+
+  if (frame->bandwidth == 0 || samplerate == 0)
+    return 32;
+
+  /* each subband covers samplerate / 64 Hz */
+  sblimit = (frame->bandwidth * 64UL + samplerate - 1) / samplerate;
+
+  if (sblimit < 1)
+    sblimit = 1;
+  else if (sblimit > 32)
+    sblimit = 32;
+
+  return sblimit;
+}
@@ -64,6 +64,34 @@ struct mad_header {
   mad_timer_t duration;			/* audio playing time of frame */
 };
 
+struct mad_granules;
+
+extern unsigned long const mad_granules_size;
+
+struct mad_frame;
+
+struct mad_spectrum {
+  unsigned int gr;			/* granule of the frame */
+  unsigned int nch;			/* number of channels */
+
+  mad_fixed_t const (*xr)[576];		/* requantized lines after stereo */
+  unsigned char const *sfbwidth[2];	/* scalefactor band widths of xr */
+
+  unsigned char block_type[2];		/* 2 = short blocks (see below) */
+  unsigned char mixed_block[2];		/* long blocks in subbands 0-1 */
+};
+
+/*
+ * The spectrum function is called for each Layer III granule before the
+ * hybrid filterbank. Short block lines are ordered by band and window: each
+ * band width is listed 3 times in sfbwidth (which may be stored in PROGMEM).
+ * A nonzero result skips the IMDCT and overlap: the sbsample of the
+ * granule and the overlap are set to 0, so the granule is synthesized as
+ * silence and the next granule starts without overlap.
+ */
+typedef int (*mad_spectrum_func)(void *, struct mad_frame const *,
+				 struct mad_spectrum const *);
+
 struct mad_frame {
   struct mad_header header;		/* MPEG audio header */
 
@@ -71,6 +99,16 @@ struct mad_frame {
 
   mad_fixed_t sbsample[2][36][32];	/* synthesis subband filter samples */
   mad_fixed_t (*overlap)[2][32][18];	/* Layer III block overlap data */
+
+  unsigned int granule;			/* Layer III granule in sbsample */
+  struct mad_granules *granules;	/* pending Layer III granules */
+
+  struct mad_memory const *memory;	/* allocator (0 = malloc) */
+
+  mad_spectrum_func spectrum_func;	/* Layer III spectrum tap (0 = none) */
+  void *spectrum_data;			/* data of the spectrum function */
+
+  unsigned int bandwidth;		/* decoded bandwidth in Hz (0 = all) */
 };
 
 # define MAD_NCHANNELS(header)		((header)->mode ? 2 : 1)
@@ -78,6 +116,10 @@ struct mad_frame {
   ((header)->layer == MAD_LAYER_I ? 12 :  \
    (((header)->layer == MAD_LAYER_III &&  \
      ((header)->flags & MAD_FLAG_LSF_EXT)) ? 18 : 36))
+# define MAD_FRAME_NSBSAMPLES(frame)  \
+  ((((frame)->options & MAD_OPTION_GRANULES) &&  \
+    (frame)->header.layer == MAD_LAYER_III) ?  \
+   18 : MAD_NSBSAMPLES(&(frame)->header))
 
 enum {
   MAD_FLAG_NPRIVATE_III	= 0x0007,	/* number of Layer III private bits */
@@ -112,7 +154,20 @@ void mad_frame_init(struct mad_frame *);
 void mad_frame_finish(struct mad_frame *);
 
 int mad_frame_decode(struct mad_frame *, struct mad_stream *);
+int mad_frame_decode_granule(struct mad_frame *, struct mad_stream *);
 
 void mad_frame_mute(struct mad_frame *);
 
+unsigned int mad_frame_sblimit(struct mad_frame const *);
+
+# define mad_frame_memory(frame, mem)  \
+    ((void) ((frame)->memory = (mem)))
+
+# define mad_frame_spectrum(frame, func, data)  \
+    ((void) ((frame)->spectrum_func = (func),  \
+	     (frame)->spectrum_data = (data)))
+
+# define mad_frame_bandwidth(frame, hz)  \
+    ((void) ((frame)->bandwidth = (hz)))
+
 # endif
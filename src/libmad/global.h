@@ -42,8 +42,7 @@
 #  define OPT_SSO
 # endif
 
-# if defined(HAVE_UNISTD_H) && defined(HAVE_WAITPID) &&  \
-    defined(HAVE_FCNTL) && defined(HAVE_PIPE) && defined(HAVE_FORK)
+# if defined(HAVE_PTHREAD)
 #  define USE_ASYNC
 # endif
 
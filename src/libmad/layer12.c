@@ -97,6 +97,26 @@ mad_fixed_t I_sample(struct mad_bitptr *ptr, unsigned int nb)
   /* (to be performed by caller) */
 }
 
+/*
+ * NAME:	I_II_bandlimit()
+ * DESCRIPTION:	zero the subband samples above the decoded bandwidth
+ */
+static
+void I_II_bandlimit(struct mad_frame *frame, unsigned int ns)
+{
+  unsigned int nch, sblimit, ch, s, sb;
+
+  nch     = MAD_NCHANNELS(&frame->header);
+  sblimit = mad_frame_sblimit(frame);
+
+  for (ch = 0; ch < nch; ++ch) {
+    for (s = 0; s < ns; ++s) {
+      for (sb = sblimit; sb < 32; ++sb)
+	frame->sbsample[ch][s][sb] = 0;
+    }
+  }
+}
+
 /*
  * NAME:	layer->I()
  * DESCRIPTION:	decode a single Layer I frame
@@ -208,6 +228,9 @@ int mad_layer_I(struct mad_stream *stream, struct mad_frame *frame)
     }
   }
 
+  if (frame->bandwidth)
+    I_II_bandlimit(frame, 12);
+
   return 0;
 }
 
@@ -534,5 +557,8 @@ int mad_layer_II(struct mad_stream *stream, struct mad_frame *frame)
     }
   }
 
+  if (frame->bandwidth)
+    I_II_bandlimit(frame, 36);
+
   return 0;
 }
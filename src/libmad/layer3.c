@@ -44,6 +44,7 @@
 #include "frame.h"
 #include "huffman.h"
 #include "layer3.h"
+#include "stats.h"
 
 /* --- Layer III ----------------------------------------------------------- */
 
@@ -86,6 +87,20 @@ struct sideinfo {
   } gr[2];
 };
 
+struct mad_granules {
+  struct sideinfo si;			/* side info of the frame */
+  struct mad_bitptr ptr;		/* main_data of the next granule */
+  unsigned char const *next_frame;	/* end of the frame */
+
+  unsigned int nch, sfreqi;
+  unsigned int gr, ngr;			/* next granule, number of granules */
+
+  unsigned int main_data_begin, md_len, data_bitlen;
+  unsigned int frame_free, next_md_begin;
+};
+
+unsigned long const mad_granules_size = sizeof(struct mad_granules);
+
 /*
  * scalefactor bit lengths
  * derived from section 2.4.2.7 of ISO/IEC 11172-3
@@ -891,6 +906,8 @@ mad_fixed_t III_requantize(unsigned int value, signed int exp)
 #endif
   signed int frac;
 
+  MAD_STATS_COUNT(MAD_STAGE_REQUANTIZE);
+
   frac = exp % 4;  /* assumes sign(frac) == sign(exp) */
   exp /= 4;
 
@@ -921,7 +938,41 @@ mad_fixed_t III_requantize(unsigned int value, signed int exp)
       requantized <<= exp;
   }
 
-  return frac ? mad_f_mul(requantized, root_table[3 + frac]) : requantized;
+  if (frac)
+    requantized = mad_f_mul(requantized, root_table[3 + frac]);
+
+  return requantized;
+}
+
+/*
+ * NAME:	III_lines()
+ * DESCRIPTION:	return the number of frequency lines which cover sblimit
+ *		subbands
+ */
+static
+unsigned int III_lines(struct channel const *channel,
+		       unsigned char const *sfbwidth, unsigned int sblimit)
+{
+  unsigned int limit, lines;
+
+  limit = 18 * sblimit;
+  if (channel->block_type != 2 || limit >= 576)
+    return limit < 576 ? limit : 576;
+
+  /* short block lines are ordered by band and window */
+
+  lines = 0;
+  if (channel->flags & mixed_block_flag) {
+    while (lines < 36)
+      lines += *sfbwidth++;
+  }
+
+  while (lines < limit) {
+    lines    += 3 * *sfbwidth;
+    sfbwidth += 3;
+  }
+
+  return lines;
 }
 
 /* we must take care that sz >= bits and sz < sizeof(long) lest bits == 0 */
@@ -938,7 +989,7 @@ static
 enum mad_error III_huffdecode(struct mad_bitptr *ptr, mad_fixed_t xr[576],
 			      struct channel *channel,
 			      unsigned char const *sfbwidth,
-			      unsigned int part2_length)
+			      unsigned int part2_length, unsigned int lines)
 {
 #if MAD_STACK_HACK1 
   static signed int exponents[39];
@@ -950,7 +1001,7 @@ enum mad_error III_huffdecode(struct mad_bitptr *ptr, mad_fixed_t xr[576],
   struct mad_bitptr peek;
   signed int bits_left, cachesz;
   register mad_fixed_t *xrptr;
-  mad_fixed_t const *sfbound;
+  mad_fixed_t const *sfbound, *xrend;
   register unsigned long bitcache;
 
   bits_left = (signed) channel->part2_3_length - (signed) part2_length;
@@ -970,6 +1021,7 @@ enum mad_error III_huffdecode(struct mad_bitptr *ptr, mad_fixed_t xr[576],
   bits_left -= cachesz;
 
   xrptr = &xr[0];
+  xrend = &xr[lines];
 
   /* big_values */
   {
@@ -997,7 +1049,10 @@ enum mad_error III_huffdecode(struct mad_bitptr *ptr, mad_fixed_t xr[576],
     exp     = *expptr++;
     reqhits = 0;
 
+    /* the code words above the bandwidth are skipped with the granule */
     big_values = channel->big_values;
+    if (big_values > lines / 2)
+      big_values = lines / 2;
 
     while (big_values-- && cachesz + bits_left > 0) {
       union huffpair const *pair;
@@ -1180,7 +1235,7 @@ enum mad_error III_huffdecode(struct mad_bitptr *ptr, mad_fixed_t xr[576],
 
     requantized = III_requantize(1, exp);
 
-    while (cachesz + bits_left > 0 && xrptr <= &xr[572]) {
+    while (cachesz + bits_left > 0 && xrptr <= &xr[572] && xrptr < xrend) {
       union huffquad const *quad;
 
       /* hcod (1..6) */
@@ -2360,182 +2415,380 @@ void III_freqinver(mad_fixed_t sample[18][32], unsigned int sb)
 }
 
 /*
- * NAME:	III_decode()
- * DESCRIPTION:	decode frame main_data
+ * NAME:	III_sfreqi()
+ * DESCRIPTION:	return the sample frequency index of a frame
  */
 static
-enum mad_error III_decode(struct mad_bitptr *ptr, struct mad_frame *frame,
-			  struct sideinfo *si, unsigned int nch)
+unsigned int III_sfreqi(struct mad_header const *header)
 {
-  struct mad_header *header = &frame->header;
-  unsigned int sfreqi, ngr, gr;
+  unsigned int sfreq, sfreqi;
 
-  {
-    unsigned int sfreq;
+  sfreq = header->samplerate;
+  if (header->flags & MAD_FLAG_MPEG_2_5_EXT)
+    sfreq *= 2;
 
-    sfreq = header->samplerate;
-    if (header->flags & MAD_FLAG_MPEG_2_5_EXT)
-      sfreq *= 2;
+  /* 48000 => 0, 44100 => 1, 32000 => 2,
+     24000 => 3, 22050 => 4, 16000 => 5 */
+  sfreqi = ((sfreq >>  7) & 0x000f) +
+           ((sfreq >> 15) & 0x0001) - 8;
 
-    /* 48000 => 0, 44100 => 1, 32000 => 2,
-       24000 => 3, 22050 => 4, 16000 => 5 */
-    sfreqi = ((sfreq >>  7) & 0x000f) +
-             ((sfreq >> 15) & 0x0001) - 8;
+  if (header->flags & MAD_FLAG_MPEG_2_5_EXT)
+    sfreqi += 3;
 
-    if (header->flags & MAD_FLAG_MPEG_2_5_EXT)
-      sfreqi += 3;
-  }
-
-  /* scalefactors, Huffman decoding, requantization */
-
-  ngr = (header->flags & MAD_FLAG_LSF_EXT) ? 1 : 2;
+  return sfreqi;
+}
 
-  for (gr = 0; gr < ngr; ++gr) {
-    struct granule *granule = &si->gr[gr];
-    unsigned char const *sfbwidth[2];
+/*
+ * NAME:	III_decode_granule()
+ * DESCRIPTION:	decode the main_data of one granule into sbsample[ch][s..s+17]
+ */
+static
+enum mad_error III_decode_granule(struct mad_bitptr *ptr, struct mad_frame *frame,
+				  struct sideinfo *si, unsigned int nch,
+				  unsigned int sfreqi, unsigned int gr,
+				  unsigned int s)
+{
+  struct mad_header *header = &frame->header;
+  struct granule *granule = &si->gr[gr];
+  unsigned char const *sfbwidth[2];
 
 #if MAD_STACK_HACK 
-    static mad_fixed_t xr[2][576];
+  static mad_fixed_t xr[2][576];
 #else
-    mad_fixed_t xr[2][576];
+  mad_fixed_t xr[2][576];
 #endif
-    unsigned int ch;
-    enum mad_error error;
+  unsigned int ch, bandlimit;
+  enum mad_error error;
 
-    for (ch = 0; ch < nch; ++ch) {
-      struct channel *channel = &granule->ch[ch];
-      unsigned int part2_length;
+  bandlimit = mad_frame_sblimit(frame);
 
-      sfbwidth[ch] = sfbwidth_table[sfreqi].l;
-      if (channel->block_type == 2) {
-	sfbwidth[ch] = (channel->flags & mixed_block_flag) ?
-	  sfbwidth_table[sfreqi].m : sfbwidth_table[sfreqi].s;
-      }
+  /* scalefactors, Huffman decoding, requantization */
 
-      if (header->flags & MAD_FLAG_LSF_EXT) {
-	part2_length = III_scalefactors_lsf(ptr, channel,
-					    ch == 0 ? 0 : &si->gr[1].ch[1],
-					    header->mode_extension);
-      }
-      else {
-	part2_length = III_scalefactors(ptr, channel, &si->gr[0].ch[ch],
-					gr == 0 ? 0 : si->scfsi[ch]);
-      }
+  for (ch = 0; ch < nch; ++ch) {
+    struct channel *channel = &granule->ch[ch];
+    unsigned int part2_length, lines;
 
-      error = III_huffdecode(ptr, xr[ch], channel, sfbwidth[ch], part2_length);
-      if (error)
-	return error;
+    sfbwidth[ch] = sfbwidth_table[sfreqi].l;
+    if (channel->block_type == 2) {
+      sfbwidth[ch] = (channel->flags & mixed_block_flag) ?
+	sfbwidth_table[sfreqi].m : sfbwidth_table[sfreqi].s;
     }
 
-    /* joint stereo processing */
+    MAD_STATS_ENTER(MAD_STAGE_HUFFMAN);
 
-    if (header->mode == MAD_MODE_JOINT_STEREO && header->mode_extension) {
-      error = III_stereo(xr, granule, header, sfbwidth[0]);
-      if (error)
-	return error;
+    if (header->flags & MAD_FLAG_LSF_EXT) {
+      part2_length = III_scalefactors_lsf(ptr, channel,
+					  ch == 0 ? 0 : &si->gr[1].ch[1],
+					  header->mode_extension);
     }
+    else {
+      part2_length = III_scalefactors(ptr, channel, &si->gr[0].ch[ch],
+				      gr == 0 ? 0 : si->scfsi[ch]);
+    }
+
+    /* intensity stereo needs the zero lines of the right channel */
+    lines = 576;
+    if (ch == 0 || header->mode != MAD_MODE_JOINT_STEREO ||
+	!(header->mode_extension & I_STEREO))
+      lines = III_lines(channel, sfbwidth[ch], bandlimit);
+
+    error = III_huffdecode(ptr, xr[ch], channel, sfbwidth[ch], part2_length,
+			   lines);
+    MAD_STATS_LEAVE();
+    if (error)
+      return error;
+  }
+
+  /* joint stereo processing */
+
+  if (header->mode == MAD_MODE_JOINT_STEREO && header->mode_extension) {
+    MAD_STATS_ENTER(MAD_STAGE_STEREO);
+    error = III_stereo(xr, granule, header, sfbwidth[0]);
+    MAD_STATS_LEAVE();
+    if (error)
+      return error;
+  }
 
-    /* reordering, alias reduction, IMDCT, overlap-add, frequency inversion */
+  /* spectrum tap */
+
+  if (frame->spectrum_func) {
+    struct mad_spectrum spectrum;
+
+    spectrum.gr  = gr;
+    spectrum.nch = nch;
+    spectrum.xr  = (mad_fixed_t const (*)[576]) xr;
 
     for (ch = 0; ch < nch; ++ch) {
-      struct channel const *channel = &granule->ch[ch];
-      unsigned int sb, l, i, sblimit;
+      spectrum.sfbwidth[ch]    = sfbwidth[ch];
+      spectrum.block_type[ch]  = granule->ch[ch].block_type;
+      spectrum.mixed_block[ch] =
+	(granule->ch[ch].flags & mixed_block_flag) ? 1 : 0;
+    }
+
+    if (frame->spectrum_func(frame->spectrum_data, frame, &spectrum)) {
+      /* the skipped granule is silent and leaves no overlap, so that no
+	 stale data is synthesized now or added to the next granule */
+
+      for (ch = 0; ch < nch; ++ch) {
+	memset(&frame->sbsample[ch][s], 0, 18 * sizeof(frame->sbsample[ch][s]));
+	memset((*frame->overlap)[ch], 0, sizeof((*frame->overlap)[ch]));
+      }
+
+      return MAD_ERROR_NONE;
+    }
+  }
+
+  /* reordering, alias reduction, IMDCT, overlap-add, frequency inversion */
+
+  MAD_STATS_ENTER(MAD_STAGE_HYBRID);
+
+  for (ch = 0; ch < nch; ++ch) {
+    struct channel const *channel = &granule->ch[ch];
+    unsigned int sb, l, i, sblimit;
 #if MAD_STACK_HACK1 
-      static mad_fixed_t (*sample)[32];
-      static mad_fixed_t output[36];
-      sample = &frame->sbsample[ch][18 * gr];
+    static mad_fixed_t (*sample)[32];
+    static mad_fixed_t output[36];
+    sample = &frame->sbsample[ch][s];
 #else
-      mad_fixed_t (*sample)[32] = &frame->sbsample[ch][18 * gr];
-      mad_fixed_t output[36];
+    mad_fixed_t (*sample)[32] = &frame->sbsample[ch][s];
+    mad_fixed_t output[36];
 #endif
-      if (channel->block_type == 2) {
-	III_reorder(xr[ch], channel, sfbwidth[ch]);
+
+    /* silent granule: only the overlap of the previous granule remains */
+
+    if (channel->big_values == 0) {
+      i = 576;
+      while (i > 0 && xr[ch][i - 1] == 0)
+	--i;
+
+      if (i == 0) {
+	for (sb = 0; sb < 32; ++sb) {
+	  III_overlap_z((*frame->overlap)[ch][sb], sample, sb);
+
+	  if (sb & 1)
+	    III_freqinver(sample, sb);
+	}
+	continue;
+      }
+    }
+
+    if (channel->block_type == 2) {
+      III_reorder(xr[ch], channel, sfbwidth[ch]);
 
 # if !defined(OPT_STRICT)
-	/*
-	 * According to ISO/IEC 11172-3, "Alias reduction is not applied for
-	 * granules with block_type == 2 (short block)." However, other
-	 * sources suggest alias reduction should indeed be performed on the
-	 * lower two subbands of mixed blocks. Most other implementations do
-	 * this, so by default we will too.
-	 */
-	if (channel->flags & mixed_block_flag)
-	  III_aliasreduce(xr[ch], 36);
+      /*
+       * According to ISO/IEC 11172-3, "Alias reduction is not applied for
+       * granules with block_type == 2 (short block)." However, other
+       * sources suggest alias reduction should indeed be performed on the
+       * lower two subbands of mixed blocks. Most other implementations do
+       * this, so by default we will too.
+       */
+      if (channel->flags & mixed_block_flag)
+	III_aliasreduce(xr[ch], 36);
 # endif
-      }
-      else
-	III_aliasreduce(xr[ch], 576);
+    }
+    else {
+      /*
+       * The butterflies above the last nonzero line only see zeros, so we
+       * find it before the alias reduction, which spreads it by at most 8
+       * lines. The encoder low-pass typically leaves the top subbands empty.
+       */
+      i = 576;
+      while (i > 36 && xr[ch][i - 1] == 0)
+	--i;
 
-      l = 0;
+      if (i + 8 < 576)
+	i += 8;
 
-      /* subbands 0-1 */
+      III_aliasreduce(xr[ch], i);
+    }
 
-      if (channel->block_type != 2 || (channel->flags & mixed_block_flag)) {
-	unsigned int block_type;
+    l = 0;
 
-	block_type = channel->block_type;
-	if (channel->flags & mixed_block_flag)
-	  block_type = 0;
+    /* subbands 0-1 */
 
-	/* long blocks */
-	for (sb = 0; sb < 2; ++sb, l += 18) {
-	  III_imdct_l(&xr[ch][l], output, block_type);
-	  III_overlap(output, (*frame->overlap)[ch][sb], sample, sb);
-	}
+    if (channel->block_type != 2 || (channel->flags & mixed_block_flag)) {
+      unsigned int block_type;
+
+      block_type = channel->block_type;
+      if (channel->flags & mixed_block_flag)
+	block_type = 0;
+
+      /* long blocks */
+      for (sb = 0; sb < 2; ++sb, l += 18) {
+	III_imdct_l(&xr[ch][l], output, block_type);
+	III_overlap(output, (*frame->overlap)[ch][sb], sample, sb);
       }
-      else {
-	/* short blocks */
-	for (sb = 0; sb < 2; ++sb, l += 18) {
-	  III_imdct_s(&xr[ch][l], output);
-	  III_overlap(output, (*frame->overlap)[ch][sb], sample, sb);
-	}
+    }
+    else {
+      /* short blocks */
+      for (sb = 0; sb < 2; ++sb, l += 18) {
+	III_imdct_s(&xr[ch][l], output);
+	III_overlap(output, (*frame->overlap)[ch][sb], sample, sb);
       }
+    }
 
-      III_freqinver(sample, 1);
+    III_freqinver(sample, 1);
 
-      /* (nonzero) subbands 2-31 */
+    /* (nonzero) subbands 2-31: the IMDCT of zero lines only adds zeros */
 
+    if (channel->block_type == 2) {
       i = 576;
       while (i > 36 && xr[ch][i - 1] == 0)
 	--i;
+    }
 
-      sblimit = 32 - (576 - i) / 18;
+    sblimit = 32 - (576 - i) / 18;
+    if (sblimit > bandlimit)
+      sblimit = bandlimit;
 
-      if (channel->block_type != 2) {
-	/* long blocks */
-	for (sb = 2; sb < sblimit; ++sb, l += 18) {
-	  III_imdct_l(&xr[ch][l], output, channel->block_type);
-	  III_overlap(output, (*frame->overlap)[ch][sb], sample, sb);
+    if (channel->block_type != 2) {
+      /* long blocks */
+      for (sb = 2; sb < sblimit; ++sb, l += 18) {
+	III_imdct_l(&xr[ch][l], output, channel->block_type);
+	III_overlap(output, (*frame->overlap)[ch][sb], sample, sb);
 
-	  if (sb & 1)
-	    III_freqinver(sample, sb);
-	}
+	if (sb & 1)
+	  III_freqinver(sample, sb);
       }
-      else {
-	/* short blocks */
-	for (sb = 2; sb < sblimit; ++sb, l += 18) {
-	  III_imdct_s(&xr[ch][l], output);
-	  III_overlap(output, (*frame->overlap)[ch][sb], sample, sb);
+    }
+    else {
+      /* short blocks */
+      for (sb = 2; sb < sblimit; ++sb, l += 18) {
+	III_imdct_s(&xr[ch][l], output);
+	III_overlap(output, (*frame->overlap)[ch][sb], sample, sb);
 
-	  if (sb & 1)
-	    III_freqinver(sample, sb);
-	}
+	if (sb & 1)
+	  III_freqinver(sample, sb);
       }
+    }
 
-      /* remaining (zero) subbands */
+    /* remaining (zero) subbands */
 
-      for (sb = sblimit; sb < 32; ++sb) {
-	III_overlap_z((*frame->overlap)[ch][sb], sample, sb);
+    for (sb = sblimit; sb < 32; ++sb) {
+      III_overlap_z((*frame->overlap)[ch][sb], sample, sb);
 
-	if (sb & 1)
-	  III_freqinver(sample, sb);
-      }
+      if (sb & 1)
+	III_freqinver(sample, sb);
     }
   }
 
+  MAD_STATS_LEAVE();
+
   return MAD_ERROR_NONE;
 }
 
+/*
+ * NAME:	III_decode()
+ * DESCRIPTION:	decode frame main_data
+ */
+static
+enum mad_error III_decode(struct mad_bitptr *ptr, struct mad_frame *frame,
+			  struct sideinfo *si, unsigned int nch)
+{
+  struct mad_header *header = &frame->header;
+  unsigned int sfreqi, ngr, gr;
+  enum mad_error error;
+
+  sfreqi = III_sfreqi(header);
+  ngr = (header->flags & MAD_FLAG_LSF_EXT) ? 1 : 2;
+
+  for (gr = 0; gr < ngr; ++gr) {
+    error = III_decode_granule(ptr, frame, si, nch, sfreqi, gr, 18 * gr);
+    if (error)
+      return error;
+  }
+
+  return MAD_ERROR_NONE;
+}
+
+/*
+ * NAME:	III_preload()
+ * DESCRIPTION:	preload main_data buffer with up to 511 bytes for next frame(s)
+ */
+static
+void III_preload(struct mad_stream *stream, unsigned char const *next_frame,
+		 unsigned int main_data_begin, unsigned int md_len,
+		 unsigned int frame_free, unsigned int next_md_begin)
+{
+  if (frame_free >= next_md_begin) {
+    memcpy(*stream->main_data,
+	   next_frame - next_md_begin, next_md_begin);
+    stream->md_len = next_md_begin;
+  }
+  else {
+    if (md_len < main_data_begin) {
+      unsigned int extra;
+
+      extra = main_data_begin - md_len;
+      if (extra + frame_free > next_md_begin)
+	extra = next_md_begin - frame_free;
+
+      if (extra < stream->md_len) {
+	memmove(*stream->main_data,
+		*stream->main_data + stream->md_len - extra, extra);
+	stream->md_len = extra;
+      }
+    }
+    else
+      stream->md_len = 0;
+
+    memcpy(*stream->main_data + stream->md_len,
+	   next_frame - frame_free, frame_free);
+    stream->md_len += frame_free;
+  }
+}
+
+/*
+ * NAME:	III_granule()
+ * DESCRIPTION:	decode the next pending granule into sbsample[ch][0..17]
+ */
+static
+int III_granule(struct mad_stream *stream, struct mad_frame *frame)
+{
+  struct mad_granules *granules = frame->granules;
+  enum mad_error error;
+
+  error = III_decode_granule(&granules->ptr, frame, &granules->si,
+			     granules->nch, granules->sfreqi, granules->gr, 0);
+
+  frame->granule = granules->gr++;
+  if (error)
+    granules->gr = granules->ngr;
+
+  if (granules->gr == granules->ngr) {
+    /* designate ancillary bits */
+
+    stream->anc_ptr    = granules->ptr;
+    stream->anc_bitlen = granules->md_len * CHAR_BIT - granules->data_bitlen;
+
+    III_preload(stream, granules->next_frame, granules->main_data_begin,
+		granules->md_len, granules->frame_free, granules->next_md_begin);
+  }
+
+  if (error) {
+    stream->error = error;
+
+    /* the first granule fails like the whole frame: a later granule is
+       muted, so that the frame keeps its length */
+
+    if (frame->granule > 0) {
+      unsigned int ch, s;
+
+      for (ch = 0; ch < 2; ++ch) {
+	for (s = 0; s < 18; ++s)
+	  memset(frame->sbsample[ch][s], 0, sizeof(frame->sbsample[ch][s]));
+      }
+
+      return 0;
+    }
+
+    return -1;
+  }
+
+  return 0;
+}
+
 /*
  * NAME:	layer->III()
  * DESCRIPTION:	decode a single Layer III frame
@@ -2558,7 +2811,7 @@ int mad_layer_III(struct mad_stream *stream, struct mad_frame *frame)
   /* allocate Layer III dynamic structures */
 
   if (stream->main_data == 0) {
-    stream->main_data = malloc(MAD_BUFFER_MDLEN);
+    stream->main_data = mad_memory_alloc(stream->memory, MAD_BUFFER_MDLEN);
     if (stream->main_data == 0) {
       stream->error = MAD_ERROR_NOMEM;
       return -1;
@@ -2566,13 +2819,23 @@ int mad_layer_III(struct mad_stream *stream, struct mad_frame *frame)
   }
 
   if (frame->overlap == 0) {
-    frame->overlap = calloc(2 * 32 * 18, sizeof(mad_fixed_t));
+    frame->overlap = mad_memory_alloc(frame->memory,
+				      2 * 32 * 18 * sizeof(mad_fixed_t));
     if (frame->overlap == 0) {
       stream->error = MAD_ERROR_NOMEM;
       return -1;
     }
   }
 
+  if ((frame->options & MAD_OPTION_GRANULES) && frame->granules == 0) {
+    frame->granules = mad_memory_alloc(frame->memory,
+				       sizeof(struct mad_granules));
+    if (frame->granules == 0) {
+      stream->error = MAD_ERROR_NOMEM;
+      return -1;
+    }
+  }
+
   nch = MAD_NCHANNELS(header);
   si_len = (header->flags & MAD_FLAG_LSF_EXT) ?
     (nch == 1 ? 9 : 17) : (nch == 1 ? 17 : 32);
@@ -2601,8 +2864,10 @@ int mad_layer_III(struct mad_stream *stream, struct mad_frame *frame)
 
   /* decode frame side information */
 
+  MAD_STATS_ENTER(MAD_STAGE_SIDEINFO);
   error = III_sideinfo(&stream->ptr, nch, header->flags & MAD_FLAG_LSF_EXT,
 		       &si, &data_bitlen, &priv_bitlen);
+  MAD_STATS_LEAVE();
   if (error && result == 0) {
     stream->error = error;
     result = -1;
@@ -2675,6 +2940,27 @@ int mad_layer_III(struct mad_stream *stream, struct mad_frame *frame)
 
   /* decode main_data */
 
+  if (result == 0 && (frame->options & MAD_OPTION_GRANULES)) {
+    struct mad_granules *granules = frame->granules;
+
+    granules->si              = si;
+    granules->ptr             = ptr;
+    granules->next_frame      = stream->next_frame;
+    granules->nch             = nch;
+    granules->sfreqi          = III_sfreqi(header);
+    granules->gr              = 0;
+    granules->ngr             = (header->flags & MAD_FLAG_LSF_EXT) ? 1 : 2;
+    granules->main_data_begin = si.main_data_begin;
+    granules->md_len          = md_len;
+    granules->data_bitlen     = data_bitlen;
+    granules->frame_free      = frame_free;
+    granules->next_md_begin   = next_md_begin;
+
+    /* the main_data buffer is preloaded after the last granule */
+
+    return III_granule(stream, frame);
+  }
+
   if (result == 0) {
     error = III_decode(&ptr, frame, &si, nch);
     if (error) {
@@ -2698,32 +2984,22 @@ int mad_layer_III(struct mad_stream *stream, struct mad_frame *frame)
 
   /* preload main_data buffer with up to 511 bytes for next frame(s) */
 
-  if (frame_free >= next_md_begin) {
-    memcpy(*stream->main_data,
-	   stream->next_frame - next_md_begin, next_md_begin);
-    stream->md_len = next_md_begin;
-  }
-  else {
-    if (md_len < si.main_data_begin) {
-      unsigned int extra;
+  III_preload(stream, stream->next_frame, si.main_data_begin, md_len,
+	      frame_free, next_md_begin);
 
-      extra = si.main_data_begin - md_len;
-      if (extra + frame_free > next_md_begin)
-	extra = next_md_begin - frame_free;
+  return result;
+}
 
-      if (extra < stream->md_len) {
-	memmove(*stream->main_data,
-		*stream->main_data + stream->md_len - extra, extra);
-	stream->md_len = extra;
-      }
-    }
-    else
-      stream->md_len = 0;
+/*
+ * NAME:	layer->III_granule()
+ * DESCRIPTION:	decode the next pending granule of a Layer III frame
+ */
+int mad_layer_III_granule(struct mad_stream *stream, struct mad_frame *frame)
+{
+  struct mad_granules *granules = frame->granules;
 
-    memcpy(*stream->main_data + stream->md_len,
-	   stream->next_frame - frame_free, frame_free);
-    stream->md_len += frame_free;
-  }
+  if (granules == 0 || granules->gr == granules->ngr)
+    return 0;
 
-  return result;
+  return III_granule(stream, frame) == -1 ? -1 : 1;
 }
@@ -26,5 +26,6 @@
 #include "frame.h"
 
 int mad_layer_III(struct mad_stream *, struct mad_frame *);
+int mad_layer_III_granule(struct mad_stream *, struct mad_frame *);
 
 # endif
@@ -692,6 +692,12 @@ enum mad_error {
 
 # define MAD_RECOVERABLE(error)	((error) & 0xff00)
 
+struct mad_memory {
+  void *(*alloc_func)(void *, unsigned long);	/* allocate memory */
+  void (*free_func)(void *, void *);		/* release memory */
+  void *data;					/* allocator state */
+};
+
 struct mad_stream {
   unsigned char const *buffer;		/* input bitstream buffer */
   unsigned char const *bufend;		/* end of buffer */
@@ -713,11 +719,14 @@ struct mad_stream {
 
   int options;				/* decoding options (see below) */
   enum mad_error error;			/* error code (see above) */
+
+  struct mad_memory const *memory;	/* allocator (0 = malloc) */
 };
 
 enum {
   MAD_OPTION_IGNORECRC      = 0x0001,	/* ignore CRC errors */
-  MAD_OPTION_HALFSAMPLERATE = 0x0002	/* generate PCM at 1/2 sample rate */
+  MAD_OPTION_HALFSAMPLERATE = 0x0002,	/* generate PCM at 1/2 sample rate */
+  MAD_OPTION_GRANULES       = 0x0004	/* decode Layer III granule by granule */
 # if 0  /* not yet implemented */
   MAD_OPTION_LEFTCHANNEL    = 0x0010,	/* decode left channel only */
   MAD_OPTION_RIGHTCHANNEL   = 0x0020,	/* decode right channel only */
@@ -731,6 +740,9 @@ void mad_stream_finish(struct mad_stream *);
 # define mad_stream_options(stream, opts)  \
     ((void) ((stream)->options = (opts)))
 
+# define mad_stream_memory(stream, mem)  \
+    ((void) ((stream)->memory = (mem)))
+
 void mad_stream_buffer(struct mad_stream *,
 		       unsigned char const *, unsigned long);
 void mad_stream_skip(struct mad_stream *, unsigned long);
@@ -739,6 +751,9 @@ int mad_stream_sync(struct mad_stream *);
 
 char const *mad_stream_errorstr(struct mad_stream const *);
 
+void *mad_memory_alloc(struct mad_memory const *, unsigned long);
+void mad_memory_free(struct mad_memory const *, void *);
+
 # endif
 
 /* Id: frame.h,v 1.20 2004/01/23 09:41:32 rob Exp */
@@ -785,6 +800,34 @@ struct mad_header {
   mad_timer_t duration;			/* audio playing time of frame */
 };
 
+struct mad_granules;
+
+extern unsigned long const mad_granules_size;
+
+struct mad_frame;
+
+struct mad_spectrum {
+  unsigned int gr;			/* granule of the frame */
+  unsigned int nch;			/* number of channels */
+
+  mad_fixed_t const (*xr)[576];		/* requantized lines after stereo */
+  unsigned char const *sfbwidth[2];	/* scalefactor band widths of xr */
+
+  unsigned char block_type[2];		/* 2 = short blocks (see below) */
+  unsigned char mixed_block[2];		/* long blocks in subbands 0-1 */
+};
+
+/*
+ * The spectrum function is called for each Layer III granule before the
+ * hybrid filterbank. Short block lines are ordered by band and window: each
+ * band width is listed 3 times in sfbwidth (which may be stored in PROGMEM).
+ * A nonzero result skips the IMDCT and overlap: the sbsample of the
+ * granule and the overlap are set to 0, so the granule is synthesized as
+ * silence and the next granule starts without overlap.
+ */
+typedef int (*mad_spectrum_func)(void *, struct mad_frame const *,
+				 struct mad_spectrum const *);
+
 struct mad_frame {
   struct mad_header header;		/* MPEG audio header */
 
@@ -792,6 +835,16 @@ struct mad_frame {
 
   mad_fixed_t sbsample[2][36][32];	/* synthesis subband filter samples */
   mad_fixed_t (*overlap)[2][32][18];	/* Layer III block overlap data */
+
+  unsigned int granule;			/* Layer III granule in sbsample */
+  struct mad_granules *granules;	/* pending Layer III granules */
+
+  struct mad_memory const *memory;	/* allocator (0 = malloc) */
+
+  mad_spectrum_func spectrum_func;	/* Layer III spectrum tap (0 = none) */
+  void *spectrum_data;			/* data of the spectrum function */
+
+  unsigned int bandwidth;		/* decoded bandwidth in Hz (0 = all) */
 };
 
 # define MAD_NCHANNELS(header)		((header)->mode ? 2 : 1)
@@ -799,6 +852,10 @@ struct mad_frame {
   ((header)->layer == MAD_LAYER_I ? 12 :  \
    (((header)->layer == MAD_LAYER_III &&  \
      ((header)->flags & MAD_FLAG_LSF_EXT)) ? 18 : 36))
+# define MAD_FRAME_NSBSAMPLES(frame)  \
+  ((((frame)->options & MAD_OPTION_GRANULES) &&  \
+    (frame)->header.layer == MAD_LAYER_III) ?  \
+   18 : MAD_NSBSAMPLES(&(frame)->header))
 
 enum {
   MAD_FLAG_NPRIVATE_III	= 0x0007,	/* number of Layer III private bits */
@@ -833,9 +890,22 @@ void mad_frame_init(struct mad_frame *);
 void mad_frame_finish(struct mad_frame *);
 
 int mad_frame_decode(struct mad_frame *, struct mad_stream *);
+int mad_frame_decode_granule(struct mad_frame *, struct mad_stream *);
 
 void mad_frame_mute(struct mad_frame *);
 
+unsigned int mad_frame_sblimit(struct mad_frame const *);
+
+# define mad_frame_memory(frame, mem)  \
+    ((void) ((frame)->memory = (mem)))
+
+# define mad_frame_spectrum(frame, func, data)  \
+    ((void) ((frame)->spectrum_func = (func),  \
+	     (frame)->spectrum_data = (data)))
+
+# define mad_frame_bandwidth(frame, hz)  \
+    ((void) ((frame)->bandwidth = (hz)))
+
 # endif
 
 /* Id: synth.h,v 1.15 2004/01/23 09:41:33 rob Exp */
@@ -857,7 +927,11 @@ struct mad_synth {
 
   unsigned int phase;			/* current processing phase */
 
+  unsigned int zero_slots[2];		/* slots w/o subband samples */
+
+# if !defined(MAD_SYNTH_NO_PCM)
   struct mad_pcm pcm;			/* PCM output */
+# endif
 };
 
 /* single channel PCM selector */
@@ -883,7 +957,13 @@ void mad_synth_init(struct mad_synth *);
 
 void mad_synth_mute(struct mad_synth *);
 
+# if !defined(MAD_SYNTH_NO_PCM)
 void mad_synth_frame(struct mad_synth *, struct mad_frame const *);
+# endif
+
+void mad_synth_frame_slots(struct mad_synth *, struct mad_frame const *,
+			   void (*)(void *, unsigned int, unsigned int,
+				    mad_fixed_t const [2][32]), void *);
 
 # endif
 
@@ -902,7 +982,19 @@ enum mad_flow {
   MAD_FLOW_CONTINUE = 0x0000,	/* continue normally */
   MAD_FLOW_STOP     = 0x0010,	/* stop decoding normally */
   MAD_FLOW_BREAK    = 0x0011,	/* stop decoding and signal an error */
-  MAD_FLOW_IGNORE   = 0x0020	/* ignore the current frame */
+  MAD_FLOW_IGNORE   = 0x0020,	/* ignore the current frame */
+  MAD_FLOW_PAUSE    = 0x0030	/* wait for the next message (async),
+				   continue normally (sync) */
+};
+
+# if !defined(MAD_DECODER_QUEUE)
+#  define MAD_DECODER_QUEUE  4
+# endif
+
+struct mad_decoder_command {
+  void *message;			/* message, replaced by the reply */
+  unsigned int *len;			/* message and reply length */
+  unsigned int done;			/* the reply is available */
 };
 
 struct mad_decoder {
@@ -911,15 +1003,22 @@ struct mad_decoder {
   int options;
 
   struct {
-    long pid;
-    int in;
-    int out;
+    void *thread;			/* decoder thread */
+    int result;				/* result of the decoder thread */
+    unsigned int stop;			/* mad_decoder_finish() was called */
+    unsigned int finished;		/* the decoder thread has ended */
+    unsigned int head;			/* number of sent commands */
+    unsigned int tail;			/* number of processed commands */
+    struct mad_decoder_command queue[MAD_DECODER_QUEUE];
   } async;
 
   struct {
     struct mad_stream stream;
     struct mad_frame frame;
     struct mad_synth synth;
+# if defined(MAD_SYNTH_NO_PCM)
+    struct mad_pcm pcm;
+# endif
   } *sync;
 
   void *cb_data;
@@ -932,6 +1031,8 @@ struct mad_decoder {
 			       struct mad_header const *, struct mad_pcm *);
   enum mad_flow (*error_func)(void *, struct mad_stream *, struct mad_frame *);
   enum mad_flow (*message_func)(void *, void *, unsigned int *);
+
+  struct mad_memory const *memory;	/* allocator (0 = malloc) */
 };
 
 void mad_decoder_init(struct mad_decoder *, void *,
@@ -952,11 +1053,67 @@ int mad_decoder_finish(struct mad_decoder *);
 # define mad_decoder_options(decoder, opts)  \
     ((void) ((decoder)->options = (opts)))
 
+# define mad_decoder_memory(decoder, mem)  \
+    ((void) ((decoder)->memory = (mem)))
+
 int mad_decoder_run(struct mad_decoder *, enum mad_decoder_mode);
 int mad_decoder_message(struct mad_decoder *, void *, unsigned int *);
 
 # endif
 
+/* stats.h */
+
+# ifndef LIBMAD_STATS_H
+# define LIBMAD_STATS_H
+
+enum mad_stage {
+  MAD_STAGE_HEADER = 0,			/* header decoding */
+  MAD_STAGE_SIDEINFO,			/* Layer III side information */
+  MAD_STAGE_HUFFMAN,			/* scalefactors and Huffman decoding */
+  MAD_STAGE_REQUANTIZE,			/* requantization (counted only: the
+					   time is part of huffman) */
+  MAD_STAGE_STEREO,			/* joint stereo processing */
+  MAD_STAGE_HYBRID,			/* alias reduction, IMDCT, overlap-add */
+  MAD_STAGE_DCT32,			/* polyphase matrixing */
+  MAD_STAGE_WINDOW,			/* synthesis window */
+  MAD_STAGE_PCM,			/* conversion to the output format */
+  MAD_STAGE_OUTPUT,			/* output callbacks */
+  MAD_STAGE_COUNT
+};
+
+# define MAD_STATS_DEPTH  8
+
+struct mad_stats {
+  unsigned long long ticks[MAD_STAGE_COUNT];	/* exclusive clock ticks */
+  unsigned long calls[MAD_STAGE_COUNT];		/* number of invocations */
+
+  unsigned long long last;		/* clock at the last stage change */
+  unsigned int depth;			/* number of active stages */
+  unsigned char stack[MAD_STATS_DEPTH];	/* active stages */
+};
+
+void mad_stats_init(struct mad_stats *);
+struct mad_stats *mad_stats_select(struct mad_stats *);
+
+void mad_stats_enter(enum mad_stage);
+void mad_stats_leave(void);
+void mad_stats_count(enum mad_stage);
+
+char const *mad_stats_name(enum mad_stage);
+char const *mad_stats_clock(void);
+
+# if defined(MAD_STATS)
+#  define MAD_STATS_ENTER(stage)	mad_stats_enter(stage)
+#  define MAD_STATS_LEAVE()		mad_stats_leave()
+#  define MAD_STATS_COUNT(stage)	mad_stats_count(stage)
+# else
+#  define MAD_STATS_ENTER(stage)	/* nothing */
+#  define MAD_STATS_LEAVE()		/* nothing */
+#  define MAD_STATS_COUNT(stage)	/* nothing */
+# endif
+
+# endif
+
 # ifdef __cplusplus
 }
 # endif
@@ -0,0 +1,181 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "config.h"
+
+#include "global.h"
+
+#include <string.h>
+
+#include "stats.h"
+
+/* clock which is used to measure the stages (can be defined externally) */
+
+# if defined(MAD_STATS_CLOCK)
+# elif defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+#  define MAD_STATS_CLOCK()		__rdtsc()
+#  define MAD_STATS_CLOCK_NAME		"rdtsc"
+# elif defined(ARDUINO)
+#  include <Arduino.h>
+#  define MAD_STATS_CLOCK()		micros()
+#  define MAD_STATS_CLOCK_NAME		"us"
+# else
+#  include <time.h>
+static
+unsigned long long clock_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#  define MAD_STATS_CLOCK()		clock_ns()
+#  define MAD_STATS_CLOCK_NAME		"ns"
+# endif
+
+# if !defined(MAD_STATS_CLOCK_NAME)
+#  define MAD_STATS_CLOCK_NAME		"ticks"
+# endif
+
+/* the statistics of the decoder which is running in the actual thread */
+
+# if defined(__GNUC__) && !defined(ARDUINO_ARCH_AVR)
+#  define MAD_STATS_TLS  __thread
+# else
+#  define MAD_STATS_TLS
+# endif
+
+static MAD_STATS_TLS struct mad_stats *current;
+
+static
+char const *const names[MAD_STAGE_COUNT] = {
+  "header", "sideinfo", "huffman", "requantize", "stereo",
+  "hybrid", "dct32", "window", "pcm", "output"
+};
+
+/*
+ * NAME:	stats->init()
+ * DESCRIPTION:	reset all counters
+ */
+void mad_stats_init(struct mad_stats *stats)
+{
+  memset(stats, 0, sizeof(*stats));
+}
+
+/*
+ * NAME:	stats->select()
+ * DESCRIPTION:	define the statistics which are updated by the actual thread;
+ *		returns the previous selection
+ */
+struct mad_stats *mad_stats_select(struct mad_stats *stats)
+{
+  struct mad_stats *previous = current;
+
+  current = stats;
+
+  return previous;
+}
+
+/*
+ * NAME:	stats->enter()
+ * DESCRIPTION:	start a (nested) stage: the time up to now is charged to
+ *		the active stage
+ */
+void mad_stats_enter(enum mad_stage stage)
+{
+  struct mad_stats *stats = current;
+  unsigned long long now;
+
+  if (stats == 0)
+    return;
+
+  now = MAD_STATS_CLOCK();
+
+  if (stats->depth > 0) {
+    unsigned int top = stats->depth < MAD_STATS_DEPTH ?
+      stats->depth : MAD_STATS_DEPTH;
+
+    stats->ticks[stats->stack[top - 1]] += now - stats->last;
+  }
+
+  if (stats->depth < MAD_STATS_DEPTH)
+    stats->stack[stats->depth] = stage;
+
+  ++stats->depth;
+  ++stats->calls[stage];
+
+  stats->last = now;
+}
+
+/*
+ * NAME:	stats->leave()
+ * DESCRIPTION:	end the active stage
+ */
+void mad_stats_leave(void)
+{
+  struct mad_stats *stats = current;
+  unsigned long long now;
+  unsigned int top;
+
+  if (stats == 0 || stats->depth == 0)
+    return;
+
+  now = MAD_STATS_CLOCK();
+
+  top = stats->depth < MAD_STATS_DEPTH ? stats->depth : MAD_STATS_DEPTH;
+  stats->ticks[stats->stack[top - 1]] += now - stats->last;
+
+  --stats->depth;
+
+  stats->last = now;
+}
+
+/*
+ * NAME:	stats->count()
+ * DESCRIPTION:	count an invocation w/o measuring the time: used for small
+ *		functions where reading the clock costs more than the work
+ */
+void mad_stats_count(enum mad_stage stage)
+{
+  struct mad_stats *stats = current;
+
+  if (stats == 0)
+    return;
+
+  ++stats->calls[stage];
+}
+
+/*
+ * NAME:	stats->name()
+ * DESCRIPTION:	return the name of a stage
+ */
+char const *mad_stats_name(enum mad_stage stage)
+{
+  return stage < MAD_STAGE_COUNT ? names[stage] : "";
+}
+
+/*
+ * NAME:	stats->clock()
+ * DESCRIPTION:	return the unit of the measured ticks
+ */
+char const *mad_stats_clock(void)
+{
+  return MAD_STATS_CLOCK_NAME;
+}
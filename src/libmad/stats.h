@@ -0,0 +1,69 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+# ifndef LIBMAD_STATS_H
+# define LIBMAD_STATS_H
+
+enum mad_stage {
+  MAD_STAGE_HEADER = 0,			/* header decoding */
+  MAD_STAGE_SIDEINFO,			/* Layer III side information */
+  MAD_STAGE_HUFFMAN,			/* scalefactors and Huffman decoding */
+  MAD_STAGE_REQUANTIZE,			/* requantization (counted only: the
+					   time is part of huffman) */
+  MAD_STAGE_STEREO,			/* joint stereo processing */
+  MAD_STAGE_HYBRID,			/* alias reduction, IMDCT, overlap-add */
+  MAD_STAGE_DCT32,			/* polyphase matrixing */
+  MAD_STAGE_WINDOW,			/* synthesis window */
+  MAD_STAGE_PCM,			/* conversion to the output format */
+  MAD_STAGE_OUTPUT,			/* output callbacks */
+  MAD_STAGE_COUNT
+};
+
+# define MAD_STATS_DEPTH  8
+
+struct mad_stats {
+  unsigned long long ticks[MAD_STAGE_COUNT];	/* exclusive clock ticks */
+  unsigned long calls[MAD_STAGE_COUNT];		/* number of invocations */
+
+  unsigned long long last;		/* clock at the last stage change */
+  unsigned int depth;			/* number of active stages */
+  unsigned char stack[MAD_STATS_DEPTH];	/* active stages */
+};
+
+void mad_stats_init(struct mad_stats *);
+struct mad_stats *mad_stats_select(struct mad_stats *);
+
+void mad_stats_enter(enum mad_stage);
+void mad_stats_leave(void);
+void mad_stats_count(enum mad_stage);
+
+char const *mad_stats_name(enum mad_stage);
+char const *mad_stats_clock(void);
+
+# if defined(MAD_STATS)
+#  define MAD_STATS_ENTER(stage)	mad_stats_enter(stage)
+#  define MAD_STATS_LEAVE()		mad_stats_leave()
+#  define MAD_STATS_COUNT(stage)	mad_stats_count(stage)
+# else
+#  define MAD_STATS_ENTER(stage)	/* nothing */
+#  define MAD_STATS_LEAVE()		/* nothing */
+#  define MAD_STATS_COUNT(stage)	/* nothing */
+# endif
+
+# endif
@@ -26,6 +26,7 @@
 #include "global.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "bit.h"
 #include "stream.h"
@@ -55,6 +56,8 @@ void mad_stream_init(struct mad_stream *stream)
 
   stream->options    = 0;
   stream->error      = MAD_ERROR_NONE;
+
+  stream->memory     = 0;
 }
 
 /*
@@ -64,7 +67,7 @@ void mad_stream_init(struct mad_stream *stream)
 void mad_stream_finish(struct mad_stream *stream)
 {
   if (stream->main_data) {
-    free(stream->main_data);
+    mad_memory_free(stream->memory, stream->main_data);
     stream->main_data = 0;
   }
 
@@ -159,3 +162,36 @@ char const *mad_stream_errorstr(struct mad_stream const *stream)
 
   return 0;
 }
+
+/*
+ * NAME:	memory->alloc()
+ * DESCRIPTION:	allocate zeroed memory with the given allocator or malloc()
+ */
+void *mad_memory_alloc(struct mad_memory const *memory, unsigned long size)
+{
+  void *ptr;
+
+  if (memory && memory->alloc_func)
+    ptr = memory->alloc_func(memory->data, size);
+  else
+    ptr = malloc(size);
+
+  if (ptr)
+    memset(ptr, 0, size);
+
+  return ptr;
+}
+
+/*
+ * NAME:	memory->free()
+ * DESCRIPTION:	release memory which was allocated with memory->alloc()
+ */
+void mad_memory_free(struct mad_memory const *memory, void *ptr)
+{
+  if (memory && memory->alloc_func) {
+    if (memory->free_func)
+      memory->free_func(memory->data, ptr);
+  }
+  else
+    free(ptr);
+}
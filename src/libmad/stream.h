@@ -58,6 +58,12 @@ enum mad_error {
 
 # define MAD_RECOVERABLE(error)	((error) & 0xff00)
 
+struct mad_memory {
+  void *(*alloc_func)(void *, unsigned long);	/* allocate memory */
+  void (*free_func)(void *, void *);		/* release memory */
+  void *data;					/* allocator state */
+};
+
 struct mad_stream {
   unsigned char const *buffer;		/* input bitstream buffer */
   unsigned char const *bufend;		/* end of buffer */
@@ -79,11 +85,14 @@ struct mad_stream {
 
   int options;				/* decoding options (see below) */
   enum mad_error error;			/* error code (see above) */
+
+  struct mad_memory const *memory;	/* allocator (0 = malloc) */
 };
 
 enum {
   MAD_OPTION_IGNORECRC      = 0x0001,	/* ignore CRC errors */
-  MAD_OPTION_HALFSAMPLERATE = 0x0002	/* generate PCM at 1/2 sample rate */
+  MAD_OPTION_HALFSAMPLERATE = 0x0002,	/* generate PCM at 1/2 sample rate */
+  MAD_OPTION_GRANULES       = 0x0004	/* decode Layer III granule by granule */
 # if 0  /* not yet implemented */
   MAD_OPTION_LEFTCHANNEL    = 0x0010,	/* decode left channel only */
   MAD_OPTION_RIGHTCHANNEL   = 0x0020,	/* decode right channel only */
@@ -97,6 +106,9 @@ void mad_stream_finish(struct mad_stream *);
 # define mad_stream_options(stream, opts)  \
     ((void) ((stream)->options = (opts)))
 
+# define mad_stream_memory(stream, mem)  \
+    ((void) ((stream)->memory = (mem)))
+
 void mad_stream_buffer(struct mad_stream *,
 		       unsigned char const *, unsigned long);
 void mad_stream_skip(struct mad_stream *, unsigned long);
@@ -105,4 +117,7 @@ int mad_stream_sync(struct mad_stream *);
 
 char const *mad_stream_errorstr(struct mad_stream const *);
 
+void *mad_memory_alloc(struct mad_memory const *, unsigned long);
+void mad_memory_free(struct mad_memory const *, void *);
+
 # endif
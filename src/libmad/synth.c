@@ -28,6 +28,7 @@
 #include "fixed.h"
 #include "frame.h"
 #include "synth.h"
+#include "stats.h"
 
 /*
  * NAME:	synth->init()
@@ -39,9 +40,11 @@ void mad_synth_init(struct mad_synth *synth)
 
   synth->phase = 0;
 
+# if !defined(MAD_SYNTH_NO_PCM)
   synth->pcm.samplerate = 0;
   synth->pcm.channels   = 0;
   synth->pcm.length     = 0;
+# endif
 }
 
 /*
@@ -59,6 +62,9 @@ void mad_synth_mute(struct mad_synth *synth)
 	synth->filter[ch][1][0][s][v] = synth->filter[ch][1][1][s][v] = 0;
       }
     }
+
+    /* the filterbank has decayed */
+    synth->zero_slots[ch] = 16;
   }
 }
 
@@ -546,134 +552,246 @@ mad_fixed_t const D[17][32] = {
 #include "D.dat"
 };
 
-# if defined(ASO_SYNTH)
-void synth_full(struct mad_synth *, struct mad_frame const *,
-		unsigned int, unsigned int);
-# else
 /*
- * NAME:	synth->full()
- * DESCRIPTION:	perform full frequency PCM synthesis
+ * NAME:	synth->matrix()
+ * DESCRIPTION:	perform the polyphase matrixing of one slot: slots w/o subband
+ *		samples only clear the filterbank outputs, and once all 16
+ *		phases are zero the window would only produce zero samples,
+ *		so 0 is returned
  */
 static
-void synth_full(struct mad_synth *synth, struct mad_frame const *frame,
-		unsigned int nch, unsigned int ns)
+int synth_matrix(mad_fixed_t (*filter)[2][2][16][8],
+		 mad_fixed_t const sbsample[32], unsigned int phase,
+		 unsigned int *zero_slots)
 {
-  unsigned int phase, ch, s, sb, pe, po;
-  mad_fixed_t *pcm1, *pcm2;
-#if MAD_STACK_HACK 
-  static mad_fixed_t (*filter)[2][2][16][8];
-  static mad_fixed_t const (*sbsample)[36][32];
-#else
-  mad_fixed_t (*filter)[2][2][16][8];
-  mad_fixed_t const (*sbsample)[36][32];
-#endif
+  mad_fixed_t any = 0;
+  unsigned int sb;
+
+  for (sb = 0; sb < 32; ++sb)
+    any |= sbsample[sb];
+
+  if (any) {
+    *zero_slots = 0;
+
+    MAD_STATS_ENTER(MAD_STAGE_DCT32);
+    dct32(sbsample, phase >> 1,
+	  (*filter)[0][phase & 1], (*filter)[1][phase & 1]);
+    MAD_STATS_LEAVE();
+
+    return 1;
+  }
+
+  if (*zero_slots >= 16)
+    return 0;
+
+  ++*zero_slots;
+
+  for (sb = 0; sb < 16; ++sb) {
+    (*filter)[0][phase & 1][sb][phase >> 1] = 0;
+    (*filter)[1][phase & 1][sb][phase >> 1] = 0;
+  }
+
+  return 1;
+}
+
+/*
+ * NAME:	synth->full_slot()
+ * DESCRIPTION:	perform full frequency PCM synthesis of one slot (32 samples)
+ */
+static
+void synth_full_slot(mad_fixed_t (*filter)[2][2][16][8],
+		     mad_fixed_t const sbsample[32], unsigned int phase,
+		     mad_fixed_t *pcm1, unsigned int *zero_slots)
+{
+  unsigned int sb, pe, po;
+  mad_fixed_t *pcm2;
   register mad_fixed_t (*fe)[8], (*fx)[8], (*fo)[8];
   register mad_fixed_t const (*Dptr)[32], *ptr;
   register mad_fixed64hi_t hi;
   register mad_fixed64lo_t lo;
 
-  for (ch = 0; ch < nch; ++ch) {
-    sbsample = &frame->sbsample[ch];
-    filter   = &synth->filter[ch];
-    phase    = synth->phase;
-    pcm1     = synth->pcm.samples[ch];
+  if (!synth_matrix(filter, sbsample, phase, zero_slots)) {
+    for (sb = 0; sb < 32; ++sb)
+      pcm1[sb] = 0;
+    return;
+  }
 
-    for (s = 0; s < ns; ++s) {
-      dct32((*sbsample)[s], phase >> 1,
-	    (*filter)[0][phase & 1], (*filter)[1][phase & 1]);
+  MAD_STATS_ENTER(MAD_STAGE_WINDOW);
+
+  pe = phase & ~1;
+  po = ((phase - 1) & 0xf) | 1;
+
+  /* calculate 32 samples */
+
+  fe = &(*filter)[0][ phase & 1][0];
+  fx = &(*filter)[0][~phase & 1][0];
+  fo = &(*filter)[1][~phase & 1][0];
+
+  Dptr = &D[0];
+
+  ptr = *Dptr + po;
+  ML0(hi, lo, (*fx)[0], ptr[ 0]);
+  MLA(hi, lo, (*fx)[1], ptr[14]);
+  MLA(hi, lo, (*fx)[2], ptr[12]);
+  MLA(hi, lo, (*fx)[3], ptr[10]);
+  MLA(hi, lo, (*fx)[4], ptr[ 8]);
+  MLA(hi, lo, (*fx)[5], ptr[ 6]);
+  MLA(hi, lo, (*fx)[6], ptr[ 4]);
+  MLA(hi, lo, (*fx)[7], ptr[ 2]);
+  MLN(hi, lo);
+
+  ptr = *Dptr + pe;
+  MLA(hi, lo, (*fe)[0], ptr[ 0]);
+  MLA(hi, lo, (*fe)[1], ptr[14]);
+  MLA(hi, lo, (*fe)[2], ptr[12]);
+  MLA(hi, lo, (*fe)[3], ptr[10]);
+  MLA(hi, lo, (*fe)[4], ptr[ 8]);
+  MLA(hi, lo, (*fe)[5], ptr[ 6]);
+  MLA(hi, lo, (*fe)[6], ptr[ 4]);
+  MLA(hi, lo, (*fe)[7], ptr[ 2]);
+
+  *pcm1++ = SHIFT(MLZ(hi, lo));
+
+  pcm2 = pcm1 + 30;
+
+  for (sb = 1; sb < 16; ++sb) {
+    ++fe;
+    ++Dptr;
+
+    /* D[32 - sb][i] == -D[sb][31 - i] */
+
+    ptr = *Dptr + po;
+    ML0(hi, lo, (*fo)[0], ptr[ 0]);
+    MLA(hi, lo, (*fo)[1], ptr[14]);
+    MLA(hi, lo, (*fo)[2], ptr[12]);
+    MLA(hi, lo, (*fo)[3], ptr[10]);
+    MLA(hi, lo, (*fo)[4], ptr[ 8]);
+    MLA(hi, lo, (*fo)[5], ptr[ 6]);
+    MLA(hi, lo, (*fo)[6], ptr[ 4]);
+    MLA(hi, lo, (*fo)[7], ptr[ 2]);
+    MLN(hi, lo);
+
+    ptr = *Dptr + pe;
+    MLA(hi, lo, (*fe)[7], ptr[ 2]);
+    MLA(hi, lo, (*fe)[6], ptr[ 4]);
+    MLA(hi, lo, (*fe)[5], ptr[ 6]);
+    MLA(hi, lo, (*fe)[4], ptr[ 8]);
+    MLA(hi, lo, (*fe)[3], ptr[10]);
+    MLA(hi, lo, (*fe)[2], ptr[12]);
+    MLA(hi, lo, (*fe)[1], ptr[14]);
+    MLA(hi, lo, (*fe)[0], ptr[ 0]);
+
+    *pcm1++ = SHIFT(MLZ(hi, lo));
+
+    ptr = *Dptr - pe;
+    ML0(hi, lo, (*fe)[0], ptr[31 - 16]);
+    MLA(hi, lo, (*fe)[1], ptr[31 - 14]);
+    MLA(hi, lo, (*fe)[2], ptr[31 - 12]);
+    MLA(hi, lo, (*fe)[3], ptr[31 - 10]);
+    MLA(hi, lo, (*fe)[4], ptr[31 -  8]);
+    MLA(hi, lo, (*fe)[5], ptr[31 -  6]);
+    MLA(hi, lo, (*fe)[6], ptr[31 -  4]);
+    MLA(hi, lo, (*fe)[7], ptr[31 -  2]);
+
+    ptr = *Dptr - po;
+    MLA(hi, lo, (*fo)[7], ptr[31 -  2]);
+    MLA(hi, lo, (*fo)[6], ptr[31 -  4]);
+    MLA(hi, lo, (*fo)[5], ptr[31 -  6]);
+    MLA(hi, lo, (*fo)[4], ptr[31 -  8]);
+    MLA(hi, lo, (*fo)[3], ptr[31 - 10]);
+    MLA(hi, lo, (*fo)[2], ptr[31 - 12]);
+    MLA(hi, lo, (*fo)[1], ptr[31 - 14]);
+    MLA(hi, lo, (*fo)[0], ptr[31 - 16]);
+
+    *pcm2-- = SHIFT(MLZ(hi, lo));
+
+    ++fo;
+  }
 
-      pe = phase & ~1;
-      po = ((phase - 1) & 0xf) | 1;
+  ++Dptr;
 
-      /* calculate 32 samples */
+  ptr = *Dptr + po;
+  ML0(hi, lo, (*fo)[0], ptr[ 0]);
+  MLA(hi, lo, (*fo)[1], ptr[14]);
+  MLA(hi, lo, (*fo)[2], ptr[12]);
+  MLA(hi, lo, (*fo)[3], ptr[10]);
+  MLA(hi, lo, (*fo)[4], ptr[ 8]);
+  MLA(hi, lo, (*fo)[5], ptr[ 6]);
+  MLA(hi, lo, (*fo)[6], ptr[ 4]);
+  MLA(hi, lo, (*fo)[7], ptr[ 2]);
 
-      fe = &(*filter)[0][ phase & 1][0];
-      fx = &(*filter)[0][~phase & 1][0];
-      fo = &(*filter)[1][~phase & 1][0];
+  *pcm1 = SHIFT(-MLZ(hi, lo));
 
-      Dptr = &D[0];
+  MAD_STATS_LEAVE();
+}
 
-      ptr = *Dptr + po;
-      ML0(hi, lo, (*fx)[0], ptr[ 0]);
-      MLA(hi, lo, (*fx)[1], ptr[14]);
-      MLA(hi, lo, (*fx)[2], ptr[12]);
-      MLA(hi, lo, (*fx)[3], ptr[10]);
-      MLA(hi, lo, (*fx)[4], ptr[ 8]);
-      MLA(hi, lo, (*fx)[5], ptr[ 6]);
-      MLA(hi, lo, (*fx)[6], ptr[ 4]);
-      MLA(hi, lo, (*fx)[7], ptr[ 2]);
-      MLN(hi, lo);
+/*
+ * NAME:	synth->half_slot()
+ * DESCRIPTION:	perform half frequency PCM synthesis of one slot (16 samples)
+ */
+static
+void synth_half_slot(mad_fixed_t (*filter)[2][2][16][8],
+		     mad_fixed_t const sbsample[32], unsigned int phase,
+		     mad_fixed_t *pcm1, unsigned int *zero_slots)
+{
+  unsigned int sb, pe, po;
+  mad_fixed_t *pcm2;
+  register mad_fixed_t (*fe)[8], (*fx)[8], (*fo)[8];
+  register mad_fixed_t const (*Dptr)[32], *ptr;
+  register mad_fixed64hi_t hi;
+  register mad_fixed64lo_t lo;
 
-      ptr = *Dptr + pe;
-      MLA(hi, lo, (*fe)[0], ptr[ 0]);
-      MLA(hi, lo, (*fe)[1], ptr[14]);
-      MLA(hi, lo, (*fe)[2], ptr[12]);
-      MLA(hi, lo, (*fe)[3], ptr[10]);
-      MLA(hi, lo, (*fe)[4], ptr[ 8]);
-      MLA(hi, lo, (*fe)[5], ptr[ 6]);
-      MLA(hi, lo, (*fe)[6], ptr[ 4]);
-      MLA(hi, lo, (*fe)[7], ptr[ 2]);
+  if (!synth_matrix(filter, sbsample, phase, zero_slots)) {
+    for (sb = 0; sb < 16; ++sb)
+      pcm1[sb] = 0;
+    return;
+  }
 
-      *pcm1++ = SHIFT(MLZ(hi, lo));
+  MAD_STATS_ENTER(MAD_STAGE_WINDOW);
 
-      pcm2 = pcm1 + 30;
-
-      for (sb = 1; sb < 16; ++sb) {
-	++fe;
-	++Dptr;
-
-	/* D[32 - sb][i] == -D[sb][31 - i] */
-
-	ptr = *Dptr + po;
-	ML0(hi, lo, (*fo)[0], ptr[ 0]);
-	MLA(hi, lo, (*fo)[1], ptr[14]);
-	MLA(hi, lo, (*fo)[2], ptr[12]);
-	MLA(hi, lo, (*fo)[3], ptr[10]);
-	MLA(hi, lo, (*fo)[4], ptr[ 8]);
-	MLA(hi, lo, (*fo)[5], ptr[ 6]);
-	MLA(hi, lo, (*fo)[6], ptr[ 4]);
-	MLA(hi, lo, (*fo)[7], ptr[ 2]);
-	MLN(hi, lo);
-
-	ptr = *Dptr + pe;
-	MLA(hi, lo, (*fe)[7], ptr[ 2]);
-	MLA(hi, lo, (*fe)[6], ptr[ 4]);
-	MLA(hi, lo, (*fe)[5], ptr[ 6]);
-	MLA(hi, lo, (*fe)[4], ptr[ 8]);
-	MLA(hi, lo, (*fe)[3], ptr[10]);
-	MLA(hi, lo, (*fe)[2], ptr[12]);
-	MLA(hi, lo, (*fe)[1], ptr[14]);
-	MLA(hi, lo, (*fe)[0], ptr[ 0]);
-
-	*pcm1++ = SHIFT(MLZ(hi, lo));
-
-	ptr = *Dptr - pe;
-	ML0(hi, lo, (*fe)[0], ptr[31 - 16]);
-	MLA(hi, lo, (*fe)[1], ptr[31 - 14]);
-	MLA(hi, lo, (*fe)[2], ptr[31 - 12]);
-	MLA(hi, lo, (*fe)[3], ptr[31 - 10]);
-	MLA(hi, lo, (*fe)[4], ptr[31 -  8]);
-	MLA(hi, lo, (*fe)[5], ptr[31 -  6]);
-	MLA(hi, lo, (*fe)[6], ptr[31 -  4]);
-	MLA(hi, lo, (*fe)[7], ptr[31 -  2]);
-
-	ptr = *Dptr - po;
-	MLA(hi, lo, (*fo)[7], ptr[31 -  2]);
-	MLA(hi, lo, (*fo)[6], ptr[31 -  4]);
-	MLA(hi, lo, (*fo)[5], ptr[31 -  6]);
-	MLA(hi, lo, (*fo)[4], ptr[31 -  8]);
-	MLA(hi, lo, (*fo)[3], ptr[31 - 10]);
-	MLA(hi, lo, (*fo)[2], ptr[31 - 12]);
-	MLA(hi, lo, (*fo)[1], ptr[31 - 14]);
-	MLA(hi, lo, (*fo)[0], ptr[31 - 16]);
-
-	*pcm2-- = SHIFT(MLZ(hi, lo));
-
-	++fo;
-      }
+  pe = phase & ~1;
+  po = ((phase - 1) & 0xf) | 1;
+
+  /* calculate 16 samples */
+
+  fe = &(*filter)[0][ phase & 1][0];
+  fx = &(*filter)[0][~phase & 1][0];
+  fo = &(*filter)[1][~phase & 1][0];
+
+  Dptr = &D[0];
+
+  ptr = *Dptr + po;
+  ML0(hi, lo, (*fx)[0], ptr[ 0]);
+  MLA(hi, lo, (*fx)[1], ptr[14]);
+  MLA(hi, lo, (*fx)[2], ptr[12]);
+  MLA(hi, lo, (*fx)[3], ptr[10]);
+  MLA(hi, lo, (*fx)[4], ptr[ 8]);
+  MLA(hi, lo, (*fx)[5], ptr[ 6]);
+  MLA(hi, lo, (*fx)[6], ptr[ 4]);
+  MLA(hi, lo, (*fx)[7], ptr[ 2]);
+  MLN(hi, lo);
+
+  ptr = *Dptr + pe;
+  MLA(hi, lo, (*fe)[0], ptr[ 0]);
+  MLA(hi, lo, (*fe)[1], ptr[14]);
+  MLA(hi, lo, (*fe)[2], ptr[12]);
+  MLA(hi, lo, (*fe)[3], ptr[10]);
+  MLA(hi, lo, (*fe)[4], ptr[ 8]);
+  MLA(hi, lo, (*fe)[5], ptr[ 6]);
+  MLA(hi, lo, (*fe)[6], ptr[ 4]);
+  MLA(hi, lo, (*fe)[7], ptr[ 2]);
+
+  *pcm1++ = SHIFT(MLZ(hi, lo));
+
+  pcm2 = pcm1 + 14;
 
-      ++Dptr;
+  for (sb = 1; sb < 16; ++sb) {
+    ++fe;
+    ++Dptr;
 
+    /* D[32 - sb][i] == -D[sb][31 - i] */
+
+    if (!(sb & 1)) {
       ptr = *Dptr + po;
       ML0(hi, lo, (*fo)[0], ptr[ 0]);
       MLA(hi, lo, (*fo)[1], ptr[14]);
@@ -683,10 +801,89 @@ void synth_full(struct mad_synth *synth, struct mad_frame const *frame,
       MLA(hi, lo, (*fo)[5], ptr[ 6]);
       MLA(hi, lo, (*fo)[6], ptr[ 4]);
       MLA(hi, lo, (*fo)[7], ptr[ 2]);
+      MLN(hi, lo);
 
-      *pcm1 = SHIFT(-MLZ(hi, lo));
-      pcm1 += 16;
+      ptr = *Dptr + pe;
+      MLA(hi, lo, (*fe)[7], ptr[ 2]);
+      MLA(hi, lo, (*fe)[6], ptr[ 4]);
+      MLA(hi, lo, (*fe)[5], ptr[ 6]);
+      MLA(hi, lo, (*fe)[4], ptr[ 8]);
+      MLA(hi, lo, (*fe)[3], ptr[10]);
+      MLA(hi, lo, (*fe)[2], ptr[12]);
+      MLA(hi, lo, (*fe)[1], ptr[14]);
+      MLA(hi, lo, (*fe)[0], ptr[ 0]);
+
+      *pcm1++ = SHIFT(MLZ(hi, lo));
+
+      ptr = *Dptr - po;
+      ML0(hi, lo, (*fo)[7], ptr[31 -  2]);
+      MLA(hi, lo, (*fo)[6], ptr[31 -  4]);
+      MLA(hi, lo, (*fo)[5], ptr[31 -  6]);
+      MLA(hi, lo, (*fo)[4], ptr[31 -  8]);
+      MLA(hi, lo, (*fo)[3], ptr[31 - 10]);
+      MLA(hi, lo, (*fo)[2], ptr[31 - 12]);
+      MLA(hi, lo, (*fo)[1], ptr[31 - 14]);
+      MLA(hi, lo, (*fo)[0], ptr[31 - 16]);
+
+      ptr = *Dptr - pe;
+      MLA(hi, lo, (*fe)[0], ptr[31 - 16]);
+      MLA(hi, lo, (*fe)[1], ptr[31 - 14]);
+      MLA(hi, lo, (*fe)[2], ptr[31 - 12]);
+      MLA(hi, lo, (*fe)[3], ptr[31 - 10]);
+      MLA(hi, lo, (*fe)[4], ptr[31 -  8]);
+      MLA(hi, lo, (*fe)[5], ptr[31 -  6]);
+      MLA(hi, lo, (*fe)[6], ptr[31 -  4]);
+      MLA(hi, lo, (*fe)[7], ptr[31 -  2]);
+
+      *pcm2-- = SHIFT(MLZ(hi, lo));
+    }
+
+    ++fo;
+  }
+
+  ++Dptr;
+
+  ptr = *Dptr + po;
+  ML0(hi, lo, (*fo)[0], ptr[ 0]);
+  MLA(hi, lo, (*fo)[1], ptr[14]);
+  MLA(hi, lo, (*fo)[2], ptr[12]);
+  MLA(hi, lo, (*fo)[3], ptr[10]);
+  MLA(hi, lo, (*fo)[4], ptr[ 8]);
+  MLA(hi, lo, (*fo)[5], ptr[ 6]);
+  MLA(hi, lo, (*fo)[6], ptr[ 4]);
+  MLA(hi, lo, (*fo)[7], ptr[ 2]);
 
+  *pcm1 = SHIFT(-MLZ(hi, lo));
+
+  MAD_STATS_LEAVE();
+}
+
+# if !defined(MAD_SYNTH_NO_PCM)
+
+# if defined(ASO_SYNTH)
+void synth_full(struct mad_synth *, struct mad_frame const *,
+		unsigned int, unsigned int);
+# else
+/*
+ * NAME:	synth->full()
+ * DESCRIPTION:	perform full frequency PCM synthesis
+ */
+static
+void synth_full(struct mad_synth *synth, struct mad_frame const *frame,
+		unsigned int nch, unsigned int ns)
+{
+  unsigned int phase, ch, s;
+  mad_fixed_t *pcm1;
+
+  for (ch = 0; ch < nch; ++ch) {
+    phase    = synth->phase;
+    pcm1     = synth->pcm.samples[ch];
+
+    for (s = 0; s < ns; ++s) {
+      synth_full_slot(&synth->filter[ch], frame->sbsample[ch][s], phase, pcm1,
+		      &synth->zero_slots[ch]);
+
+      pcm1 += 32;
       phase = (phase + 1) % 16;
     }
   }
@@ -701,137 +898,18 @@ static
 void synth_half(struct mad_synth *synth, struct mad_frame const *frame,
 		unsigned int nch, unsigned int ns)
 {
-  unsigned int phase, ch, s, sb, pe, po;
-  mad_fixed_t *pcm1, *pcm2;
-#if MAD_STACK_HACK 
-  static mad_fixed_t (*filter)[2][2][16][8];
-  static mad_fixed_t const (*sbsample)[36][32];
-#else
-  mad_fixed_t (*filter)[2][2][16][8];
-  mad_fixed_t const (*sbsample)[36][32];
-#endif
-  register mad_fixed_t (*fe)[8], (*fx)[8], (*fo)[8];
-  register mad_fixed_t const (*Dptr)[32], *ptr;
-  register mad_fixed64hi_t hi;
-  register mad_fixed64lo_t lo;
+  unsigned int phase, ch, s;
+  mad_fixed_t *pcm1;
 
   for (ch = 0; ch < nch; ++ch) {
-    sbsample = &frame->sbsample[ch];
-    filter   = &synth->filter[ch];
     phase    = synth->phase;
     pcm1     = synth->pcm.samples[ch];
 
     for (s = 0; s < ns; ++s) {
-      dct32((*sbsample)[s], phase >> 1,
-	    (*filter)[0][phase & 1], (*filter)[1][phase & 1]);
-
-      pe = phase & ~1;
-      po = ((phase - 1) & 0xf) | 1;
-
-      /* calculate 16 samples */
-
-      fe = &(*filter)[0][ phase & 1][0];
-      fx = &(*filter)[0][~phase & 1][0];
-      fo = &(*filter)[1][~phase & 1][0];
-
-      Dptr = &D[0];
-
-      ptr = *Dptr + po;
-      ML0(hi, lo, (*fx)[0], ptr[ 0]);
-      MLA(hi, lo, (*fx)[1], ptr[14]);
-      MLA(hi, lo, (*fx)[2], ptr[12]);
-      MLA(hi, lo, (*fx)[3], ptr[10]);
-      MLA(hi, lo, (*fx)[4], ptr[ 8]);
-      MLA(hi, lo, (*fx)[5], ptr[ 6]);
-      MLA(hi, lo, (*fx)[6], ptr[ 4]);
-      MLA(hi, lo, (*fx)[7], ptr[ 2]);
-      MLN(hi, lo);
-
-      ptr = *Dptr + pe;
-      MLA(hi, lo, (*fe)[0], ptr[ 0]);
-      MLA(hi, lo, (*fe)[1], ptr[14]);
-      MLA(hi, lo, (*fe)[2], ptr[12]);
-      MLA(hi, lo, (*fe)[3], ptr[10]);
-      MLA(hi, lo, (*fe)[4], ptr[ 8]);
-      MLA(hi, lo, (*fe)[5], ptr[ 6]);
-      MLA(hi, lo, (*fe)[6], ptr[ 4]);
-      MLA(hi, lo, (*fe)[7], ptr[ 2]);
-
-      *pcm1++ = SHIFT(MLZ(hi, lo));
-
-      pcm2 = pcm1 + 14;
-
-      for (sb = 1; sb < 16; ++sb) {
-	++fe;
-	++Dptr;
-
-	/* D[32 - sb][i] == -D[sb][31 - i] */
-
-	if (!(sb & 1)) {
-	  ptr = *Dptr + po;
-	  ML0(hi, lo, (*fo)[0], ptr[ 0]);
-	  MLA(hi, lo, (*fo)[1], ptr[14]);
-	  MLA(hi, lo, (*fo)[2], ptr[12]);
-	  MLA(hi, lo, (*fo)[3], ptr[10]);
-	  MLA(hi, lo, (*fo)[4], ptr[ 8]);
-	  MLA(hi, lo, (*fo)[5], ptr[ 6]);
-	  MLA(hi, lo, (*fo)[6], ptr[ 4]);
-	  MLA(hi, lo, (*fo)[7], ptr[ 2]);
-	  MLN(hi, lo);
-
-	  ptr = *Dptr + pe;
-	  MLA(hi, lo, (*fe)[7], ptr[ 2]);
-	  MLA(hi, lo, (*fe)[6], ptr[ 4]);
-	  MLA(hi, lo, (*fe)[5], ptr[ 6]);
-	  MLA(hi, lo, (*fe)[4], ptr[ 8]);
-	  MLA(hi, lo, (*fe)[3], ptr[10]);
-	  MLA(hi, lo, (*fe)[2], ptr[12]);
-	  MLA(hi, lo, (*fe)[1], ptr[14]);
-	  MLA(hi, lo, (*fe)[0], ptr[ 0]);
-
-	  *pcm1++ = SHIFT(MLZ(hi, lo));
-
-	  ptr = *Dptr - po;
-	  ML0(hi, lo, (*fo)[7], ptr[31 -  2]);
-	  MLA(hi, lo, (*fo)[6], ptr[31 -  4]);
-	  MLA(hi, lo, (*fo)[5], ptr[31 -  6]);
-	  MLA(hi, lo, (*fo)[4], ptr[31 -  8]);
-	  MLA(hi, lo, (*fo)[3], ptr[31 - 10]);
-	  MLA(hi, lo, (*fo)[2], ptr[31 - 12]);
-	  MLA(hi, lo, (*fo)[1], ptr[31 - 14]);
-	  MLA(hi, lo, (*fo)[0], ptr[31 - 16]);
-
-	  ptr = *Dptr - pe;
-	  MLA(hi, lo, (*fe)[0], ptr[31 - 16]);
-	  MLA(hi, lo, (*fe)[1], ptr[31 - 14]);
-	  MLA(hi, lo, (*fe)[2], ptr[31 - 12]);
-	  MLA(hi, lo, (*fe)[3], ptr[31 - 10]);
-	  MLA(hi, lo, (*fe)[4], ptr[31 -  8]);
-	  MLA(hi, lo, (*fe)[5], ptr[31 -  6]);
-	  MLA(hi, lo, (*fe)[6], ptr[31 -  4]);
-	  MLA(hi, lo, (*fe)[7], ptr[31 -  2]);
-
-	  *pcm2-- = SHIFT(MLZ(hi, lo));
-	}
-
-	++fo;
-      }
-
-      ++Dptr;
-
-      ptr = *Dptr + po;
-      ML0(hi, lo, (*fo)[0], ptr[ 0]);
-      MLA(hi, lo, (*fo)[1], ptr[14]);
-      MLA(hi, lo, (*fo)[2], ptr[12]);
-      MLA(hi, lo, (*fo)[3], ptr[10]);
-      MLA(hi, lo, (*fo)[4], ptr[ 8]);
-      MLA(hi, lo, (*fo)[5], ptr[ 6]);
-      MLA(hi, lo, (*fo)[6], ptr[ 4]);
-      MLA(hi, lo, (*fo)[7], ptr[ 2]);
-
-      *pcm1 = SHIFT(-MLZ(hi, lo));
-      pcm1 += 8;
+      synth_half_slot(&synth->filter[ch], frame->sbsample[ch][s], phase, pcm1,
+		      &synth->zero_slots[ch]);
 
+      pcm1 += 16;
       phase = (phase + 1) % 16;
     }
   }
@@ -848,7 +926,7 @@ void mad_synth_frame(struct mad_synth *synth, struct mad_frame const *frame)
 		      unsigned int, unsigned int);
 
   nch = MAD_NCHANNELS(&frame->header);
-  ns  = MAD_NSBSAMPLES(&frame->header);
+  ns  = MAD_FRAME_NSBSAMPLES(frame);
 
   synth->pcm.samplerate = frame->header.samplerate;
   synth->pcm.channels   = nch;
@@ -865,5 +943,53 @@ void mad_synth_frame(struct mad_synth *synth, struct mad_frame const *frame)
 
   synth_frame(synth, frame, nch, ns);
 
+# if defined(ASO_SYNTH)
+  /* the assembler version does not track the slots w/o subband samples */
+  synth->zero_slots[0] = synth->zero_slots[1] = 0;
+# endif
+
   synth->phase = (synth->phase + ns) % 16;
 }
+# endif
+
+/*
+ * NAME:	synth->frame_slots()
+ * DESCRIPTION:	perform PCM synthesis of frame subband samples, passing each
+ *		slot of 32 samples per channel (16 at half sample rate) to
+ *		slot_func() instead of buffering the whole frame
+ */
+void mad_synth_frame_slots(struct mad_synth *synth, struct mad_frame const *frame,
+			   void (*slot_func)(void *, unsigned int, unsigned int,
+					     mad_fixed_t const [2][32]),
+			   void *data)
+{
+  unsigned int nch, ns, ch, s, phase, length;
+  mad_fixed_t pcm[2][32];
+  void (*synth_slot)(mad_fixed_t (*)[2][2][16][8], mad_fixed_t const [32],
+		     unsigned int, mad_fixed_t *, unsigned int *);
+
+  nch = MAD_NCHANNELS(&frame->header);
+  ns  = MAD_FRAME_NSBSAMPLES(frame);
+
+  synth_slot = synth_full_slot;
+  length     = 32;
+
+  if (frame->options & MAD_OPTION_HALFSAMPLERATE) {
+    synth_slot = synth_half_slot;
+    length     = 16;
+  }
+
+  phase = synth->phase;
+
+  for (s = 0; s < ns; ++s) {
+    for (ch = 0; ch < nch; ++ch)
+      synth_slot(&synth->filter[ch], frame->sbsample[ch][s], phase, pcm[ch],
+		 &synth->zero_slots[ch]);
+
+    slot_func(data, nch, length, (mad_fixed_t const (*)[32]) pcm);
+
+    phase = (phase + 1) % 16;
+  }
+
+  synth->phase = phase;
+}
@@ -38,7 +38,11 @@ struct mad_synth {
 
   unsigned int phase;			/* current processing phase */
 
+  unsigned int zero_slots[2];		/* slots w/o subband samples */
+
+# if !defined(MAD_SYNTH_NO_PCM)
   struct mad_pcm pcm;			/* PCM output */
+# endif
 };
 
 /* single channel PCM selector */
@@ -64,6 +68,12 @@ void mad_synth_init(struct mad_synth *);
 
 void mad_synth_mute(struct mad_synth *);
 
+# if !defined(MAD_SYNTH_NO_PCM)
 void mad_synth_frame(struct mad_synth *, struct mad_frame const *);
+# endif
+
+void mad_synth_frame_slots(struct mad_synth *, struct mad_frame const *,
+			   void (*)(void *, unsigned int, unsigned int,
+				    mad_fixed_t const [2][32]), void *);
 
 # endif